@@ -10,9 +10,39 @@ HEADERS += $$PWD/include/GLBatch.h \
            $$PWD/include/GLShaderManager.h \
            $$PWD/include/GLTools.h \
            $$PWD/include/GLTriangleBatch.h \
-           $$PWD/include/GLFrameBuffer.h
+           $$PWD/include/GLFrameBuffer.h \
+           $$PWD/include/GLPrimitiveCache.h \
+           $$PWD/include/GLTerrainBatch.h \
+           $$PWD/include/GLStateCache.h \
+           $$PWD/include/GLRenderQueue.h \
+           $$PWD/include/GLCommandBuffer.h \
+           $$PWD/include/GLDrawList.h \
+           $$PWD/include/GLShaderCompiler.h \
+           $$PWD/include/GLShaderPreprocessor.h \
+           $$PWD/include/GLShaderVariants.h \
+           $$PWD/include/GLContext.h \
+           $$PWD/include/GLUploadQueue.h \
+           $$PWD/include/GLFrameSync.h \
+           $$PWD/include/GLDeleteQueue.h \
+           $$PWD/include/GLBufferPool.h \
+           $$PWD/include/GLMemoryTracker.h
 
 SOURCES += $$PWD/src/GLBatch.cpp \
            $$PWD/src/GLShaderManager.cpp \
            $$PWD/src/GLTriangleBatch.cpp \
-           $$PWD/src/GLTools.cpp
+           $$PWD/src/GLTools.cpp \
+           $$PWD/src/GLPrimitiveCache.cpp \
+           $$PWD/src/GLTerrainBatch.cpp \
+           $$PWD/src/GLStateCache.cpp \
+           $$PWD/src/GLRenderQueue.cpp \
+           $$PWD/src/GLCommandBuffer.cpp \
+           $$PWD/src/GLDrawList.cpp \
+           $$PWD/src/GLShaderCompiler.cpp \
+           $$PWD/src/GLShaderPreprocessor.cpp \
+           $$PWD/src/GLShaderVariants.cpp \
+           $$PWD/src/GLContext.cpp \
+           $$PWD/src/GLUploadQueue.cpp \
+           $$PWD/src/GLFrameSync.cpp \
+           $$PWD/src/GLDeleteQueue.cpp \
+           $$PWD/src/GLBufferPool.cpp \
+           $$PWD/src/GLMemoryTracker.cpp
@@ -46,6 +46,7 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 #include "M3DFrame.h"
 #include "M3DFrustum.h"
 #include "GLShaderManager.h"
+#include "GLBufferPool.h"
 
 #if defined ( __EMSCRIPTEN__ ) 
 typedef unsigned int            uint;
@@ -81,6 +82,7 @@ class GLBatch: public GLBatchBase
         inline void CopyTexCoordData2f(GLfloat *vTex) { CopyTexCoordData2f((M3DVector2f *)vTex); }
 
         virtual void Draw(void);
+        virtual bool GetDrawItem(GLTDrawItem& item);
  
         void Vertex3f(GLfloat x, GLfloat y, GLfloat z);
         void Vertex3fv(M3DVector3f vVertex);
@@ -109,12 +111,14 @@ class GLBatch: public GLBatchBase
         void UpdateTexCoord(uint index, M3DVector2f vTexCoord);
         
     protected:
+        void MoveToOwnBuffer(GLTBUFFERRANGE& range, GLuint iAttribute, GLint nComponents);
+
         GLenum		primitiveType;		// What am I drawing....
         GLuint      uiVertexArrayObject;
-        GLuint		uiVertexArray;
-        GLuint      uiNormalArray;
-        GLuint		uiColorArray;
-        GLuint		uiTextureCoordArray;
+        GLTBUFFERRANGE  vertexRange;        // From the GLBufferPool
+        GLTBUFFERRANGE  normalRange;
+        GLTBUFFERRANGE  colorRange;
+        GLTBUFFERRANGE  texCoordRange;
         
         GLuint nVertsBuilding;		// Building up vertexes counter (immediate mode emulator)
         GLuint nNumVerts;			// Number of verticies in this batch
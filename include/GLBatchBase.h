@@ -35,6 +35,19 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 // are derived from this. Having a virtual Draw() function allows
 // these classes to be collected by container classes that can
 // then iterate over them and call their draw methods. 
+////////////////////////////////////////////////////////////////////
+// Everything it takes to draw a batch, without the batch. A zero
+// index type means glDrawArrays(), starting at vertex nFirst;
+// otherwise nFirst is the byte offset into the element array.
+struct GLTDrawItem
+	{
+	GLuint		uiVertexArray;
+	GLenum		ePrimitive;
+	GLsizei		nCount;
+	GLenum		eIndexType;
+	GLintptr	nFirst;
+	};
+
 #ifdef QT_IS_AVAILABLE
 class GLBatchBase : public QOpenGLExtraFunctions
 #else
@@ -44,7 +57,13 @@ class GLBatchBase
 	public:
 		GLBatchBase()
 			{}
+		virtual ~GLBatchBase()
+			{}
         virtual void Draw() = 0;
+
+        // For GLDrawList. False if there's nothing to draw (yet).
+        virtual bool GetDrawItem(GLTDrawItem& item)
+            { (void)item; return false; }
 	};
 
 
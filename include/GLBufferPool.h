@@ -0,0 +1,146 @@
+/*
+GLBufferPool.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Hands out pieces of a few big buffer objects, instead of a buffer object
+ *  for every array of every batch. Blocks of GLT_BUFFER_POOL_BLOCK bytes are
+ *  made as they're needed, and each allocation is the best fitting free range
+ *  of one of them. Freed ranges merge with their free neighbors, so the
+ *  blocks don't crumble into pieces too small to use. Anything bigger than
+ *  half a block gets a block of its own.
+ *
+ *  An allocation is a buffer name and an offset into it. Point attributes,
+ *  and draws from the index buffer, at the offset.
+ *
+ *  Vertex data, indexes, and data that's rewritten often each come from
+ *  their own blocks. WebGL won't let one buffer be both an index buffer and
+ *  anything else, and the drivers can place the dynamic ones differently.
+ *
+ *  Don't free a range the GPU may still be reading; hand it to
+ *  GLDeleteQueue::FreeBufferRange() instead. A range always goes back to
+ *  the pool it came from, so any thread of a context that shares buffers with
+ *  it may queue it.
+*/
+
+#ifndef __GLT_BUFFER_POOL__
+#define __GLT_BUFFER_POOL__
+
+#include "GLStateCache.h"
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+
+// Size of each shared block
+#define GLT_BUFFER_POOL_BLOCK       (4 * 1024 * 1024)
+
+// Every range starts on, and is rounded up to, this many bytes
+#define GLT_BUFFER_POOL_ALIGN       16
+
+enum GLT_BUFFER_KIND { GLT_BUFFER_VERTEX = 0, GLT_BUFFER_INDEX, GLT_BUFFER_DYNAMIC, GLT_BUFFER_KIND_LAST };
+
+class GLBufferPool;
+
+// A zero buffer name means nothing is allocated. A range with no pool has
+// a buffer of its own, which is deleted when the range is freed.
+struct GLTBUFFERRANGE
+    {
+    GLuint          uiBuffer;
+    GLintptr        nOffset;
+    GLsizeiptr      nSize;
+    GLBufferPool    *pPool;
+    };
+
+struct GLTBUFFERPOOLSTATS
+    {
+    GLint       nBlocks;
+    GLint       nAllocations;
+    GLint       nFreeRanges;
+    GLsizeiptr  nBytesReserved;         // In all the blocks
+    GLsizeiptr  nBytesUsed;             // Allocated, after rounding
+    GLsizeiptr  nLargestFree;
+    GLfloat     fUtilization;           // Used / reserved
+    GLfloat     fFragmentation;         // 0 when each block's free space is in one range, near 1 when it's in crumbs
+    };
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLBufferPool : public QOpenGLExtraFunctions
+#else
+class GLBufferPool
+#endif
+    {
+    public:
+        GLBufferPool(void);
+        ~GLBufferPool(void);
+
+        // The one for the current context, see GLContext.h
+        static GLBufferPool* GetBufferPool(void);
+
+        // For blocks made from now on
+        inline void SetBlockSize(GLsizeiptr nBytes) { nBlockSize = nBytes; }
+
+        // Any thread with a context that shares buffers with this one
+        bool Allocate(GLT_BUFFER_KIND eKind, GLsizeiptr nBytes, GLTBUFFERRANGE& range);
+        void Write(const GLTBUFFERRANGE& range, const void *pData, GLsizeiptr nBytes, GLintptr nOffset = 0);
+
+        // Only once the GPU is done with it. Clears the range.
+        void Free(GLTBUFFERRANGE& range);
+
+        // Delete any block with nothing allocated from it
+        void Trim(void);
+
+        void GetStats(GLTBUFFERPOOLSTATS& stats);
+        void GetStats(GLT_BUFFER_KIND eKind, GLTBUFFERPOOLSTATS& stats);
+
+    protected:
+        struct POOLBLOCK {
+            GLuint                          uiBuffer;
+            GLint                           eKind;
+            GLsizeiptr                      nSize;
+            GLsizeiptr                      nUsed;
+            GLint                           nAllocations;
+            bool                            bDedicated;         // One allocation, bigger than half a block
+            std::map<GLintptr, GLsizeiptr>  freeRanges;         // By offset
+            };
+
+        typedef std::multimap<GLsizeiptr, std::pair<POOLBLOCK*, GLintptr> > FREEBYSIZE;
+
+        POOLBLOCK *MakeBlock(GLint eKind, GLsizeiptr nSize);
+        void DeleteBlock(POOLBLOCK *pBlock);
+        void AddFree(POOLBLOCK *pBlock, GLintptr nOffset, GLsizeiptr nSize);
+        void RemoveFree(POOLBLOCK *pBlock, GLintptr nOffset, GLsizeiptr nSize);
+        GLenum BindForWrite(GLint eKind, GLuint uiBuffer);
+        void AddStats(GLint eKind, GLTBUFFERPOOLSTATS& stats);
+
+        std::mutex                              poolMutex;
+        GLsizeiptr                              nBlockSize;
+        std::vector<POOLBLOCK*>                 blocks;
+        std::unordered_map<GLuint, POOLBLOCK*>  blocksByBuffer;
+        FREEBYSIZE                              freeBySize[GLT_BUFFER_KIND_LAST];
+    };
+
+#endif // __GLT_BUFFER_POOL__
@@ -0,0 +1,95 @@
+/*
+GLCommandBuffer.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  A list of binds, uniforms, and draws, written down now and carried out later.
+ *  Recording makes no OpenGL calls at all, so any thread can fill a command
+ *  buffer while the GL thread is busy with something else. Give each thread its
+ *  own buffer; a buffer is not safe to record into from two threads at once.
+ *
+ *  Once the workers are done, the GL thread replays the buffers in order. The
+ *  objects recorded with DrawObject() in all of them go to the shader manager's
+ *  object block in a single upload.
+ *
+ *  Batches, textures, and programs are referenced, not copied. They must still
+ *  exist when the buffer is replayed.
+*/
+
+#ifndef __GLT_COMMAND_BUFFER__
+#define __GLT_COMMAND_BUFFER__
+
+#include "GLTools.h"
+#include <vector>
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLCommandBuffer : public QOpenGLExtraFunctions
+#else
+class GLCommandBuffer
+#endif
+    {
+    public:
+        GLCommandBuffer(void);
+
+        // Start over. The memory is kept for the next frame.
+        void Reset(void);
+
+        // Recording, from any one thread
+        void UseProgram(GLuint uiProgram);
+        void UniformMatrix4(GLint iLocation, const M3DMatrix44f mMatrix);
+        void UniformMatrix3(GLint iLocation, const M3DMatrix33f mMatrix);
+        void Uniform4(GLint iLocation, const M3DVector4f vValue);
+        void Uniform1i(GLint iLocation, GLint iValue);
+        void BindTexture(GLenum eUnit, GLenum eTarget, GLuint uiTexture);
+        void Draw(GLBatchBase *pBatch);
+        void DrawInstanced(GLTriangleBatch *pBatch, GLsizei nInstances);
+
+        // Draw with a stock shader, taking the matrices and color from the object block
+        void DrawObject(GLBatchBase *pBatch, GLT_STOCK_SHADER nShaderID, const GLTObjectData& object,
+                        GLint iTextureUnit = 0);
+
+        inline GLuint GetCommandCount(void) { return nCommands; }
+
+        // On the GL thread only
+        void Replay(GLShaderManager& shaderManager);
+        static void Replay(GLShaderManager& shaderManager, GLCommandBuffer *pBuffers, GLint nBuffers);
+
+    protected:
+        enum GLT_COMMAND { CMD_USE_PROGRAM = 0, CMD_UNIFORM_MATRIX4, CMD_UNIFORM_MATRIX3, CMD_UNIFORM4,
+                           CMD_UNIFORM1I, CMD_BIND_TEXTURE, CMD_DRAW, CMD_DRAW_INSTANCED, CMD_DRAW_OBJECT };
+
+        // Each record is its command, then its arguments, padded to eight bytes
+        void *Record(GLuint eCommand, size_t nBytes);
+        void Execute(GLShaderManager& shaderManager, GLint iFirstObject);
+
+        std::vector<uint64_t>       commands;
+        std::vector<GLTObjectData>  objects;
+        GLuint                      nCommands;
+#ifdef QT_IS_AVAILABLE
+        bool                        bFunctionsReady;
+#endif
+    };
+
+#endif // __GLT_COMMAND_BUFFER__
@@ -0,0 +1,79 @@
+/*
+GLContext.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Which context is current on each thread, and GLTools' objects for it.
+ *  GLTools::GetGLTools(), GLStateCache::GetStateCache(),
+ *  GLFrameSync::GetFrameSync(), GLDeleteQueue::GetDeleteQueue(), and
+ *  GLBufferPool::GetBufferPool() return the ones for the calling thread's
+ *  context, made the first time they're asked for.
+ *
+ *  An application with one context can ignore all of this; until a thread
+ *  says otherwise, its context is NULL, and they all share that one. With
+ *  more, call gltMakeContextCurrent() right after making a context current,
+ *  with anything that identifies it: an HGLRC, an EGLContext, a
+ *  QOpenGLContext pointer, and so on.
+ *
+ *  Shared contexts share programs and buffers, but not bindings, so each still
+ *  gets its own state cache.
+*/
+
+#ifndef __GLT_CONTEXT__
+#define __GLT_CONTEXT__
+
+#include <atomic>
+#include <mutex>
+
+class GLTools;
+class GLStateCache;
+class GLFrameSync;
+class GLDeleteQueue;
+class GLBufferPool;
+
+struct GLTCONTEXTDATA {
+    std::atomic<GLTools*>       pTools;
+    std::atomic<GLStateCache*>  pStateCache;
+    std::atomic<GLFrameSync*>   pFrameSync;
+    std::atomic<GLDeleteQueue*> pDeleteQueue;
+    std::atomic<GLBufferPool*>  pBufferPool;
+    std::mutex                  createMutex;        // Only for making them
+    };
+
+// Tell GLTools which context this thread is now using
+void gltMakeContextCurrent(void *pContext);
+void *gltGetCurrentContext(void);
+
+// The objects for this thread's context. After the first call on a thread,
+// no locks are taken until the context changes.
+GLTCONTEXTDATA *gltGetContextData(void);
+
+// Free GLTools' objects for a context about to be destroyed. No thread may
+// still be using it, and it must be current on this one, to GL and to
+// gltMakeContextCurrent(). GL objects made with
+// them are not deleted.
+void gltReleaseContext(void *pContext);
+
+#endif // __GLT_CONTEXT__
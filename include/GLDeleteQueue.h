@@ -0,0 +1,104 @@
+/*
+GLDeleteQueue.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Deletes GL objects, and frees GLBufferPool ranges, once the GPU is done
+ *  with them. Names can be queued
+ *  from any thread; nothing is called on GL until Update(), on the thread
+ *  that owns the context. Each Update() deletes, a type at a time, whatever
+ *  was queued before a frame GLFrameSync has seen finish.
+ *
+ *  GLFrameSync::BeginFrame() calls Update() for you. Without a GLFrameSync
+ *  there are no frames to wait for, so names queued on the context's own
+ *  thread are deleted right away, along with anything other threads queued
+ *  before them. If only other threads delete, call Update() now and then.
+ *
+ *  A thread that isn't the context's own must still say which context the
+ *  names belong to, with gltMakeContextCurrent(). It doesn't have to make
+ *  the context current in GL. With only one context, there's nothing to do.
+*/
+
+#ifndef __GLT_DELETE_QUEUE__
+#define __GLT_DELETE_QUEUE__
+
+#include "GLStateCache.h"
+#include "GLBufferPool.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+class GLDeleteQueue
+    {
+    public:
+        GLDeleteQueue(void);
+        ~GLDeleteQueue(void);
+
+        // The one for the current context, see GLContext.h
+        static GLDeleteQueue* GetDeleteQueue(void);
+
+        // Any thread. Names of 0 are skipped.
+        void DeleteBuffers(GLsizei n, const GLuint *pBuffers);
+        void DeleteVertexArrays(GLsizei n, const GLuint *pVertexArrays);
+        void DeleteTextures(GLsizei n, const GLuint *pTextures);
+        void DeleteFramebuffers(GLsizei n, const GLuint *pFramebuffers);
+        void DeleteRenderbuffers(GLsizei n, const GLuint *pRenderbuffers);
+        void DeleteProgram(GLuint uiProgram);
+
+        // Hand a range back to its GLBufferPool
+        void FreeBufferRange(const GLTBUFFERRANGE& range);
+
+        // GL thread only. Returns how many names and ranges were let go.
+        GLint Update(void);
+
+        // Delete everything now, used or not. GL thread only.
+        GLint Flush(void);
+
+        // Queued and not yet deleted
+        inline GLint GetPendingCount(void) { return nPending; }
+
+    protected:
+        enum { DELETE_BUFFER = 0, DELETE_VERTEX_ARRAY, DELETE_TEXTURE, DELETE_FRAMEBUFFER,
+                DELETE_RENDERBUFFER, DELETE_PROGRAM, DELETE_LAST };
+
+        struct DELETEBATCH {
+            GLuint64            nFrame;             // The last frame they might be in
+            std::vector<GLuint> names[DELETE_LAST];
+            std::vector<GLTBUFFERRANGE> ranges;
+            };
+
+        void Queue(GLint eType, GLsizei n, const GLuint *pNames);
+        bool CanDeleteNow(void);
+        void Collect(GLuint64 nFrame);
+        GLint Free(DELETEBATCH& batch);
+
+        std::mutex              incomingMutex;
+        DELETEBATCH             incoming;           // Under incomingMutex
+        std::deque<DELETEBATCH> pending;            // GL thread only, oldest first
+        std::atomic<GLint>      nPending;
+    };
+
+#endif // __GLT_DELETE_QUEUE__
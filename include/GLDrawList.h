@@ -0,0 +1,71 @@
+/*
+GLDrawList.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  A flat, contiguous list of draws. Each entry holds only what the draw call
+ *  needs (vertex array, primitive, count, index type, offset), copied out of the
+ *  batch when it's added. Draw() then walks the array in one tight loop, with no
+ *  virtual calls and no trips back to the batches.
+ *
+ *  Entries are a snapshot. If a batch is rebuilt, or freed, the list has to be
+ *  rebuilt too. Whatever shader and uniforms are current are used for every draw.
+*/
+
+#ifndef __GLT_DRAW_LIST__
+#define __GLT_DRAW_LIST__
+
+#include "GLTools.h"
+#include <vector>
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLDrawList : public QOpenGLExtraFunctions
+#else
+class GLDrawList
+#endif
+    {
+    public:
+        GLDrawList(void);
+
+        // Returns the entry's index, or -1 if the batch has nothing to draw
+        GLint Add(GLBatchBase& batch);
+        GLint Add(const GLTDrawItem& item);
+
+        inline void Reserve(GLsizei nItems) { items.reserve(nItems); }
+        inline void Clear(void) { items.clear(); }
+
+        // Draw every entry, or a range of them
+        void Draw(void);
+        void Draw(GLsizei iFirst, GLsizei nItems);
+
+        inline GLsizei GetCount(void) { return (GLsizei)items.size(); }
+        inline GLTDrawItem& GetItem(GLsizei iItem) { return items[iItem]; }
+
+    protected:
+        std::vector<GLTDrawItem>    items;
+    };
+
+#endif // __GLT_DRAW_LIST__
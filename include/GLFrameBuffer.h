@@ -46,13 +46,14 @@ class GLFrameBuffer
             {
             fboHandle = 0;
             depthStencilHandle = 0;
+            textureHandle = 0;
             }
             
             
         ~GLFrameBuffer(void)
             {
-            glDeleteRenderbuffers(1, &depthStencilHandle);
-            glDeleteFramebuffers(1, &fboHandle);
+            FreeHandles();
+            GLMemoryTracker::GetMemoryTracker()->Forget(this);
             }
         
         
@@ -61,6 +62,10 @@ class GLFrameBuffer
 #ifdef QT_IS_AVAILABLE
             initializeOpenGLFunctions();
 #endif
+            // Initialized again, at a new size
+            if(fboHandle != 0)
+                FreeHandles();
+
             glGenFramebuffers(1, &fboHandle);
             glGenRenderbuffers(1, &depthStencilHandle);
             glGenTextures(1, &textureHandle);
@@ -69,9 +74,9 @@ class GLFrameBuffer
             textureHeight = nHeight;
             
             // Initialize FBO
-            glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
+            GLStateCache::GetStateCache()->BindFramebuffer(GL_FRAMEBUFFER, fboHandle);
         
-            glBindTexture(fboTarget, textureHandle);
+            GLStateCache::GetStateCache()->BindTexture(fboTarget, textureHandle);
             
             // Reserve space
             if(fboTarget == GL_TEXTURE_2D)  // star field is drawn with this method
@@ -102,12 +107,17 @@ class GLFrameBuffer
                 }
                                         
             // Must attach texture to framebuffer. Has Stencil and depth
-            glBindRenderbuffer(GL_RENDERBUFFER, depthStencilHandle);
+            GLStateCache::GetStateCache()->BindRenderbuffer(GL_RENDERBUFFER, depthStencilHandle);
             glRenderbufferStorage(GL_RENDERBUFFER, /*GL_DEPTH_STENCIL*/GL_DEPTH24_STENCIL8, nWidth, nHeight);
             glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthStencilHandle);
             glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilHandle);
                                        
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLStateCache::GetStateCache()->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            // Color and depth-stencil, at four bytes a pixel (drivers pad RGB8 to four)
+            GLsizeiptr nPixels = (GLsizeiptr)nWidth * nHeight;
+            GLsizeiptr nColor = (fboTarget == GL_TEXTURE_2D) ? nPixels * 4 : nPixels * 4 * 6;
+            GLMemoryTracker::GetMemoryTracker()->SetUsage(GLT_MEMORY_FRAMEBUFFER, this, nColor + nPixels * 4, "GLFrameBuffer");
             
             return true;
             }
@@ -117,20 +127,20 @@ class GLFrameBuffer
         // for general or texture render operations
         inline void Bind(void)
             {
-            glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
+            GLStateCache::GetStateCache()->BindFramebuffer(GL_FRAMEBUFFER, fboHandle);
             }
             
         // Call this when done with the buffer object
         inline void Unbind(void)
             {
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLStateCache::GetStateCache()->BindFramebuffer(GL_FRAMEBUFFER, 0);
             }
             
             
         // Specifically for rendering into the sides of a cube map texture. 
         inline void BindToCubeFace(GLenum textureTarget)
             {
-            glBindFramebuffer(GL_FRAMEBUFFER, fboHandle);
+            GLStateCache::GetStateCache()->BindFramebuffer(GL_FRAMEBUFFER, fboHandle);
             glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureTarget, textureHandle, 0);
             }
         
@@ -140,6 +150,14 @@ class GLFrameBuffer
          inline GLsizei Height(void) { return textureHeight; }
         
     protected:
+        // Once the GPU is done with them
+        void FreeHandles(void)
+            {
+            GLDeleteQueue::GetDeleteQueue()->DeleteTextures(1, &textureHandle);
+            GLDeleteQueue::GetDeleteQueue()->DeleteRenderbuffers(1, &depthStencilHandle);
+            GLDeleteQueue::GetDeleteQueue()->DeleteFramebuffers(1, &fboHandle);
+            }
+
         GLuint  fboHandle;
         GLuint  depthStencilHandle;
         GLuint  textureHandle;
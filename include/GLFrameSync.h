@@ -0,0 +1,130 @@
+/*
+GLFrameSync.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Keeps the CPU from getting too far ahead of the GPU. EndFrame() fences
+ *  whatever the frame sent, and BeginFrame() waits until no more than
+ *  GetFramesInFlight() frames are still on the GPU. The GPU keeps drawing
+ *  while we build the next frame, and the fences tell us exactly what it
+ *  has finished with.
+ *
+ *  Anything the GPU may still be reading belongs to the frame that used it.
+ *  Keep one copy of a streaming or readback buffer per frame in flight, and
+ *  use copy GetFrameIndex(); nothing still in flight uses it. For everything
+ *  else, OnFrameComplete() calls you back once the GPU is done with the
+ *  current frame, which is when a buffer can be reused or read back. Objects
+ *  to delete can go on the GLDeleteQueue, which BeginFrame() empties.
+*/
+
+#ifndef __GLT_FRAME_SYNC__
+#define __GLT_FRAME_SYNC__
+
+#include "GLTools.h"
+#include <vector>
+#include <deque>
+
+// Frames the GPU may be working on at once
+#define GLT_FRAMES_IN_FLIGHT        2
+#define GLT_MAX_FRAMES_IN_FLIGHT    4
+
+// How long each wait on a fence is, in nanoseconds. We wait again if it runs out.
+#define GLT_FRAME_WAIT_TIMEOUT      1000000000
+
+typedef void (*GLT_FRAME_CALLBACK)(void *pUserData);
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLFrameSync : public QOpenGLExtraFunctions
+#else
+class GLFrameSync
+#endif
+    {
+    public:
+        GLFrameSync(void);
+        ~GLFrameSync(void);
+
+        // The one for the current context, see GLContext.h
+        static GLFrameSync* GetFrameSync(void);
+
+        // 1 to GLT_MAX_FRAMES_IN_FLIGHT. The next BeginFrame() waits for the
+        // GPU to finish everything first, so no frame index is in use twice.
+        void SetFramesInFlight(GLint nFrames);
+        inline GLint GetFramesInFlight(void) { return nFramesInFlight; }
+
+        // Around everything a frame draws. BeginFrame() waits for the frame
+        // that last had this frame's index, and runs whatever callbacks are due.
+        void BeginFrame(void);
+        void EndFrame(void);
+
+        // Which copy of a per-frame resource to use, 0 to GetFramesInFlight() - 1
+        inline GLint GetFrameIndex(void) { return iFrameIndex; }
+
+        // Frames are numbered from 1, by BeginFrame()
+        inline GLuint64 GetFrameNumber(void) { return nFrameNumber; }
+
+        // The last frame the GPU has finished. Checks the fences, doesn't wait.
+        GLuint64 GetCompletedFrame(void);
+        bool IsFrameComplete(GLuint64 nFrame);
+
+        void WaitForFrame(GLuint64 nFrame);
+        void WaitIdle(void);
+
+        // Called once the GPU has finished everything sent before the next
+        // EndFrame(). Callbacks run in the order they were added.
+        void OnFrameComplete(GLT_FRAME_CALLBACK pCallback, void *pUserData);
+
+        // Frames fenced but not finished yet, and how often BeginFrame() or
+        // WaitForFrame() had to wait on one
+        inline GLint GetFramesPending(void) { return (GLint)inFlight.size(); }
+        inline GLuint GetStallCount(void) { return nStalls; }
+
+    protected:
+        struct FRAMECALLBACK {
+            GLT_FRAME_CALLBACK  pCallback;
+            void                *pUserData;
+            };
+
+        struct FRAMERECORD {
+            GLuint64                    nFrame;
+            GLsync                      fence;
+            std::vector<FRAMECALLBACK>  callbacks;
+            };
+
+        void Retire(GLuint64 nWaitFor);
+        bool WaitFence(GLsync fence, bool bBlock);
+
+        std::deque<FRAMERECORD>     inFlight;       // Oldest first
+        std::vector<FRAMECALLBACK>  callbacks;      // For the frame not fenced yet
+
+        GLint                       nFramesInFlight;
+        GLint                       nNextFramesInFlight;
+        GLint                       iFrameIndex;
+        GLuint64                    nFrameNumber;
+        GLuint64                    nCompletedFrame;
+        GLuint                      nStalls;
+    };
+
+#endif // __GLT_FRAME_SYNC__
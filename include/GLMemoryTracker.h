@@ -0,0 +1,132 @@
+/*
+GLMemoryTracker.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Keeps count of the GPU memory GLTools objects hold: vertex, index,
+ *  texture, and framebuffer bytes, with totals, high-water marks, and who
+ *  holds what. The batches, frame buffers, and upload queue report to it
+ *  as they allocate and free; your own objects can too.
+ *
+ *  Each object is known by its address, and each texture by its name in
+ *  the current context, since textures outlive whatever made them. A
+ *  texture is forgotten when it's deleted through the GLStateCache, in the
+ *  same context it was reported in. Tags say what an object is, so a
+ *  slow leak shows up in Report() as one tag that keeps growing.
+ *
+ *  A budget calls you back when a total goes over it. There is one tracker
+ *  for the whole process, since all the contexts share the same GPU.
+*/
+
+#ifndef __GLT_MEMORY_TRACKER__
+#define __GLT_MEMORY_TRACKER__
+
+#include "GLStateCache.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+// GLT_MEMORY_ALL, wherever a category is asked for, means all of them together
+enum GLT_MEMORY_CATEGORY { GLT_MEMORY_VERTEX = 0, GLT_MEMORY_INDEX, GLT_MEMORY_TEXTURE, GLT_MEMORY_FRAMEBUFFER, GLT_MEMORY_ALL };
+
+// Called on whichever thread pushed the total over the budget
+typedef void (*GLT_MEMORY_BUDGET_CALLBACK)(GLT_MEMORY_CATEGORY eCategory, GLsizeiptr nTotal, GLsizeiptr nBudget, void *pUserData);
+
+struct GLTMEMORYENTRY
+    {
+    const void          *pOwner;            // The context, for textures
+    GLuint              uiTexture;
+    GLT_MEMORY_CATEGORY eCategory;
+    GLsizeiptr          nBytes;
+    std::string         strTag;
+    };
+
+class GLMemoryTracker
+    {
+    public:
+        GLMemoryTracker(void);
+
+        static GLMemoryTracker* GetMemoryTracker(void);
+
+        // What an object holds in a category, replacing what it held before.
+        // Zero forgets it. szTag is used only if the object hasn't been given one.
+        void SetUsage(GLT_MEMORY_CATEGORY eCategory, const void *pOwner, GLsizeiptr nBytes, const char *szTag = NULL);
+        void Forget(const void *pOwner);
+
+        void SetTextureUsage(GLuint uiTexture, GLsizeiptr nBytes, const char *szTag = NULL);
+        void ForgetTexture(GLuint uiTexture);
+
+        // Name an object, before or after it allocates anything
+        void SetTag(const void *pOwner, const char *szTag);
+
+        GLsizeiptr GetTotal(GLT_MEMORY_CATEGORY eCategory = GLT_MEMORY_ALL);
+        GLsizeiptr GetHighWater(GLT_MEMORY_CATEGORY eCategory = GLT_MEMORY_ALL);
+        GLint GetObjectCount(GLT_MEMORY_CATEGORY eCategory = GLT_MEMORY_ALL);
+        void ResetHighWater(void);
+
+        // pCallback is called once each time the total goes over nBytes, and
+        // again only after it has come back under. Zero bytes turns it off.
+        void SetBudget(GLT_MEMORY_CATEGORY eCategory, GLsizeiptr nBytes,
+                       GLT_MEMORY_BUDGET_CALLBACK pCallback, void *pUserData = NULL);
+
+        void GetEntries(std::vector<GLTMEMORYENTRY>& entries);
+
+        // Totals for each category, then for each tag, biggest first
+        void Report(FILE *pFile);
+
+    protected:
+        struct MEMORYENTRY {
+            GLsizeiptr  nBytes;
+            std::string strTag;                 // Unless the owner has one of its own
+            };
+
+        struct MEMORYBUDGET {
+            GLsizeiptr                  nBytes;
+            GLT_MEMORY_BUDGET_CALLBACK  pCallback;
+            void                        *pUserData;
+            bool                        bOver;
+            };
+
+        // Textures are kept under their context and name
+        typedef std::pair<const void*, GLuint>  MEMORYKEY;
+
+        void Change(GLint eCategory, const MEMORYKEY& key, GLsizeiptr nBytes, const char *szTag);
+        void CheckBudgets(GLint eCategory);
+        std::string TagFor(const MEMORYKEY& key, const MEMORYENTRY& entry);
+
+        std::mutex                              trackerMutex;
+        std::map<MEMORYKEY, MEMORYENTRY>        entries[GLT_MEMORY_ALL];
+        std::map<const void*, std::string>      tags;
+        GLsizeiptr                              totals[GLT_MEMORY_ALL + 1];
+        GLsizeiptr                              highWater[GLT_MEMORY_ALL + 1];
+        MEMORYBUDGET                            budgets[GLT_MEMORY_ALL + 1];
+
+        // Budgets gone over, called once the lock is let go
+        std::vector<GLint>                      crossed;
+    };
+
+#endif // __GLT_MEMORY_TRACKER__
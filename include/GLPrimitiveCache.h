@@ -0,0 +1,91 @@
+/*
+GLPrimitiveCache.h
+ 
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  The stock shapes are usually asked for with the same handful of parameters
+ *  over and over. This class makes each one once, uploads it once, and hands out
+ *  shared references to the same GLTriangleBatch from then on. Draw many copies
+ *  with GLTriangleBatch::DrawInstanced().
+ *
+ *  Give it a directory and the meshes are also saved there the first time they
+ *  are made, and loaded from there instead of generated on later runs.
+*/
+
+#ifndef __GLT_PRIMITIVE_CACHE__
+#define __GLT_PRIMITIVE_CACHE__
+
+#include <map>
+#include <memory>
+
+#include "GLTools.h"
+
+enum GLT_PRIMITIVE { GLT_PRIMITIVE_SPHERE = 0, GLT_PRIMITIVE_TORUS, GLT_PRIMITIVE_DISK, GLT_PRIMITIVE_CYLINDER, GLT_PRIMITIVE_LAST };
+
+class GLPrimitiveCache
+    {
+    public:
+        GLPrimitiveCache(void);
+        ~GLPrimitiveCache(void);
+
+        // Optional. NULL turns the disk cache back off.
+        void SetCacheDirectory(const char *szDirectory);
+
+        // Same parameters as the gltMake* functions
+        std::shared_ptr<GLTriangleBatch> Sphere(GLfloat fRadius, GLint iSlices, GLint iStacks);
+        std::shared_ptr<GLTriangleBatch> Torus(GLfloat majorRadius, GLfloat minorRadius, GLint numMajor, GLint numMinor);
+        std::shared_ptr<GLTriangleBatch> Disk(GLfloat innerRadius, GLfloat outerRadius, GLint nSlices, GLint nStacks, GLfloat fDegrees = 360.0f);
+        std::shared_ptr<GLTriangleBatch> Cylinder(GLfloat baseRadius, GLfloat topRadius, GLfloat fLength,
+                                                    GLint numSlices, GLint numStacks, GLfloat fDegrees = 360.0f);
+
+        // Let go of every mesh nobody else is holding on to
+        void Purge(void);
+
+        // Let go of everything. Meshes still in use elsewhere live on.
+        inline void Clear(void) { cache.clear(); }
+        inline size_t GetCount(void) { return cache.size(); }
+
+    protected:
+        // Which generator, and everything that was passed to it
+        struct PRIMITIVEKEY {
+            GLT_PRIMITIVE   primitive;
+            GLfloat         fParams[6];
+
+            bool operator<(const PRIMITIVEKEY& other) const
+                {
+                if(primitive != other.primitive)
+                    return primitive < other.primitive;
+                return memcmp(fParams, other.fParams, sizeof(fParams)) < 0;
+                }
+            };
+
+        std::shared_ptr<GLTriangleBatch> Lookup(const PRIMITIVEKEY& key);
+        void Generate(const PRIMITIVEKEY& key, GLTriangleBatch& batch);
+        bool GetCacheFileName(const PRIMITIVEKEY& key, char *szFileName, size_t nLength);
+
+        std::map<PRIMITIVEKEY, std::shared_ptr<GLTriangleBatch> > cache;
+        char szCacheDirectory[MAX_CACHE_PATH_LENGTH];
+    };
+
+#endif // __GLT_PRIMITIVE_CACHE__
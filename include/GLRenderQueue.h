@@ -0,0 +1,103 @@
+/*
+GLRenderQueue.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Collects a frame's worth of draws and puts them in a better order before
+ *  drawing them. Each draw is a batch, a stock shader, the object's matrices and
+ *  color, a texture, and its distance from the eye. These are packed into a 64-bit
+ *  key, and the keys are radix sorted.
+ *
+ *  Opaque draws come first, grouped by shader, then texture, then batch, and
+ *  front to back within a group. Transparent draws follow, strictly back to front,
+ *  with blending on and depth writes off.
+ *
+ *  All the objects go to the shader manager's object block in one upload, in the
+ *  sorted order, so the lighting shaders also need SetFrame() called beforehand.
+*/
+
+#ifndef __GLT_RENDER_QUEUE__
+#define __GLT_RENDER_QUEUE__
+
+#include "GLTools.h"
+#include <vector>
+#include <unordered_map>
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLRenderQueue : public QOpenGLExtraFunctions
+#else
+class GLRenderQueue
+#endif
+    {
+    public:
+        GLRenderQueue(void);
+
+        // fDepth is the distance from the eye, -mvMatrix[14] is usually close enough.
+        // The texture is bound to GL_TEXTURE_2D on unit 0. Zero means no texture.
+        void Submit(GLBatchBase *pBatch, GLT_STOCK_SHADER nShaderID, const GLTObjectData& object,
+                    GLuint uiTexture = 0, GLfloat fDepth = 0.0f, bool bTransparent = false);
+
+        // Sort and draw everything submitted since the last Clear()
+        void Draw(GLShaderManager& shaderManager);
+        void Clear(void);
+
+        inline GLuint GetDrawCount(void) { return (GLuint)submissions.size(); }
+
+        // Shader, batch, and texture changes the last Draw() made, and how many
+        // more there would have been in the order they were submitted
+        inline GLuint GetStateChanges(void) { return nStateChanges; }
+        inline GLuint GetStateChangesAvoided(void) { return nStateChangesAvoided; }
+
+    protected:
+        struct SUBMISSION {
+            GLBatchBase     *pBatch;
+            GLint           nShaderID;
+            GLuint          uiTexture;
+            };
+
+        struct SORTENTRY {
+            uint64_t        key;
+            GLuint          iSubmission;
+            };
+
+        uint64_t MakeKey(GLint nShaderID, GLuint iTexture, GLuint iBatch, GLfloat fDepth, bool bTransparent);
+        void RadixSort(void);
+        static GLuint CountStateChanges(const SUBMISSION *pFirst, const SUBMISSION *pSecond);
+
+        std::vector<SUBMISSION>     submissions;
+        std::vector<GLTObjectData>  objects;
+        std::vector<SORTENTRY>      sortEntries;
+        std::vector<SORTENTRY>      sortScratch;
+        std::vector<GLTObjectData>  sortedObjects;
+
+        // Batches and textures are numbered in the order they are first seen
+        std::unordered_map<GLBatchBase*, GLuint>    batchIDs;
+        std::unordered_map<GLuint, GLuint>          textureIDs;
+
+        GLuint  nStateChanges;
+        GLuint  nStateChangesAvoided;
+    };
+
+#endif // __GLT_RENDER_QUEUE__
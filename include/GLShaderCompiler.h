@@ -0,0 +1,111 @@
+/*
+GLShaderCompiler.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Builds many shader programs at once, without stalling. Add() them all, then
+ *  Submit(), which starts every compile and every link before asking the driver
+ *  about any of them. Poll() once a frame collects the ones that are done, so a
+ *  loading screen keeps drawing while the shaders warm up. Finish() waits for
+ *  the rest.
+ *
+ *  With GL_KHR_parallel_shader_compile the driver works on them in the
+ *  background, and Poll() never waits. Without it, asking about a program waits
+ *  for it, so each Poll() only collects a few.
+ *
+ *  Programs saved in the GLTools program cache are loaded from there instead.
+ *  Finished programs belong to the caller.
+*/
+
+#ifndef __GLT_SHADER_COMPILER__
+#define __GLT_SHADER_COMPILER__
+
+#include "GLTools.h"
+#include <vector>
+#include <string>
+
+enum GLT_PROGRAM_STATUS { GLT_PROGRAM_QUEUED = 0, GLT_PROGRAM_PENDING, GLT_PROGRAM_READY, GLT_PROGRAM_FAILED };
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLShaderCompiler : public QOpenGLExtraFunctions
+#else
+class GLShaderCompiler
+#endif
+    {
+    public:
+        GLShaderCompiler(void);
+
+        // Returns a handle for the program. The source is copied.
+        GLint Add(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+                  const GLint *pIndexes, const char * const *pNames, const char *szName = NULL);
+
+        // The same arguments as gltLoadShaderPairSrcWithAttributes()
+        GLint AddShaderPairSrcWithAttributes(const char *szVertexSrc, const char *szFragmentSrc, ...);
+
+        // Start everything that's been added since the last time
+        void Submit(void);
+
+        // Collect whatever has finished. Without the extension, no more than
+        // nMaxWaits programs are waited on. True when nothing is left pending.
+        bool Poll(GLint nMaxWaits = 1);
+
+        // Wait for everything
+        void Finish(void);
+
+        GLT_PROGRAM_STATUS GetStatus(GLint iHandle);
+        GLuint GetProgram(GLint iHandle);        // 0 until it's ready
+        inline GLint GetPendingCount(void) { return nPending; }
+        inline bool IsParallel(void) { return bParallel; }
+
+        // Forget every handle. Programs already handed out are not deleted.
+        void Clear(void);
+
+    protected:
+        struct PROGRAMENTRY {
+            std::string         strVertexSrc;
+            std::string         strFragmentSrc;
+            std::string         strName;
+            GLint               nAttributes;
+            GLint               iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+            std::string         strAttributes[GLT_MAX_SHADER_ATTRIBUTES];
+            GLuint              hVertexShader;
+            GLuint              hFragmentShader;
+            GLuint              hProgram;
+            uint64_t            key;
+            bool                bCache;
+            GLT_PROGRAM_STATUS  status;
+            };
+
+        void Complete(PROGRAMENTRY& entry);
+
+        std::vector<PROGRAMENTRY>   entries;
+        GLint                       nPending;
+        GLint                       iFirstPending;     // Nothing before this is pending
+        bool                        bParallel;
+        bool                        bChecked;          // For the extension
+    };
+
+#endif // __GLT_SHADER_COMPILER__
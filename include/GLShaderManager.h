@@ -42,7 +42,7 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 #endif
 
 #if defined ( ANDROID_NDK )
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #elif defined ( __EMSCRIPTEN__ )
 #define GL3_PROTOTYPES
 		#include <GLES3/gl3.h>
@@ -55,25 +55,69 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include "math3d.h"
 
 // Maximum length of shader name
 #define MAX_SHADER_NAME_LENGTH	64
 
 enum GLT_STOCK_SHADER { GLT_SHADER_IDENTITY = 0, GLT_SHADER_FLAT, GLT_SHADER_SHADED, GLT_SHADER_DEFAULT_LIGHT, GLT_SHADER_POINT_LIGHT_DIFF, GLT_SHADER_TEXTURE_REPLACE, GLT_SHADER_TEXTURE_MODULATE, GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF,
-                                GLT_SHADER_POINT_SPRITES, GLT_POINT_SPRITES_PLAIN, GLT_SHADER_LAST };
+                                GLT_SHADER_POINT_SPRITES, GLT_POINT_SPRITES_PLAIN, GLT_SHADER_INSTANCED_BOX, GLT_SHADER_LAST };
 
 
 enum GLT_SHADER_ATTRIBUTE { GLT_ATTRIBUTE_VERTEX = 0, GLT_ATTRIBUTE_COLOR, GLT_ATTRIBUTE_NORMAL, 
                                     GLT_ATTRIBUTE_TEXTURE0, GLT_ATTRIBUTE_TEXTURE1, GLT_ATTRIBUTE_TEXTURE2, GLT_ATTRIBUTE_TEXTURE3,
+                                    GLT_ATTRIBUTE_INSTANCE_CENTER, GLT_ATTRIBUTE_INSTANCE_EXTENT, GLT_ATTRIBUTE_INSTANCE_COLOR,
                                     GLT_ATTRIBUTE_LAST};
 
+// Uniforms used by the stock shaders. Not every shader has every one.
+enum GLT_STOCK_UNIFORM { GLT_UNIFORM_MVP_MATRIX = 0, GLT_UNIFORM_MV_MATRIX, GLT_UNIFORM_NORMAL_MATRIX, GLT_UNIFORM_COLOR,
+                                    GLT_UNIFORM_TEXTURE_UNIT0, GLT_UNIFORM_OBJECT, GLT_UNIFORM_LAST };
+
+// The stock shaders share two std140 uniform blocks. GLTFrame holds what is
+// the same for every draw in a frame. GLTObjects holds per-object values for
+// a whole pass, GLT_BLOCK_OBJECTS at a time. These structures match them.
+#define GLT_FRAME_BLOCK_BINDING     0
+#define GLT_OBJECT_BLOCK_BINDING    1
+#define GLT_BLOCK_OBJECTS           64
+
+struct GLTFrameData {
+    M3DMatrix44f    pMatrix;
+    M3DVector4f     vLightPos;      // Eye coordinates, w ignored
+    };
+
+struct GLTObjectData {
+    M3DMatrix44f    mvMatrix;
+    M3DMatrix44f    mvpMatrix;
+    GLfloat         normalMatrix[12];   // mat3, each column padded to a vec4
+    M3DVector4f     vColor;
+    };
+
 
 struct SHADERLOOKUPENTRY {
 	char szVertexShaderName[MAX_SHADER_NAME_LENGTH];
 	char szFragShaderName[MAX_SHADER_NAME_LENGTH];
 	GLuint uiShaderID;
+	GLint nReferences;		// One for each time it was loaded
+
+	// Programs loaded from files remember how, so they can be reloaded
+	std::string strVertexFile;
+	std::string strFragFile;
+	std::vector<GLint> attributeIndexes;
+	std::vector<std::string> attributeNames;
+	GLint iReload;			// Compiler handle while a reload builds, or -1
+	uint64_t reloadKey;		// The table key it will have after that
+	bool bReloadAgain;		// Its files changed again while it was building
+	std::vector<GLuint> oldPrograms;	// Replaced by reloads, still held by someone
+
+	std::unordered_map<std::string, GLint> uniforms;	// See GetUniformLocation()
 	};
 
+class GLShaderCompiler;
+
 #ifdef QT_IS_AVAILABLE
     class GLShaderManager: protected QOpenGLExtraFunctions
 #else
@@ -88,10 +132,65 @@ class GLShaderManager
 		
 		// Call before using
 		bool InitializeStockShaders(void);
+
+		// Optional, and before InitializeStockShaders(). Linked programs are kept
+		// here between runs, see GLTools::gltSetProgramCacheDirectory().
+		void SetProgramCacheDirectory(const char *szDirectory);
 	
 		// Use a stock shader, and pass in the parameters needed
 		GLint UseStockShader(int nShaderID, ...);
 
+		// Or, the same thing with the parameters spelled out. These point at the
+		// caller's matrices and colors, so a set of parameters can be filled in once
+		// and reused. Values that haven't changed since they were last sent to the
+		// shader aren't sent again. NULL pointers leave that uniform alone.
+		// pMatrix and vLightPos go to the shared frame block, the same as SetFrame().
+		// The lighting shaders get their mvp and normal matrices from mvMatrix and
+		// that projection, so send pMatrix before or with mvMatrix.
+		struct IdentityParams		{ const GLfloat *vColor; };
+		struct FlatParams			{ const GLfloat *mvpMatrix; const GLfloat *vColor; };
+		struct ShadedParams			{ const GLfloat *mvpMatrix; };
+		struct DefaultLightParams	{ const GLfloat *mvMatrix; const GLfloat *pMatrix; const GLfloat *vColor; };
+		struct PointLightParams		{ const GLfloat *mvMatrix; const GLfloat *pMatrix; const GLfloat *vLightPos; const GLfloat *vColor; };
+		struct TextureReplaceParams	{ const GLfloat *mvpMatrix; GLint iTextureUnit; };
+		struct TextureModulateParams	{ const GLfloat *mvpMatrix; const GLfloat *vColor; GLint iTextureUnit; };
+		struct TexturePointLightParams	{ const GLfloat *mvMatrix; const GLfloat *pMatrix; const GLfloat *vLightPos; const GLfloat *vColor; GLint iTextureUnit; };
+		struct PointSpriteParams	{ const GLfloat *mvpMatrix; GLint iTextureUnit; };
+		struct PointSpritePlainParams	{ const GLfloat *mvpMatrix; };
+		struct InstancedBoxParams	{ const GLfloat *mvpMatrix; };
+
+		GLuint Use(const IdentityParams& params);
+		GLuint Use(const FlatParams& params);
+		GLuint Use(const ShadedParams& params);
+		GLuint Use(const DefaultLightParams& params);
+		GLuint Use(const PointLightParams& params);
+		GLuint Use(const TextureReplaceParams& params);
+		GLuint Use(const TextureModulateParams& params);
+		GLuint Use(const TexturePointLightParams& params);
+		GLuint Use(const PointSpriteParams& params);
+		GLuint Use(const PointSpritePlainParams& params);
+		GLuint Use(const InstancedBoxParams& params);
+
+		// Forget what was last sent to the stock shaders, if something else may have
+		// changed their uniforms behind our back
+		void InvalidateUniformCache(void);
+
+		// Once per frame. Binds the shared blocks and updates them if need be.
+		void SetFrame(const GLTFrameData& frame);
+
+		// Upload the per-object data for a pass, then draw each object with
+		// UseObject() instead of passing its matrices and color one at a time.
+		void SetObjects(const GLTObjectData *pObjects, GLsizei nObjects);
+		GLuint UseObject(int nShaderID, GLint iObject, GLint iTextureUnit = 0);
+
+		// Fill in one object, including its mvp and normal matrices
+		static void MakeObjectData(GLTObjectData& object, const M3DMatrix44f mvMatrix,
+									const M3DMatrix44f pMatrix, const M3DVector4f vColor);
+
+		// Location of a stock shader uniform, or -1 if it doesn't have one
+		inline GLint GetStockUniformLocation(int nShaderID, GLT_STOCK_UNIFORM uniform)
+			{ return iStockUniforms[nShaderID][uniform]; }
+
 		// Load a shader pair from file, return NULL or shader handle. 
 		// Vertex program name (minus file extension)
 		// is saved in the lookup table
@@ -104,9 +203,84 @@ class GLShaderManager
 		GLuint LoadShaderPairWithAttributes(const char *szVertexProgFileName, const char *szFragmentProgFileName, ...);
 		GLuint LoadShaderPairSrcWithAttributes(const char *szName, const char *szVertexProg, const char *szFragmentProg, ...);
 
+		// Loading the same names, source, and attributes again returns the same
+		// program, and counts another reference to it. Release it once for each
+		// load. Whatever is left is freed by freeGL(). A NULL name for the source
+		// loaders skips the table, and the program is all yours.
+		void ReleaseShader(GLuint uiShader);
+
+		// Find a loaded program by name. The fragment name defaults to the vertex
+		// name, which is what the source loaders use for both.
+		GLuint LookupShader(const char *szVertexProg, const char *szFragProg = NULL);
+		inline size_t GetShaderCount(void) { return shaderTable.size(); }
+
+		// Location of a uniform in a loaded program, looked up the first time
+		// it's asked for. Reloads look them all up again.
+		GLint GetUniformLocation(GLuint uiShader, const char *szUniform);
+
+		// Watch the files behind LoadShaderPair() and LoadShaderPairWithAttributes(),
+		// and rebuild the programs when they change. Needs inotify, so false
+		// anywhere but Linux.
+		bool WatchShaderFiles(bool bWatch = true);
+
+		// Once a frame, with the context current. Starts rebuilding programs whose
+		// files changed, and swaps in the ones that have linked. The handle stays
+		// the same when the driver can hand over a program binary; otherwise the
+		// program gets a new one, which LookupShader() returns. Without binaries
+		// (always on WebGL) whoever holds the old handle keeps drawing the old
+		// program until they look it up again; it lives until its last
+		// ReleaseShader(). A program that fails to build keeps the old one. Either
+		// way, uniform values go back to their defaults. Returns how many were
+		// swapped.
+		GLint UpdateShaders(void);
+
 	
 	protected:
 		GLuint	uiStockShaders[GLT_SHADER_LAST];
+		GLint	iStockUniforms[GLT_SHADER_LAST][GLT_UNIFORM_LAST];
+
+		// The last value sent to each stock uniform
+		struct UNIFORMCACHE {
+			GLfloat	fValue[16];
+			bool	bValid;
+			};
+		UNIFORMCACHE uniformCache[GLT_SHADER_LAST][GLT_UNIFORM_LAST];
+
+		// Shared uniform blocks, and a copy of what is in the frame block
+		GLuint			uiFrameBuffer;
+		GLuint			uiObjectBuffer;
+		GLTFrameData	frameData;
+		GLsizeiptr		nObjectWindowStride;	// Each GLT_BLOCK_OBJECTS, padded for alignment
+		GLint			iObjectWindow;			// Which one is bound
+
+		GLuint BindStockShader(int nShaderID);
+		void SetFrameProjection(const GLfloat *pMatrix);
+		void SetFrameLight(const GLfloat *vLightPos);
+		void BindObjectWindow(GLint iWindow);
+		void SetLightMatrices(int nShaderID, const GLfloat *mvMatrix);
+
+		bool UniformChanged(int nShaderID, GLT_STOCK_UNIFORM uniform, const void *pValue, size_t nBytes);
+		void SetUniformMatrix(int nShaderID, GLT_STOCK_UNIFORM uniform, const GLfloat *pMatrix);
+		void SetUniformMatrix3(int nShaderID, GLT_STOCK_UNIFORM uniform, const GLfloat *pMatrix);
+		void SetUniform4(int nShaderID, GLT_STOCK_UNIFORM uniform, const GLfloat *pVector);
+		void SetUniformInt(int nShaderID, GLT_STOCK_UNIFORM uniform, GLint iValue);
+
+		// Loaded programs, by a hash of their names, source, and attributes
+		std::unordered_map<uint64_t, SHADERLOOKUPENTRY> shaderTable;
+		std::unordered_map<std::string, uint64_t> shaderNames;	// The entry each pair of names finds
+
+		GLuint RegisterShader(const char *szVertexName, const char *szFragName, const char *szVertexSrc,
+								const char *szFragSrc, GLint nAttributes, const GLint *pIndexes, const char * const *pNames,
+								bool bFiles = false);
+
+		// Hot reloading
+		int									iWatchFile;			// inotify, or -1
+		std::unordered_map<int, std::string>	watchDirectories;	// By watch descriptor
+		GLShaderCompiler					*pReloadCompiler;
+		bool								bReloadsWaiting;	// Some entry has bReloadAgain to start
+
+		void WatchEntry(const SHADERLOOKUPENTRY& entry);
+		void SwapProgram(SHADERLOOKUPENTRY& entry, GLuint uiProgram);
 	};
 
 
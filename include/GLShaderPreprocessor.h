@@ -0,0 +1,88 @@
+/*
+GLShaderPreprocessor.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  A small preprocessor for shader source, run before the driver's own. It
+ *  does three things:
+ *
+ *  - Puts the right #version line first, unless the source has its own.
+ *  - Adds a #define for each name in a list, such as "GLT_TEXTURE COUNT=4".
+ *    The shader's own #ifdefs then pick out one variant of the source.
+ *  - Replaces each #include "name" line with that text. Includes added with
+ *    AddInclude() are looked for first, then files in the include directory.
+ *    Each one is only pasted in once, and they can nest.
+ *
+ *  Conditionals are left to the driver, so an #include is pasted in even when
+ *  it sits inside an #ifdef that is off.
+*/
+
+#ifndef __GLT_SHADER_PREPROCESSOR__
+#define __GLT_SHADER_PREPROCESSOR__
+
+#include "GLTools.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Used when the source doesn't start with a #version line
+#ifndef OPENGL_ES
+#define GLT_SHADER_VERSION      "#version 400\n"
+#else
+#define GLT_SHADER_VERSION      "#version 300 es\n"
+#endif
+
+// How deep includes can nest
+#define GLT_MAX_INCLUDE_DEPTH   16
+
+class GLShaderPreprocessor
+    {
+    public:
+        GLShaderPreprocessor(void);
+
+        // Text to use for #include "szName". Copied.
+        void AddInclude(const char *szName, const char *szSource);
+
+        // Where to look for includes that weren't added. NULL for nowhere.
+        void SetIncludeDirectory(const char *szDirectory);
+
+        // Instead of GLT_SHADER_VERSION. Include the newline.
+        inline void SetVersion(const char *szVersion) { strVersion = szVersion; }
+
+        // szDefines is a space separated list, and may be NULL. Returns false,
+        // and logs why, if an include couldn't be found.
+        bool Process(const char *szSource, const char *szDefines, std::string& strOut);
+
+    protected:
+        bool Expand(const char *szSource, std::string& strOut, int iDepth);
+        bool FindInclude(const std::string& strName, std::string& strSource);
+
+        std::unordered_map<std::string, std::string>   includes;
+        std::vector<std::string>                        included;      // Already pasted in, this time
+        std::string                                     strVersion;
+        char                                            szIncludeDirectory[MAX_CACHE_PATH_LENGTH];
+    };
+
+#endif // __GLT_SHADER_PREPROCESSOR__
@@ -0,0 +1,93 @@
+/*
+GLShaderVariants.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Many programs from one pair of shaders. Each feature flag has a name, and
+ *  a variant gets a #define for every flag set in its mask, so the source's own
+ *  #ifdefs decide what goes in it:
+ *
+ *      #ifdef GLT_TEXTURE
+ *      in vec2 vTexCoord0;
+ *      #endif
+ *
+ *  Precompile() the variants the application will use while it loads. They
+ *  are built together by a GLShaderCompiler, through the program cache, so the
+ *  second run loads them instead. Any other variant is built the first time
+ *  GetProgram() asks for it.
+*/
+
+#ifndef __GLT_SHADER_VARIANTS__
+#define __GLT_SHADER_VARIANTS__
+
+#include "GLShaderPreprocessor.h"
+#include "GLShaderCompiler.h"
+
+class GLShaderVariants
+    {
+    public:
+        GLShaderVariants(void);
+        ~GLShaderVariants(void);
+
+        // Copied. Every variant binds the same attributes; ones it doesn't
+        // use are ignored.
+        void SetSource(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+                       const GLint *pIndexes, const char * const *pNames);
+
+        // Bit n of a mask defines pNames[n]. No more than 32.
+        void SetFeatureNames(const char * const *pNames, GLint nNames);
+
+        // For includes and the version line
+        inline GLShaderPreprocessor& GetPreprocessor(void) { return preprocessor; }
+
+        // Start building these. Poll() and Finish() are as for GLShaderCompiler.
+        void Precompile(const GLuint *pVariants, GLint nVariants);
+        inline bool Poll(GLint nMaxWaits = 1) { return compiler.Poll(nMaxWaits); }
+        inline void Finish(void) { compiler.Finish(); }
+
+        // Waits for the program if it isn't ready. 0 if it failed.
+        GLuint GetProgram(GLuint uiVariant);
+        GLT_PROGRAM_STATUS GetStatus(GLuint uiVariant);
+        inline GLint GetVariantCount(void) { return (GLint)variants.size(); }
+
+        // Delete every variant's program
+        void Free(void);
+
+    protected:
+        GLint Submit(GLuint uiVariant);
+
+        GLShaderPreprocessor                preprocessor;
+        GLShaderCompiler                    compiler;
+        std::unordered_map<GLuint, GLint>   variants;           // Mask to compiler handle
+
+        std::string                         strVertexSrc;
+        std::string                         strFragmentSrc;
+        GLint                               nAttributes;
+        GLint                               iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+        std::string                         strAttributes[GLT_MAX_SHADER_ATTRIBUTES];
+        std::vector<std::string>            featureNames;
+    };
+
+#endif // __GLT_SHADER_VARIANTS__
@@ -0,0 +1,153 @@
+/*
+GLStateCache.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Remembers what is bound to the context, so that binding it again costs
+ *  nothing. Every bind in GLTools goes through here, which means the batches
+ *  can leave their vertex arrays bound after drawing instead of unbinding them.
+ *
+ *  The cache only knows about binds it has seen. If your own code binds
+ *  programs, vertex arrays, buffers, textures, or framebuffers directly, either
+ *  use these functions instead, or call Invalidate() before GLTools draws again.
+ *  Objects must be deleted through here too, or the names may be reused while
+ *  the cache still thinks they are bound.
+*/
+
+#ifndef __GLT_STATE_CACHE__
+#define __GLT_STATE_CACHE__
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+#endif
+
+#ifdef __APPLE__
+#include <TargetConditionals.h>
+#if TARGET_OS_IPHONE | TARGET_IPHONE_SIMULATOR
+#include <OpenGLES/ES3/gl.h>
+#define OPENGL_ES
+#else
+#include <OpenGL/gl.h>		// Apple OpenGL haders (version depends on OS X SDK version)
+#endif
+#endif
+
+#if defined ( ANDROID_NDK )
+#include <GLES3/gl3.h>
+#elif defined ( __EMSCRIPTEN__ )
+#define GL3_PROTOTYPES
+		#include <GLES3/gl3.h>
+#endif
+#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
+#define GL_GLEXT_PROTOTYPES
+        #include <GLES2/gl2ext.h>
+#endif
+
+#include <stddef.h>
+#include <thread>
+#include "math3d.h"
+
+// Texture units we keep track of. Binds to units past this always go through.
+#define GLT_STATE_TEXTURE_UNITS     16
+
+// Nothing is known about this binding
+#define GLT_STATE_UNKNOWN           0xFFFFFFFF
+
+#ifdef QT_IS_AVAILABLE
+class GLStateCache : public QOpenGLExtraFunctions
+#else
+class GLStateCache
+#endif
+    {
+    public:
+        GLStateCache(void);
+
+        // The cache for the current context, see GLContext.h
+        static GLStateCache* GetStateCache(void);
+
+        // Forget everything. Use after anyone else has changed the bindings.
+        void Invalidate(void);
+
+        void UseProgram(GLuint uiProgram);
+        void BindVertexArray(GLuint uiVertexArray);
+        void BindBuffer(GLenum eTarget, GLuint uiBuffer);
+        void BindBufferBase(GLenum eTarget, GLuint iIndex, GLuint uiBuffer);
+        void BindBufferRange(GLenum eTarget, GLuint iIndex, GLuint uiBuffer, GLintptr nOffset, GLsizeiptr nSize);
+        void ActiveTexture(GLenum eUnit);
+        void BindTexture(GLenum eTarget, GLuint uiTexture);
+        void BindFramebuffer(GLenum eTarget, GLuint uiFramebuffer);
+        void BindRenderbuffer(GLenum eTarget, GLuint uiRenderbuffer);
+
+        // Delete, and forget any bindings to them
+        void DeleteProgram(GLuint uiProgram);
+        void DeleteVertexArrays(GLsizei n, const GLuint *pVertexArrays);
+        void DeleteBuffers(GLsizei n, const GLuint *pBuffers);
+        void DeleteTextures(GLsizei n, const GLuint *pTextures);
+        void DeleteFramebuffers(GLsizei n, const GLuint *pFramebuffers);
+        void DeleteRenderbuffers(GLsizei n, const GLuint *pRenderbuffers);
+
+        // What is current, or GLT_STATE_UNKNOWN
+        inline GLuint GetProgram(void) { return uiCurrentProgram; }
+        inline GLuint GetVertexArray(void) { return uiCurrentVertexArray; }
+
+        // How many bind calls were made, and how many were skipped
+        inline GLuint GetCallsMade(void) { return nCallsMade; }
+        inline GLuint GetCallsSaved(void) { return nCallsSaved; }
+        inline void ResetCounters(void) { nCallsMade = 0; nCallsSaved = 0; }
+
+        // The cache is made with the context current, so this is its thread
+        inline bool IsContextThread(void) { return std::this_thread::get_id() == contextThread; }
+
+    protected:
+        enum { BUFFER_ARRAY = 0, BUFFER_ELEMENT_ARRAY, BUFFER_UNIFORM, BUFFER_COPY_READ, BUFFER_COPY_WRITE,
+                BUFFER_PIXEL_PACK, BUFFER_PIXEL_UNPACK, BUFFER_TRANSFORM_FEEDBACK, BUFFER_LAST };
+        enum { TEXTURE_2D = 0, TEXTURE_CUBE_MAP, TEXTURE_3D, TEXTURE_2D_ARRAY, TEXTURE_LAST };
+
+        int BufferSlot(GLenum eTarget);
+        int TextureSlot(GLenum eTarget);
+        inline bool Changed(GLuint& uiBound, GLuint uiName) {
+            if(uiBound == uiName) {
+                nCallsSaved++;
+                return false;
+                }
+            uiBound = uiName;
+            nCallsMade++;
+            return true;
+            }
+
+        GLuint  uiCurrentProgram;
+        GLuint  uiCurrentVertexArray;
+        GLuint  uiBuffers[BUFFER_LAST];
+        GLuint  iActiveTexture;                     // Zero based
+        GLuint  uiTextures[GLT_STATE_TEXTURE_UNITS][TEXTURE_LAST];
+        GLuint  uiDrawFramebuffer;
+        GLuint  uiReadFramebuffer;
+        GLuint  uiRenderbuffer;
+
+        GLuint  nCallsMade;
+        GLuint  nCallsSaved;
+
+        std::thread::id contextThread;
+    };
+
+#endif // __GLT_STATE_CACHE__
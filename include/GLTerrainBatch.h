@@ -0,0 +1,116 @@
+/*
+GLTerrainBatch.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  A heightfield, cut into square chunks so that each one can be drawn at its
+ *  own level of detail. Every chunk has the same layout, so one index buffer
+ *  holds the triangles for every level, and all the chunks share it. Level n
+ *  uses every 2^n'th sample.
+ *
+ *  Neighboring chunks at different levels don't line up exactly along their
+ *  shared edge. Rather than stitch them, each chunk hangs a skirt down from its
+ *  edges, deep enough to hide any crack.
+ *
+ *  The terrain lies in the xz plane, centered at the origin, with the same
+ *  orientation as gltMakeGrid(). It draws with any stock shader that takes
+ *  vVertex, vNormal, and vTexCoord0. Texture coordinates span the whole terrain.
+*/
+
+#ifndef __GLT_TERRAIN_BATCH__
+#define __GLT_TERRAIN_BATCH__
+
+#include "GLTools.h"
+
+// Most levels of detail we'll build
+#define GLT_TERRAIN_MAX_LODS    8
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLTerrainBatch : public QOpenGLExtraFunctions
+#else
+class GLTerrainBatch
+#endif
+    {
+    public:
+        GLTerrainBatch(void);
+        ~GLTerrainBatch(void);
+
+        // Heights are nWidth x nDepth, row by row. fSpacing is the distance between
+        // samples. nQuads (per chunk side) must be a power of two, no more than 128.
+        bool Build(const GLfloat *pHeights, GLint nWidth, GLint nDepth, GLfloat fSpacing,
+                    GLint nQuads = 128, GLint nLevels = 5);
+
+        // Straight from gltReadTGABits(). Only the red (or luminance) channel is used,
+        // scaled by fHeightScale.
+        bool BuildFromImage(const GLbyte *pBits, GLint nWidth, GLint nDepth, GLenum eFormat,
+                    GLfloat fSpacing, GLfloat fHeightScale, GLint nQuads = 128, GLint nLevels = 5);
+
+        void Free(void);
+
+        // Chunks closer than this are drawn at full detail. Each level after
+        // that covers twice the distance of the one before.
+        inline void SetLODDistance(GLfloat fDistance) { fLODDistance = fDistance; }
+
+        // Pick a level for each chunk by its distance from the eye, and draw them
+        void Draw(const M3DVector3f vEye);
+
+        // Useful for statistics
+        inline GLint GetChunkCount(void) { return nChunksX * nChunksZ; }
+        inline GLint GetLODCount(void) { return nLODs; }
+        inline GLuint GetTrianglesDrawn(void) { return nTrianglesDrawn; }
+
+    protected:
+        struct TERRAINVERTEX {
+            GLfloat     vVertex[3];
+            GLbyte      vNormal[4];         // Normalized, w unused
+            GLushort    vTexCoord[2];       // Normalized
+            };
+
+        struct TERRAINCHUNK {
+            GLuint      vertexArrayObject;
+            GLuint      vertexBufferObject;
+            M3DVector3f vMin;               // Bounding box, skirts and all
+            M3DVector3f vMax;
+            };
+
+        void BuildIndexes(void);
+        void BuildChunk(TERRAINCHUNK& chunk, GLint iChunkX, GLint iChunkZ, const GLfloat *pHeights,
+                        GLint nWidth, GLint nDepth, GLfloat fSpacing, TERRAINVERTEX *pVerts);
+
+        TERRAINCHUNK    *pChunks;
+        GLint           nChunksX;
+        GLint           nChunksZ;
+        GLint           nChunkQuads;
+        GLint           nLODs;
+
+        GLuint          indexBufferObject;                  // Shared by every chunk
+        GLuint          lodFirstIndex[GLT_TERRAIN_MAX_LODS];
+        GLuint          lodIndexCount[GLT_TERRAIN_MAX_LODS];
+
+        GLfloat         fLODDistance;
+        GLuint          nTrianglesDrawn;
+    };
+
+#endif // __GLT_TERRAIN_BATCH__
@@ -43,7 +43,7 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 #endif
 
 #if defined ( ANDROID_NDK )
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #elif defined ( __EMSCRIPTEN__ )
 #define GL3_PROTOTYPES
 		#include <GLES3/gl3.h>
@@ -60,22 +60,33 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <string>
 
 #ifndef _WIN32
 #include <unistd.h>
 #endif
 
-// There is a static block allocated for loading shaders to 
-// prevent heap fragmentation, as this could happend frequently
-// and is likely long enough.
+// Shader files used to be read into a fixed block this big. There's
+// no limit anymore, this is only left for code that still uses it.
 #define MAX_SHADER_LENGTH   8192
 
+// Maximum length of a cache directory path
+#define MAX_CACHE_PATH_LENGTH   512
+
+// Most attributes a shader pair can bind by name
+#define GLT_MAX_SHADER_ATTRIBUTES   16
+
 // Universal includes
 #include <stdio.h>
 #include <math.h>
 #include "math3d.h"
 #include "GLBatch.h"
 #include "GLTriangleBatch.h"
+#include "GLStateCache.h"
+#include "GLDeleteQueue.h"
+#include "GLMemoryTracker.h"
+#include "GLContext.h"
 
 #ifdef QT_IS_AVAILABLE
 class GLTools : public QOpenGLExtraFunctions
@@ -84,15 +95,10 @@ class GLTools
 #endif
     {
 	public:
-		GLTools() { pMe = NULL; }
+		GLTools() { driverHash = 0; nBinaryFormats = -1; }
 		
-		static GLTools* GetGLTools() {
-			if(pMe == NULL) {
-				pMe = new GLTools();
-                pMe->InitializeGL();
-				}
-			return pMe;
-		}
+		// The one for the current context, see GLContext.h
+		static GLTools* GetGLTools();
 
 		void InitializeGL(void) {
             #ifdef QT_IS_AVAILABLE
@@ -102,6 +108,7 @@ class GLTools
 
 	// Shader loading support
 	void gltLoadShaderSrc(const char *szShaderSrc, GLuint shader);
+	void gltLoadShaderSrc(const char *szShaderSrc, GLint nLength, GLuint shader);
     bool gltLoadShaderFile(const char *szFile, GLuint shader);
 
 	GLuint	gltLoadShaderPair(const char *szVertexProg, const char *szFragmentProg);
@@ -110,10 +117,43 @@ class GLTools
 	GLuint gltLoadShaderPairSrc(const char *szVertexSrc, const char *szFragmentSrc);
 	GLuint gltLoadShaderPairSrcWithAttributes(const char *szVertexProg, const char *szFragmentProg, ...);
 
+	// What all of the above come down to. The names are only for error messages.
+	GLuint gltBuildProgram(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+							const GLint *pIndexes, const char * const *pNames,
+							const char *szVertexName = NULL, const char *szFragmentName = NULL);
+	GLuint gltLoadShaderPairFiles(const char *szVertexProg, const char *szFragmentProg, GLint nAttributes,
+							const GLint *pIndexes, const char * const *pNames);
+	bool gltReadShaderFile(const char *szFile, std::string& strSource);
+
+	// Optional. Linked programs are saved here, and loaded from here instead of
+	// compiled on later runs. They're keyed by the source, the attribute bindings,
+	// and the driver, so a driver update just misses. The directory must already
+	// exist. NULL turns the cache back off. It's shared by every context, so set
+	// it before other threads start loading shaders.
+	void gltSetProgramCacheDirectory(const char *szDirectory);
+
+	// For loaders that do their own compiling. False if there's no cache to use.
+	// Programs to be saved need GL_PROGRAM_BINARY_RETRIEVABLE_HINT set before linking.
+	bool gltGetProgramCacheKey(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+							const GLint *pIndexes, const char * const *pNames, uint64_t& key);
+	GLuint gltLoadProgramBinary(uint64_t key);
+	void gltSaveProgramBinary(GLuint program, uint64_t key);
+
+	// After a failed link, say which of the three went wrong, and why
+	void gltLogProgramErrors(GLuint hProgram, GLuint hVertexShader, GLuint hFragmentShader,
+							const char *szVertexName, const char *szFragmentName);
+
+	// Is this extension in the GL_EXTENSIONS list?
+	bool gltIsExtensionSupported(const char *szExtension);
+
 	bool gltCheckErrors(GLuint progName = 0);
 
 	protected:
-		static GLTools*	pMe;
+		bool gltGetProgramCacheFileName(uint64_t key, char *szFileName, size_t nLength);
+
+		static char	szProgramCacheDirectory[MAX_CACHE_PATH_LENGTH];
+		uint64_t	driverHash;			// Vendor, renderer and version, 0 until needed
+		GLint		nBinaryFormats;		// -1 until needed
 
 	public:
 		static GLubyte szVendor[64];
@@ -133,6 +173,15 @@ void gltGetOpenGLVersion(GLint &nMajor, GLint &nMinor);
 // Set working directory to /Resources on the Mac
 void gltSetWorkingDirectory(const char *szArgv);
 
+// 64-bit FNV-1a hash of a block of memory. Pass the last result back in
+// as the seed to hash several blocks as one.
+#define GLT_HASH_SEED   14695981039346656037ULL
+uint64_t gltHashBytes(const void *pData, size_t nBytes, uint64_t hash = GLT_HASH_SEED);
+
+// Pull the attribute count, then each index and name, off a shader loader's
+// argument list. At most GLT_MAX_SHADER_ATTRIBUTES are kept.
+GLint gltGetShaderAttributes(va_list attributeList, GLint *pIndexes, const char **pNames);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Win32 Only
 #ifdef WIN32
@@ -162,7 +211,22 @@ void gltMakeDisk(GLTriangleBatch& diskBatch, GLfloat innerRadius,
                     GLfloat outerRadius, GLint nSlices, GLint nStacks, GLfloat fDegrees = 360.0f);
 void gltMakeCylinder(GLTriangleBatch& cylinderBatch, GLfloat baseRadius, GLfloat topRadius, 
                             GLfloat fLength, GLint numSlices, GLint numStacks, GLfloat fDegrees = 360.0f);
+void gltMakeGrid(GLTriangleBatch& gridBatch, GLfloat fWidth, GLfloat fDepth, GLint nColumns, GLint nRows);
 void gltMakeCube(GLBatch& cubeBatch, GLfloat fRadius);
+void gltMakeCube(GLTriangleBatch& cubeBatch, GLfloat fRadius);
+void gltMakeCubePositions(GLTriangleBatch& cubeBatch, GLfloat fRadius);
+
+// Lots of boxes (bounding volumes, voxels...) in one draw call. Make the cube
+// once, replace the boxes as often as needed, and draw with the
+// GLT_SHADER_INSTANCED_BOX stock shader and cubeBatch.DrawInstanced(nBoxes).
+struct GLTBoxInstance {
+    M3DVector3f vCenter;
+    M3DVector3f vHalfExtent;
+    M3DVector4f vColor;
+    };
+
+void gltMakeInstancedCube(GLTriangleBatch& cubeBatch);
+void gltSetBoxInstances(GLTriangleBatch& cubeBatch, const GLTBoxInstance *pBoxes, GLsizei nBoxes);
 
 
 #endif
@@ -32,6 +32,10 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
  *  When finished, call EndMesh() to free up extra unneeded memory that is reserved
  *  as workspace when you call BeginMesh().
  *
+ *  Generators that already know their topology (the stock gltMake* shapes) can skip
+ *  the search entirely with BeginIndexedMesh(), writing every vertex and triangle
+ *  directly into the workspace with SetVertex() and SetTriangle().
+ *
  *  This class can easily be extended to contain other vertex attributes, and to 
  *  save itself and load itself from disk (thus forming the beginnings of a custom
  *  model file format).
@@ -43,10 +47,13 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 
 #include <stdio.h>
 #include <limits.h>
+#include <string.h>
+#include <assert.h>
 
 #include "math3d.h"
 #include "GLBatchBase.h"
 #include "GLShaderManager.h"
+#include "GLBufferPool.h"
 
 
 #define VERTEX_DATA     0
@@ -54,12 +61,7 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 #define TEXTURE_DATA    2
 #define INDEX_DATA      3
 
-#ifdef QT_IS_AVAILABLE
-#include <qopenglextrafunctions.h>
 class GLTriangleBatch : public GLBatchBase
-#else
-class GLTriangleBatch
-#endif
     {
     public:
         GLTriangleBatch(void);
@@ -70,10 +72,39 @@ class GLTriangleBatch
         void AddTriangle(M3DVector3f verts[3], M3DVector3f vNorms[3], M3DVector2f vTexCoords[3], float epsilon = 0.00001f, int nCheckRange = INT_MAX);
         void End(void);
 
+        // Or, if you already know the topology, write the vertices and indexes directly.
+        // No searching is done, so you must fill in every vertex and every triangle
+        // you asked for. Normals are expected to be unit length. Leave out the
+        // normals and texture coordinates if they'll never be used.
+        void BeginIndexedMesh(GLuint nVerts, GLuint nIndexes, bool bNormals = true, bool bTexCoords = true);
+        inline void SetVertex(GLuint iVertex, const M3DVector3f vVert)
+            {
+            assert(iVertex < nNumVerts);
+            memcpy(pVerts[iVertex], vVert, sizeof(M3DVector3f));
+            }
+        inline void SetVertex(GLuint iVertex, const M3DVector3f vVert, const M3DVector3f vNorm, const M3DVector2f vTexCoord)
+            {
+            assert(iVertex < nNumVerts && pNorms != nullptr && pTexCoords != nullptr);
+            memcpy(pVerts[iVertex], vVert, sizeof(M3DVector3f));
+            memcpy(pNorms[iVertex], vNorm, sizeof(M3DVector3f));
+            memcpy(pTexCoords[iVertex], vTexCoord, sizeof(M3DVector2f));
+            }
+        inline void SetTriangle(GLuint iTriangle, GLuint a, GLuint b, GLuint c)
+            {
+            assert(iTriangle * 3 + 2 < nNumIndexes);
+            pIndexes[iTriangle * 3] = a;
+            pIndexes[iTriangle * 3 + 1] = b;
+            pIndexes[iTriangle * 3 + 2] = c;
+            }
+
         // Useful for statistics
         inline GLuint GetIndexCount(void) { return nNumIndexes; }
         inline GLuint GetVertexCount(void) { return nNumVerts; }
 
+        // A mesh read from a file may be short of either
+        inline bool HasNormals(void) { return pNorms != nullptr; }
+        inline bool HasTexCoords(void) { return pTexCoords != nullptr; }
+
 		inline GLfloat GetBoundingSphere(void) { return boundingSphereRadius; }
 
 		bool SaveMesh(const char *szFileName);
@@ -81,12 +112,33 @@ class GLTriangleBatch
         
         bool SaveMesh(FILE *pFile);
         bool LoadMesh(FILE *pFile, bool bNormals = true, bool bTexCoords = true);
+
+        // LoadMesh() in steps, for loading in the background. ReadMesh() makes
+        // no GL calls, and can run on any thread. UploadBuffers() can run in any
+        // context shared with the one that draws, and MakeVertexArray() has to
+        // run in that one. End() is the last two together. Pass UploadBuffers()
+        // the drawing context's pool; by default it's the current context's.
+        bool ReadMesh(const char *szFileName, bool bNormals = true, bool bTexCoords = true);
+        bool ReadMesh(FILE *pFile, bool bNormals = true, bool bTexCoords = true);
+        void UploadBuffers(GLBufferPool *pPool = NULL);
+        void MakeVertexArray(void);
         
         // Draw - make sure you call glEnableClientState for these arrays
         virtual void Draw(void);
+        void DrawInstanced(GLsizei nInstances);
+        virtual bool GetDrawItem(GLTDrawItem& item);
+
+        // Per-instance data for DrawInstanced(). Call after End(). All the instance
+        // attributes come from one buffer, which CopyInstanceData() replaces.
+        void SetInstanceAttribute(GLuint iAttribute, GLint nComponents, GLsizei nStride, GLsizeiptr nOffset);
+        void CopyInstanceData(const void *pData, GLsizeiptr nBytes);
         
     protected:
-        GLushort  *pIndexes = nullptr;         // Array of indexes
+        void FreeWorkspace(void);
+        bool WriteBufferObject(FILE *pFile, GLenum target, const GLTBUFFERRANGE& range, GLsizeiptr nBytes);
+        void ReportUsage(void);
+
+        GLuint  *pIndexes = nullptr;           // Array of indexes (workspace, shrunk to shorts if they fit)
         M3DVector3f *pVerts = nullptr;         // Array of vertices
         M3DVector3f *pNorms = nullptr;         // Array of normals
         M3DVector2f *pTexCoords = nullptr;     // Array of texture coordinates
@@ -94,10 +146,13 @@ class GLTriangleBatch
         GLuint nMaxIndexes;         // Maximum workspace
         GLuint nNumIndexes;         // Number of indexes currently used
         GLuint nNumVerts;           // Number of vertices actually used
+        GLenum indexType;           // GL_UNSIGNED_SHORT, unless there are more than 64k vertices
         
         bool   bMadeStuff;
-        GLuint bufferObjects[4];
+        GLTBUFFERRANGE bufferRanges[4];     // From the GLBufferPool
         GLuint vertexArrayBufferObject;
+        GLuint instanceBufferObject;
+        GLsizeiptr nInstanceBytes;          // Last size given to CopyInstanceData()
         GLfloat	boundingSphereRadius;
     };
 
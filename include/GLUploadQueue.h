@@ -0,0 +1,147 @@
+/*
+GLUploadQueue.h
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  Loads meshes and textures in the background. Worker threads read and
+ *  decode the files. The GL work is then done one of two ways:
+ *
+ *  - By default, Update() does it on the render thread, once a frame, but only
+ *    up to a budget of bytes, so a big load is spread over several frames.
+ *  - With SetUploadContext(), a thread of its own does it, in a context shared
+ *    with the one that draws. Each upload is fenced, and Update() hands it
+ *    over once the fence has passed, without waiting for it.
+ *
+ *  Either way, a load is only READY after an Update() on the render thread.
+ *  Don't touch a batch while it is loading.
+*/
+
+#ifndef __GLT_UPLOAD_QUEUE__
+#define __GLT_UPLOAD_QUEUE__
+
+#include "GLTools.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// How much Update() uploads per frame, by default, when it does the uploading
+#define GLT_UPLOAD_FRAME_BYTES      (4 * 1024 * 1024)
+
+enum GLT_UPLOAD_STATUS { GLT_UPLOAD_QUEUED = 0, GLT_UPLOAD_DECODED, GLT_UPLOAD_UPLOADED, GLT_UPLOAD_READY, GLT_UPLOAD_FAILED };
+
+#ifdef QT_IS_AVAILABLE
+#include <QOpenGLExtraFunctions>
+class GLUploadQueue : public QOpenGLExtraFunctions
+#else
+class GLUploadQueue
+#endif
+    {
+    public:
+        GLUploadQueue(void);
+        ~GLUploadQueue(void);
+
+        // Optional, before Start(). The upload thread calls pMakeCurrent(pContext)
+        // once, and uses that context from then on. Meshes still get their
+        // buffers from the render context's pool, so releasing the upload
+        // context doesn't take them along.
+        void SetUploadContext(void *pContext, void (*pMakeCurrent)(void *pContext));
+
+        bool Start(GLint nThreads = 2);
+
+        // Waits for the threads. Anything not READY yet is dropped.
+        void Stop(void);
+
+        // Each returns a ticket. The batch must last until the load is done.
+        GLint LoadMesh(GLTriangleBatch *pBatch, const char *szFileName, bool bNormals = true, bool bTexCoords = true);
+        GLint LoadTextureTGA(const char *szFileName, GLenum eMinFilter = GL_LINEAR_MIPMAP_LINEAR,
+                             GLenum eMagFilter = GL_LINEAR, GLenum eWrapMode = GL_CLAMP_TO_EDGE);
+
+        // Once a frame, on the render thread. Returns how many loads finished.
+        GLint Update(GLsizeiptr nMaxBytes = GLT_UPLOAD_FRAME_BYTES);
+
+        GLT_UPLOAD_STATUS GetStatus(GLint iTicket);
+        GLuint GetTexture(GLint iTicket);            // 0 until it's READY
+        inline GLint GetPendingCount(void) { return nPending; }
+
+        // Forget every ticket. Only when nothing is pending.
+        void Clear(void);
+
+    protected:
+        enum { UPLOAD_MESH = 0, UPLOAD_TEXTURE };
+
+        struct UPLOADJOB {
+            GLint               eType;
+            std::string         strFileName;
+            std::atomic<GLint>  status;
+
+            // Meshes
+            GLTriangleBatch     *pBatch;
+            bool                bNormals;
+            bool                bTexCoords;
+
+            // Textures
+            GLbyte              *pBits;             // From gltReadTGABits()
+            GLint               nWidth;
+            GLint               nHeight;
+            GLint               nComponents;
+            GLenum              eFormat;
+            GLenum              eMinFilter;
+            GLenum              eMagFilter;
+            GLenum              eWrapMode;
+            GLuint              uiTexture;
+
+            GLsizeiptr          nBytes;             // What goes to the GPU
+            GLsync              fence;              // Upload context only
+            };
+
+        GLint Queue(UPLOADJOB *pJob);
+        void DecodeThread(void);
+        void UploadThread(void);
+        void Decode(UPLOADJOB *pJob);
+        void Upload(UPLOADJOB *pJob);
+        void Finish(UPLOADJOB *pJob);
+
+        std::vector<UPLOADJOB*>     jobs;           // By ticket. Render thread only.
+        GLint                       nPending;
+
+        // Shared with the threads, under queueMutex
+        std::mutex                  queueMutex;
+        std::condition_variable     queueReady;
+        std::deque<UPLOADJOB*>      decodeQueue;
+        std::deque<UPLOADJOB*>      uploadQueue;    // Decoded, waiting for the GPU
+        std::deque<UPLOADJOB*>      fenceQueue;     // Uploaded, fence not seen yet
+        bool                        bStopping;
+
+        std::vector<std::thread>    threads;
+        void                        *pUploadContext;
+        void                        (*pMakeCurrent)(void *pContext);
+        GLBufferPool                *pBufferPool;   // The render context's, for meshes
+    };
+
+#endif // __GLT_UPLOAD_QUEUE__
@@ -31,12 +31,13 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 
 #include "GLTools.h"
 #include "GLBatch.h"
+#include "target.h"
 
 // Highest 64-bit address. No memory allocation would return this address
 #define NOT_VALID_BUT_USED 0xFFFFFFFFFFFFFFFF
 
 
-GLBatch::GLBatch(void):uiVertexArray(0), uiNormalArray(0), uiColorArray(0), uiTextureCoordArray(0), nVertsBuilding(0),
+GLBatch::GLBatch(void):vertexRange(), normalRange(), colorRange(), texCoordRange(), nVertsBuilding(0),
             nNumVerts(0), bBatchDone(false)
 	{
 #ifdef QT_IS_AVAILABLE
@@ -52,25 +53,26 @@ GLBatch::GLBatch(void):uiVertexArray(0), uiNormalArray(0), uiColorArray(0), uiTe
 
 GLBatch::~GLBatch(void)
 	{
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glDeleteVertexArraysOES(1, &uiVertexArrayObject);
-#else
-    glDeleteVertexArrays(1, &uiVertexArrayObject);
-#endif
+    // Queued, not deleted; this may not be the GL thread, and the GPU may
+    // still be drawing with them
+    GLDeleteQueue *pQueue = GLDeleteQueue::GetDeleteQueue();
+    pQueue->DeleteVertexArrays(1, &uiVertexArrayObject);
 
 
     // This means the buffer is being used
     if(pVerts == (M3DVector3f *)NOT_VALID_BUT_USED)
-		glDeleteBuffers(1, &uiVertexArray);
+		pQueue->FreeBufferRange(vertexRange);
 	
     if(pNormals == (M3DVector3f*)NOT_VALID_BUT_USED)
-		glDeleteBuffers(1, &uiNormalArray);
+		pQueue->FreeBufferRange(normalRange);
 	
     if(pColors == (M3DVector4f*)NOT_VALID_BUT_USED)
-		glDeleteBuffers(1, &uiColorArray);
+		pQueue->FreeBufferRange(colorRange);
 	
     if(pTexCoords == (M3DVector2f*)NOT_VALID_BUT_USED)
-        glDeleteBuffers(1, &uiTextureCoordArray);
+        pQueue->FreeBufferRange(texCoordRange);
+
+    GLMemoryTracker::GetMemoryTracker()->Forget(this);
 
     // In case of error... the pointers might not be null,
     // and not NOT_VALID_BUT_USED. In this case, make sure
@@ -98,30 +100,43 @@ void GLBatch::Begin(GLenum primitive, GLuint nVerts)
     primitiveType = primitive;
     nNumVerts = nVerts;
     nVertsBuilding = 0;
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
-    glGenBuffers(1, &uiVertexArray);
-    glBindBuffer(GL_ARRAY_BUFFER, uiVertexArray);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector3f) * nVerts, NULL, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(GLT_ATTRIBUTE_VERTEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
+
+    // The arrays are pieces of the pool's dynamic blocks. If any can't be
+    // had, the batch stays empty rather than drawing from buffer 0.
+    GLBufferPool *pPool = GLBufferPool::GetBufferPool();
+    if(!pPool->Allocate(GLT_BUFFER_DYNAMIC, sizeof(M3DVector3f) * nVerts, vertexRange) ||
+       !pPool->Allocate(GLT_BUFFER_DYNAMIC, sizeof(M3DVector4f) * nVerts, colorRange) ||
+       !pPool->Allocate(GLT_BUFFER_DYNAMIC, sizeof(M3DVector3f) * nVerts, normalRange) ||
+       !pPool->Allocate(GLT_BUFFER_DYNAMIC, sizeof(M3DVector2f) * nVerts, texCoordRange)) {
+        if(nVerts > 0)
+            LOG_ERROR("GLBatch: Buffers for %u vertices could not be allocated.\n", nVerts);
+
+        GLTBUFFERRANGE *pRanges[4] = { &vertexRange, &colorRange, &normalRange, &texCoordRange };
+        for(int i = 0; i < 4; i++) {
+            GLDeleteQueue::GetDeleteQueue()->FreeBufferRange(*pRanges[i]);
+            *pRanges[i] = GLTBUFFERRANGE();
+            }
+
+        nNumVerts = 0;
+        GLStateCache::GetStateCache()->BindVertexArray(0);
+        return;
+        }
+
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, vertexRange.uiBuffer);
+    glVertexAttribPointer(GLT_ATTRIBUTE_VERTEX, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)vertexRange.nOffset);
     
-    glGenBuffers(1, &uiColorArray);
-    glBindBuffer(GL_ARRAY_BUFFER, uiColorArray);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector4f)* nVerts, NULL, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(GLT_ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, colorRange.uiBuffer);
+    glVertexAttribPointer(GLT_ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)colorRange.nOffset);
     
-    glGenBuffers(1, &uiNormalArray);
-    glBindBuffer(GL_ARRAY_BUFFER, uiNormalArray);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector3f)* nVerts, NULL, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(GLT_ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, normalRange.uiBuffer);
+    glVertexAttribPointer(GLT_ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)normalRange.nOffset);
     
-    glGenBuffers(1, &uiTextureCoordArray);
-    glBindBuffer(GL_ARRAY_BUFFER, uiTextureCoordArray);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector2f) * nVerts, NULL, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(GLT_ATTRIBUTE_TEXTURE0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, texCoordRange.uiBuffer);
+    glVertexAttribPointer(GLT_ATTRIBUTE_TEXTURE0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)texCoordRange.nOffset);
+
+    GLMemoryTracker::GetMemoryTracker()->SetUsage(GLT_MEMORY_VERTEX, this,
+        vertexRange.nSize + colorRange.nSize + normalRange.nSize + texCoordRange.nSize, "GLBatch");
     }
 
 
@@ -136,14 +151,10 @@ void GLBatch::Reset(GLenum primitive)
 // Block Copy in vertex data
 void GLBatch::CopyVertexData3f(M3DVector3f *vVerts) 
 	{
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
 
-    glBindBuffer(GL_ARRAY_BUFFER, uiVertexArray);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(M3DVector3f) * nNumVerts, vVerts);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, vertexRange.uiBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexRange.nOffset, sizeof(M3DVector3f) * nNumVerts, vVerts);
     glEnableVertexAttribArray(GLT_ATTRIBUTE_VERTEX);
 
     nVertsBuilding = nNumVerts; // Make sure this get's drawn
@@ -153,13 +164,9 @@ void GLBatch::CopyVertexData3f(M3DVector3f *vVerts)
 // Block copy in normal data
 void GLBatch::CopyNormalDataf(M3DVector3f *vNorms) 
 	{
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
-    glBindBuffer(GL_ARRAY_BUFFER, uiNormalArray);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(M3DVector3f) * nNumVerts, vNorms);
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, normalRange.uiBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, normalRange.nOffset, sizeof(M3DVector3f) * nNumVerts, vNorms);
     glEnableVertexAttribArray(GLT_ATTRIBUTE_NORMAL);
 
     nVertsBuilding = nNumVerts; // Make sure this get's drawn
@@ -168,13 +175,9 @@ void GLBatch::CopyNormalDataf(M3DVector3f *vNorms)
 
 void GLBatch::CopyColorData4f(M3DVector4f *vColors) 
 	{
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
-    glBindBuffer(GL_ARRAY_BUFFER, uiColorArray);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(M3DVector4f) * nNumVerts, vColors);
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, colorRange.uiBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, colorRange.nOffset, sizeof(M3DVector4f) * nNumVerts, vColors);
     glEnableVertexAttribArray(GLT_ATTRIBUTE_COLOR);
 
     nVertsBuilding = nNumVerts; // Make sure this get's drawn
@@ -183,13 +186,9 @@ void GLBatch::CopyColorData4f(M3DVector4f *vColors)
 
 void GLBatch::CopyTexCoordData2f(M3DVector2f *vTexCoords) 
 	{
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
-    glBindBuffer(GL_ARRAY_BUFFER, uiTextureCoordArray);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(M3DVector2f) * nNumVerts, vTexCoords);
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, texCoordRange.uiBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, texCoordRange.nOffset, sizeof(M3DVector2f) * nNumVerts, vTexCoords);
     glEnableVertexAttribArray(GLT_ATTRIBUTE_TEXTURE0);
 
     nVertsBuilding = nNumVerts; // Make sure this get's drawn
@@ -199,100 +198,132 @@ void GLBatch::CopyTexCoordData2f(M3DVector2f *vTexCoords)
 // Bind everything up in a little package
 void GLBatch::End(void)
 	{
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
     if(nVertsBuilding > 0) {
         // Check to see if items have been added one at a time
         if(pVerts != (M3DVector3f *)NOT_VALID_BUT_USED && pVerts != NULL) {
             glEnableVertexAttribArray(GLT_ATTRIBUTE_VERTEX);
-            glBindBuffer(GL_ARRAY_BUFFER, uiVertexArray);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 3 * nVertsBuilding, pVerts);
+            GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, vertexRange.uiBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, vertexRange.nOffset, sizeof(float) * 3 * nVertsBuilding, pVerts);
             delete [] pVerts; pVerts = (M3DVector3f*)NOT_VALID_BUT_USED;
             }
             
         if(pColors != (M3DVector4f *)NOT_VALID_BUT_USED && pColors != NULL) {
             glEnableVertexAttribArray(GLT_ATTRIBUTE_COLOR);
-            glBindBuffer(GL_ARRAY_BUFFER, uiColorArray);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 4 * nVertsBuilding, pColors);
+            GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, colorRange.uiBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, colorRange.nOffset, sizeof(float) * 4 * nVertsBuilding, pColors);
             delete [] pColors; pColors = (M3DVector4f*)NOT_VALID_BUT_USED;
             }
-        else
-            glDeleteBuffers(1, &uiColorArray);
+        else if(pColors == NULL)
+            GLDeleteQueue::GetDeleteQueue()->FreeBufferRange(colorRange);
             
         if(pNormals != (M3DVector3f *)NOT_VALID_BUT_USED && pNormals != NULL) {
             glEnableVertexAttribArray(GLT_ATTRIBUTE_NORMAL);
-            glBindBuffer(GL_ARRAY_BUFFER, uiNormalArray);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 3 * nVertsBuilding, pNormals);
+            GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, normalRange.uiBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, normalRange.nOffset, sizeof(float) * 3 * nVertsBuilding, pNormals);
             delete [] pNormals; pNormals = (M3DVector3f*)NOT_VALID_BUT_USED;
             }
-        else
-            glDeleteBuffers(1, &uiNormalArray);
+        else if(pNormals == NULL)
+            GLDeleteQueue::GetDeleteQueue()->FreeBufferRange(normalRange);
             
         if(pTexCoords != (M3DVector2f *)NOT_VALID_BUT_USED && pTexCoords != NULL) {
             glEnableVertexAttribArray(GLT_ATTRIBUTE_TEXTURE0);
-            glBindBuffer(GL_ARRAY_BUFFER, uiTextureCoordArray);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 2 * nVertsBuilding, pTexCoords);
+            GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, texCoordRange.uiBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, texCoordRange.nOffset, sizeof(float) * 2 * nVertsBuilding, pTexCoords);
             delete [] pTexCoords; pTexCoords = (M3DVector2f*)NOT_VALID_BUT_USED;
             }
-        else
-            glDeleteBuffers(1, &uiTextureCoordArray);
+        else if(pTexCoords == NULL)
+            GLDeleteQueue::GetDeleteQueue()->FreeBufferRange(texCoordRange);
+
+        // Only the arrays that were filled are still held
+        GLMemoryTracker::GetMemoryTracker()->SetUsage(GLT_MEMORY_VERTEX, this, vertexRange.nSize +
+            (pColors != NULL ? colorRange.nSize : 0) + (pNormals != NULL ? normalRange.nSize : 0) +
+            (pTexCoords != NULL ? texCoordRange.nSize : 0), "GLBatch");
         }
         
 	bBatchDone = true;
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(0);
-#else
-    glBindVertexArray(0);
-#endif
+    GLStateCache::GetStateCache()->BindVertexArray(0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);	// Note: This should NOT be necessary, it should be captured
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, 0);	// Note: This should NOT be necessary, it should be captured
 										// in the vertex array object binding state. I believe this is a
 										// bug in iOS's OpenGL implementation, and at it is simply redudant
 										// in other implementations/platforms
 }
 
 // *******************************************************************************************
+// Mapping a range maps its whole buffer, and waits for every draw made from it.
+// A batch mapped for update moves its arrays into buffers of their own the
+// first time, so it can map each one, and only waits on its own draws.
+void GLBatch::MoveToOwnBuffer(GLTBUFFERRANGE& range, GLuint iAttribute, GLint nComponents)
+    {
+    if(range.uiBuffer == 0 || range.pPool == NULL)
+        return;
+
+    GLStateCache *pCache = GLStateCache::GetStateCache();
+    GLuint uiBuffer;
+    glGenBuffers(1, &uiBuffer);
+    pCache->BindBuffer(GL_COPY_WRITE_BUFFER, uiBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, range.nSize, NULL, GL_DYNAMIC_DRAW);
+    pCache->BindBuffer(GL_COPY_READ_BUFFER, range.uiBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.nOffset, 0, range.nSize);
+
+    GLDeleteQueue::GetDeleteQueue()->FreeBufferRange(range);
+    range.uiBuffer = uiBuffer;
+    range.nOffset = 0;
+    range.pPool = NULL;
+
+    pCache->BindVertexArray(uiVertexArrayObject);
+    pCache->BindBuffer(GL_ARRAY_BUFFER, uiBuffer);
+    glVertexAttribPointer(iAttribute, nComponents, GL_FLOAT, GL_FALSE, 0, 0);
+    pCache->BindVertexArray(0);
+    }
+
 // Make random access to data possible. This maps the buffer object to user accessable memory.
 void GLBatch::MapForUpdate(void)
     {
+    MoveToOwnBuffer(vertexRange, GLT_ATTRIBUTE_VERTEX, 3);
+    if(pColors != nullptr)
+        MoveToOwnBuffer(colorRange, GLT_ATTRIBUTE_COLOR, 4);
+    if(pNormals != nullptr)
+        MoveToOwnBuffer(normalRange, GLT_ATTRIBUTE_NORMAL, 3);
+    if(pTexCoords != nullptr)
+        MoveToOwnBuffer(texCoordRange, GLT_ATTRIBUTE_TEXTURE0, 2);
+
     // Vertexes always exist
-    glBindBuffer(GL_ARRAY_BUFFER, uiVertexArray);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, vertexRange.uiBuffer);
 #ifdef ANDROID_NDK
     pVerts = (M3DVector3f*)glMapBufferOES(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #else
-    pVerts = (M3DVector3f*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(M3DVector3f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
+    pVerts = (M3DVector3f*)glMapBufferRange(GL_ARRAY_BUFFER, vertexRange.nOffset, sizeof(M3DVector3f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 
 #endif
     // If we have no colors, this is nullptr, otherwise look for sential value 0xbadf00d
     if(pColors != nullptr) {
-        glBindBuffer(GL_ARRAY_BUFFER, uiColorArray);
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, colorRange.uiBuffer);
 #ifdef ANDROID_NDK
         pColors = (M3DVector4f*)glMapBufferOES(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #else
-        pColors = (M3DVector4f*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(M3DVector4f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
+        pColors = (M3DVector4f*)glMapBufferRange(GL_ARRAY_BUFFER, colorRange.nOffset, sizeof(M3DVector4f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #endif
         }
 
     // Repeat for normals
     if(pNormals != nullptr) {
-        glBindBuffer(GL_ARRAY_BUFFER, uiNormalArray);
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, normalRange.uiBuffer);
 #ifdef ANDROID_NDK
-        pNormals = (M3DVector3f*)glMapBufferOES ( GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
+        pNormals = (M3DVector3f*)glMapBufferOES(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #else
-        pNormals = (M3DVector3f*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(M3DVector3f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
+        pNormals = (M3DVector3f*)glMapBufferRange(GL_ARRAY_BUFFER, normalRange.nOffset, sizeof(M3DVector3f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #endif
         }
 
     // Repeat for texture coordinates
     if(pTexCoords != nullptr) {
-        glBindBuffer(GL_ARRAY_BUFFER, uiNormalArray);
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, texCoordRange.uiBuffer);
 #ifdef ANDROID_NDK
         pTexCoords = (M3DVector2f*)glMapBufferOES(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #else
-        pTexCoords = (M3DVector2f*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(M3DVector2f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
+        pTexCoords = (M3DVector2f*)glMapBufferRange(GL_ARRAY_BUFFER, texCoordRange.nOffset, sizeof(M3DVector2f) * nVertsBuilding, GL_MAP_WRITE_BIT | GL_MAP_READ_BIT);
 #endif
         }
 
@@ -301,7 +332,7 @@ void GLBatch::MapForUpdate(void)
 
 void GLBatch::UnmapForUpdate(void)
     {
-    glBindBuffer(GL_ARRAY_BUFFER, uiVertexArray);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, vertexRange.uiBuffer);
 
 #ifdef ANDROID_NDK
     glUnmapBufferOES(GL_ARRAY_BUFFER);
@@ -311,7 +342,7 @@ void GLBatch::UnmapForUpdate(void)
     pVerts = (M3DVector3f*)NOT_VALID_BUT_USED;
 
     if(pColors != nullptr) {
-        glBindBuffer(GL_ARRAY_BUFFER, uiColorArray);
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, colorRange.uiBuffer);
 #ifdef ANDROID_NDK
         glUnmapBufferOES(GL_ARRAY_BUFFER);
 #else
@@ -322,7 +353,7 @@ void GLBatch::UnmapForUpdate(void)
 
 
     if(pNormals != nullptr) {
-        glBindBuffer(GL_ARRAY_BUFFER, uiNormalArray);
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, normalRange.uiBuffer);
 #ifdef ANDROID_NDK
         glUnmapBufferOES(GL_ARRAY_BUFFER);
 #else
@@ -332,7 +363,7 @@ void GLBatch::UnmapForUpdate(void)
         }
 
     if(pTexCoords != nullptr) {
-        glBindBuffer(GL_ARRAY_BUFFER, uiTextureCoordArray);
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, texCoordRange.uiBuffer);
 #ifdef ANDROID_NDK
         glUnmapBufferOES(GL_ARRAY_BUFFER);
 #else
@@ -462,14 +493,23 @@ void GLBatch::Draw(void)
 	{
 	if(!bBatchDone)
 		return;
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-    glBindVertexArrayOES(uiVertexArrayObject);
-#else
-    glBindVertexArray(uiVertexArrayObject);
-#endif
+    GLStateCache::GetStateCache()->BindVertexArray(uiVertexArrayObject);
 
     if(nVertsBuilding != 0)
         glDrawArrays(primitiveType, 0, nVertsBuilding);
     }
 
+bool GLBatch::GetDrawItem(GLTDrawItem& item)
+    {
+    if(!bBatchDone || nVertsBuilding == 0)
+        return false;
+
+    item.uiVertexArray = uiVertexArrayObject;
+    item.ePrimitive = primitiveType;
+    item.nCount = nVertsBuilding;
+    item.eIndexType = 0;
+    item.nFirst = 0;
+    return true;
+    }
+
 #endif
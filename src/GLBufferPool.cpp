@@ -0,0 +1,326 @@
+/*
+GLBufferPool.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "GLBufferPool.h"
+#include "GLContext.h"
+#include "target.h"
+#include <string.h>
+#include <assert.h>
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLBufferPool::GLBufferPool(void)
+    {
+    nBlockSize = GLT_BUFFER_POOL_BLOCK;
+    }
+
+// The context must still be current, and nothing may still be using the blocks
+GLBufferPool::~GLBufferPool(void)
+    {
+    for(size_t i = 0; i < blocks.size(); i++) {
+        GLStateCache::GetStateCache()->DeleteBuffers(1, &blocks[i]->uiBuffer);
+        delete blocks[i];
+        }
+    }
+
+GLBufferPool* GLBufferPool::GetBufferPool(void)
+    {
+    GLTCONTEXTDATA *pData = gltGetContextData();
+    GLBufferPool *pPool = pData->pBufferPool.load(std::memory_order_acquire);
+    if(pPool != NULL)
+        return pPool;
+
+    std::lock_guard<std::mutex> lock(pData->createMutex);
+    pPool = pData->pBufferPool.load(std::memory_order_relaxed);
+    if(pPool == NULL) {
+        pPool = new GLBufferPool();
+#ifdef QT_IS_AVAILABLE
+        pPool->initializeOpenGLFunctions();
+#endif
+        pData->pBufferPool.store(pPool, std::memory_order_release);
+        }
+
+    return pPool;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The smallest free range that fits, from any block of the right kind. If
+// none fits, a new block is made.
+bool GLBufferPool::Allocate(GLT_BUFFER_KIND eKind, GLsizeiptr nBytes, GLTBUFFERRANGE& range)
+    {
+    range.uiBuffer = 0;
+    range.nOffset = 0;
+    range.nSize = 0;
+    range.pPool = this;
+    if(nBytes <= 0 || eKind < 0 || eKind >= GLT_BUFFER_KIND_LAST)
+        return false;
+
+    GLsizeiptr nSize = (nBytes + GLT_BUFFER_POOL_ALIGN - 1) & ~(GLsizeiptr)(GLT_BUFFER_POOL_ALIGN - 1);
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    POOLBLOCK *pBlock = NULL;
+    GLintptr nOffset = 0;
+    GLsizeiptr nFree = 0;
+
+    if(nSize > nBlockSize / 2) {
+        pBlock = MakeBlock(eKind, nSize);
+        pBlock->bDedicated = true;
+        nFree = nSize;
+        }
+    else {
+        FREEBYSIZE::iterator it = freeBySize[eKind].lower_bound(nSize);
+        if(it == freeBySize[eKind].end()) {
+            pBlock = MakeBlock(eKind, nBlockSize);
+            nFree = nBlockSize;
+            }
+        else {
+            pBlock = it->second.first;
+            nOffset = it->second.second;
+            nFree = it->first;
+            }
+        }
+
+    if(pBlock == NULL || pBlock->uiBuffer == 0)
+        return false;
+
+    RemoveFree(pBlock, nOffset, nFree);
+    if(nFree > nSize)
+        AddFree(pBlock, nOffset + nSize, nFree - nSize);
+
+    pBlock->nUsed += nSize;
+    pBlock->nAllocations++;
+
+    range.uiBuffer = pBlock->uiBuffer;
+    range.nOffset = nOffset;
+    range.nSize = nSize;
+    return true;
+    }
+
+void GLBufferPool::Free(GLTBUFFERRANGE& range)
+    {
+    if(range.uiBuffer == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::unordered_map<GLuint, POOLBLOCK*>::iterator it = blocksByBuffer.find(range.uiBuffer);
+    if(it == blocksByBuffer.end()) {
+        LOG_ERROR("GLBufferPool: Buffer %u did not come from this pool.\n", range.uiBuffer);
+        return;
+        }
+
+    POOLBLOCK *pBlock = it->second;
+    pBlock->nUsed -= range.nSize;
+    pBlock->nAllocations--;
+
+    if(pBlock->bDedicated)
+        DeleteBlock(pBlock);
+    else {
+        // Merge with the free ranges on either side
+        GLintptr nOffset = range.nOffset;
+        GLsizeiptr nSize = range.nSize;
+        std::map<GLintptr, GLsizeiptr>::iterator next = pBlock->freeRanges.lower_bound(nOffset);
+        if(next != pBlock->freeRanges.end() && next->first == nOffset + nSize) {
+            GLintptr nNextOffset = next->first;
+            GLsizeiptr nNextSize = next->second;
+            RemoveFree(pBlock, nNextOffset, nNextSize);
+            nSize += nNextSize;
+            next = pBlock->freeRanges.lower_bound(nOffset);
+            }
+        if(next != pBlock->freeRanges.begin()) {
+            std::map<GLintptr, GLsizeiptr>::iterator prev = next;
+            prev--;
+            if(prev->first + prev->second == nOffset) {
+                GLintptr nPrevOffset = prev->first;
+                GLsizeiptr nPrevSize = prev->second;
+                RemoveFree(pBlock, nPrevOffset, nPrevSize);
+                nOffset = nPrevOffset;
+                nSize += nPrevSize;
+                }
+            }
+        AddFree(pBlock, nOffset, nSize);
+        }
+
+    range.uiBuffer = 0;
+    range.nOffset = 0;
+    range.nSize = 0;
+    }
+
+void GLBufferPool::Trim(void)
+    {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    for(size_t i = blocks.size(); i > 0; i--)
+        if(blocks[i - 1]->nAllocations == 0)
+            DeleteBlock(blocks[i - 1]);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fill part of a range. Indexes go in through the element array target on
+// WebGL, with no vertex array bound, since that's the only one it allows for
+// them; everything else uses the copy target, which no vertex array remembers.
+void GLBufferPool::Write(const GLTBUFFERRANGE& range, const void *pData, GLsizeiptr nBytes, GLintptr nOffset)
+    {
+    if(range.uiBuffer == 0 || nBytes <= 0)
+        return;
+    assert(nOffset + nBytes <= range.nSize);
+
+    GLint eKind = GLT_BUFFER_VERTEX;
+        {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::unordered_map<GLuint, POOLBLOCK*>::iterator it = blocksByBuffer.find(range.uiBuffer);
+        if(it != blocksByBuffer.end())
+            eKind = it->second->eKind;
+        }
+
+    GLenum eTarget = BindForWrite(eKind, range.uiBuffer);
+    glBufferSubData(eTarget, range.nOffset + nOffset, nBytes, pData);
+    GLStateCache::GetStateCache()->BindBuffer(eTarget, 0);
+    }
+
+GLenum GLBufferPool::BindForWrite(GLint eKind, GLuint uiBuffer)
+    {
+    GLStateCache *pStateCache = GLStateCache::GetStateCache();
+    GLenum eTarget = GL_COPY_WRITE_BUFFER;
+#ifdef __EMSCRIPTEN__
+    if(eKind == GLT_BUFFER_INDEX) {
+        pStateCache->BindVertexArray(0);
+        eTarget = GL_ELEMENT_ARRAY_BUFFER;
+        }
+#else
+    (void)eKind;
+#endif
+    pStateCache->BindBuffer(eTarget, uiBuffer);
+    return eTarget;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// With poolMutex held
+GLBufferPool::POOLBLOCK *GLBufferPool::MakeBlock(GLint eKind, GLsizeiptr nSize)
+    {
+    POOLBLOCK *pBlock = new POOLBLOCK;
+    pBlock->eKind = eKind;
+    pBlock->nSize = nSize;
+    pBlock->nUsed = 0;
+    pBlock->nAllocations = 0;
+    pBlock->bDedicated = false;
+
+    glGenBuffers(1, &pBlock->uiBuffer);
+    GLenum eTarget = BindForWrite(eKind, pBlock->uiBuffer);
+    glBufferData(eTarget, nSize, NULL, (eKind == GLT_BUFFER_DYNAMIC) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+    GLStateCache::GetStateCache()->BindBuffer(eTarget, 0);
+
+    blocks.push_back(pBlock);
+    blocksByBuffer[pBlock->uiBuffer] = pBlock;
+    AddFree(pBlock, 0, nSize);
+    return pBlock;
+    }
+
+void GLBufferPool::DeleteBlock(POOLBLOCK *pBlock)
+    {
+    while(!pBlock->freeRanges.empty())
+        RemoveFree(pBlock, pBlock->freeRanges.begin()->first, pBlock->freeRanges.begin()->second);
+
+    GLStateCache::GetStateCache()->DeleteBuffers(1, &pBlock->uiBuffer);
+    blocksByBuffer.erase(pBlock->uiBuffer);
+    for(size_t i = 0; i < blocks.size(); i++)
+        if(blocks[i] == pBlock) {
+            blocks.erase(blocks.begin() + i);
+            break;
+            }
+
+    delete pBlock;
+    }
+
+void GLBufferPool::AddFree(POOLBLOCK *pBlock, GLintptr nOffset, GLsizeiptr nSize)
+    {
+    pBlock->freeRanges[nOffset] = nSize;
+    freeBySize[pBlock->eKind].insert(FREEBYSIZE::value_type(nSize, std::make_pair(pBlock, nOffset)));
+    }
+
+void GLBufferPool::RemoveFree(POOLBLOCK *pBlock, GLintptr nOffset, GLsizeiptr nSize)
+    {
+    pBlock->freeRanges.erase(nOffset);
+
+    std::pair<FREEBYSIZE::iterator, FREEBYSIZE::iterator> same = freeBySize[pBlock->eKind].equal_range(nSize);
+    for(FREEBYSIZE::iterator it = same.first; it != same.second; it++)
+        if(it->second.first == pBlock && it->second.second == nOffset) {
+            freeBySize[pBlock->eKind].erase(it);
+            return;
+            }
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLBufferPool::GetStats(GLTBUFFERPOOLSTATS& stats)
+    {
+    memset(&stats, 0, sizeof(GLTBUFFERPOOLSTATS));
+    for(GLint k = 0; k < GLT_BUFFER_KIND_LAST; k++)
+        AddStats(k, stats);
+    }
+
+void GLBufferPool::GetStats(GLT_BUFFER_KIND eKind, GLTBUFFERPOOLSTATS& stats)
+    {
+    memset(&stats, 0, sizeof(GLTBUFFERPOOLSTATS));
+    AddStats(eKind, stats);
+    }
+
+// Free space split between blocks isn't fragmentation; it's only counted
+// when a block's own free space is in more than one piece. The running
+// totals are kept in the fragmentation figure between calls.
+void GLBufferPool::AddStats(GLint eKind, GLTBUFFERPOOLSTATS& stats)
+    {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    GLsizeiptr nFree = stats.nBytesReserved - stats.nBytesUsed;
+    GLsizeiptr nUnbroken = (GLsizeiptr)((1.0f - stats.fFragmentation) * (GLfloat)nFree);
+    for(size_t i = 0; i < blocks.size(); i++) {
+        POOLBLOCK *pBlock = blocks[i];
+        if(pBlock->eKind != eKind)
+            continue;
+
+        stats.nBlocks++;
+        stats.nAllocations += pBlock->nAllocations;
+        stats.nFreeRanges += (GLint)pBlock->freeRanges.size();
+        stats.nBytesReserved += pBlock->nSize;
+        stats.nBytesUsed += pBlock->nUsed;
+        nFree += pBlock->nSize - pBlock->nUsed;
+
+        GLsizeiptr nLargest = 0;
+        for(std::map<GLintptr, GLsizeiptr>::iterator it = pBlock->freeRanges.begin(); it != pBlock->freeRanges.end(); it++)
+            if(it->second > nLargest)
+                nLargest = it->second;
+        nUnbroken += nLargest;
+        if(nLargest > stats.nLargestFree)
+            stats.nLargestFree = nLargest;
+        }
+
+    stats.fUtilization = (stats.nBytesReserved > 0) ? (GLfloat)stats.nBytesUsed / (GLfloat)stats.nBytesReserved : 0.0f;
+    stats.fFragmentation = (nFree > 0) ? 1.0f - (GLfloat)nUnbroken / (GLfloat)nFree : 0.0f;
+    }
@@ -0,0 +1,273 @@
+/*
+GLCommandBuffer.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLCommandBuffer.h"
+
+// The arguments of each command, as they are laid out after it
+struct GLT_CMD_PROGRAM          { GLuint uiProgram; };
+struct GLT_CMD_UNIFORM_MATRIX4  { GLint iLocation; GLfloat mMatrix[16]; };
+struct GLT_CMD_UNIFORM_MATRIX3  { GLint iLocation; GLfloat mMatrix[9]; };
+struct GLT_CMD_UNIFORM4         { GLint iLocation; GLfloat vValue[4]; };
+struct GLT_CMD_UNIFORM1I        { GLint iLocation; GLint iValue; };
+struct GLT_CMD_TEXTURE          { GLenum eUnit; GLenum eTarget; GLuint uiTexture; };
+struct GLT_CMD_DRAW             { GLBatchBase *pBatch; };
+struct GLT_CMD_DRAW_INSTANCED   { GLTriangleBatch *pBatch; GLsizei nInstances; };
+struct GLT_CMD_DRAW_OBJECT      { GLBatchBase *pBatch; GLint nShaderID; GLint iObject; GLint iTextureUnit; };
+
+// Words a command and its arguments take up
+#define GLT_CMD_WORDS(args)     (1 + (sizeof(args) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLCommandBuffer::GLCommandBuffer(void)
+    {
+    nCommands = 0;
+#ifdef QT_IS_AVAILABLE
+    bFunctionsReady = false;
+#endif
+    }
+
+void GLCommandBuffer::Reset(void)
+    {
+    commands.clear();
+    objects.clear();
+    nCommands = 0;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Room for one more command. The pointer is good until the next one.
+void *GLCommandBuffer::Record(GLuint eCommand, size_t nBytes)
+    {
+    size_t iRecord = commands.size();
+    commands.resize(iRecord + 1 + (nBytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    commands[iRecord] = eCommand;
+    nCommands++;
+    return &commands[iRecord + 1];
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLCommandBuffer::UseProgram(GLuint uiProgram)
+    {
+    GLT_CMD_PROGRAM *pArgs = (GLT_CMD_PROGRAM *)Record(CMD_USE_PROGRAM, sizeof(GLT_CMD_PROGRAM));
+    pArgs->uiProgram = uiProgram;
+    }
+
+void GLCommandBuffer::UniformMatrix4(GLint iLocation, const M3DMatrix44f mMatrix)
+    {
+    GLT_CMD_UNIFORM_MATRIX4 *pArgs = (GLT_CMD_UNIFORM_MATRIX4 *)Record(CMD_UNIFORM_MATRIX4, sizeof(GLT_CMD_UNIFORM_MATRIX4));
+    pArgs->iLocation = iLocation;
+    memcpy(pArgs->mMatrix, mMatrix, sizeof(M3DMatrix44f));
+    }
+
+void GLCommandBuffer::UniformMatrix3(GLint iLocation, const M3DMatrix33f mMatrix)
+    {
+    GLT_CMD_UNIFORM_MATRIX3 *pArgs = (GLT_CMD_UNIFORM_MATRIX3 *)Record(CMD_UNIFORM_MATRIX3, sizeof(GLT_CMD_UNIFORM_MATRIX3));
+    pArgs->iLocation = iLocation;
+    memcpy(pArgs->mMatrix, mMatrix, sizeof(M3DMatrix33f));
+    }
+
+void GLCommandBuffer::Uniform4(GLint iLocation, const M3DVector4f vValue)
+    {
+    GLT_CMD_UNIFORM4 *pArgs = (GLT_CMD_UNIFORM4 *)Record(CMD_UNIFORM4, sizeof(GLT_CMD_UNIFORM4));
+    pArgs->iLocation = iLocation;
+    memcpy(pArgs->vValue, vValue, sizeof(M3DVector4f));
+    }
+
+void GLCommandBuffer::Uniform1i(GLint iLocation, GLint iValue)
+    {
+    GLT_CMD_UNIFORM1I *pArgs = (GLT_CMD_UNIFORM1I *)Record(CMD_UNIFORM1I, sizeof(GLT_CMD_UNIFORM1I));
+    pArgs->iLocation = iLocation;
+    pArgs->iValue = iValue;
+    }
+
+void GLCommandBuffer::BindTexture(GLenum eUnit, GLenum eTarget, GLuint uiTexture)
+    {
+    GLT_CMD_TEXTURE *pArgs = (GLT_CMD_TEXTURE *)Record(CMD_BIND_TEXTURE, sizeof(GLT_CMD_TEXTURE));
+    pArgs->eUnit = eUnit;
+    pArgs->eTarget = eTarget;
+    pArgs->uiTexture = uiTexture;
+    }
+
+void GLCommandBuffer::Draw(GLBatchBase *pBatch)
+    {
+    GLT_CMD_DRAW *pArgs = (GLT_CMD_DRAW *)Record(CMD_DRAW, sizeof(GLT_CMD_DRAW));
+    pArgs->pBatch = pBatch;
+    }
+
+void GLCommandBuffer::DrawInstanced(GLTriangleBatch *pBatch, GLsizei nInstances)
+    {
+    GLT_CMD_DRAW_INSTANCED *pArgs = (GLT_CMD_DRAW_INSTANCED *)Record(CMD_DRAW_INSTANCED, sizeof(GLT_CMD_DRAW_INSTANCED));
+    pArgs->pBatch = pBatch;
+    pArgs->nInstances = nInstances;
+    }
+
+// The object index is local to this buffer until it's replayed
+void GLCommandBuffer::DrawObject(GLBatchBase *pBatch, GLT_STOCK_SHADER nShaderID, const GLTObjectData& object,
+                                 GLint iTextureUnit)
+    {
+    GLT_CMD_DRAW_OBJECT *pArgs = (GLT_CMD_DRAW_OBJECT *)Record(CMD_DRAW_OBJECT, sizeof(GLT_CMD_DRAW_OBJECT));
+    pArgs->pBatch = pBatch;
+    pArgs->nShaderID = nShaderID;
+    pArgs->iObject = (GLint)objects.size();
+    pArgs->iTextureUnit = iTextureUnit;
+    objects.push_back(object);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Replay a set of buffers, in order. All their objects go up together.
+void GLCommandBuffer::Replay(GLShaderManager& shaderManager, GLCommandBuffer *pBuffers, GLint nBuffers)
+    {
+    size_t nObjects = 0;
+    for(GLint i = 0; i < nBuffers; i++)
+        nObjects += pBuffers[i].objects.size();
+
+    if(nObjects > 0) {
+        std::vector<GLTObjectData> allObjects;
+        allObjects.reserve(nObjects);
+        for(GLint i = 0; i < nBuffers; i++)
+            allObjects.insert(allObjects.end(), pBuffers[i].objects.begin(), pBuffers[i].objects.end());
+        shaderManager.SetObjects(allObjects.data(), (GLsizei)nObjects);
+        }
+
+    GLint iFirstObject = 0;
+    for(GLint i = 0; i < nBuffers; i++) {
+        pBuffers[i].Execute(shaderManager, iFirstObject);
+        iFirstObject += (GLint)pBuffers[i].objects.size();
+        }
+    }
+
+void GLCommandBuffer::Replay(GLShaderManager& shaderManager)
+    {
+    Replay(shaderManager, this, 1);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The GL thread's tight loop
+void GLCommandBuffer::Execute(GLShaderManager& shaderManager, GLint iFirstObject)
+    {
+#ifdef QT_IS_AVAILABLE
+    // Recording can start before there's a context, so this waits for the first replay
+    if(!bFunctionsReady) {
+        initializeOpenGLFunctions();
+        bFunctionsReady = true;
+        }
+#endif
+    GLStateCache *pState = GLStateCache::GetStateCache();
+    const uint64_t *pRecord = commands.data();
+    const uint64_t *pEnd = pRecord + commands.size();
+
+    // Uniforms set here may belong to a stock shader, so the shader manager's
+    // idea of what they hold is out of date until it's told otherwise
+    bool bUniformsChanged = false;
+
+    while(pRecord < pEnd) {
+        const void *pArgs = pRecord + 1;
+        switch(*pRecord)
+            {
+            case CMD_USE_PROGRAM:
+                pState->UseProgram(((const GLT_CMD_PROGRAM *)pArgs)->uiProgram);
+                pRecord += GLT_CMD_WORDS(GLT_CMD_PROGRAM);
+                break;
+
+            case CMD_UNIFORM_MATRIX4: {
+                const GLT_CMD_UNIFORM_MATRIX4 *pUniform = (const GLT_CMD_UNIFORM_MATRIX4 *)pArgs;
+                glUniformMatrix4fv(pUniform->iLocation, 1, GL_FALSE, pUniform->mMatrix);
+                bUniformsChanged = true;
+                pRecord += GLT_CMD_WORDS(GLT_CMD_UNIFORM_MATRIX4);
+                break;
+                }
+
+            case CMD_UNIFORM_MATRIX3: {
+                const GLT_CMD_UNIFORM_MATRIX3 *pUniform = (const GLT_CMD_UNIFORM_MATRIX3 *)pArgs;
+                glUniformMatrix3fv(pUniform->iLocation, 1, GL_FALSE, pUniform->mMatrix);
+                bUniformsChanged = true;
+                pRecord += GLT_CMD_WORDS(GLT_CMD_UNIFORM_MATRIX3);
+                break;
+                }
+
+            case CMD_UNIFORM4: {
+                const GLT_CMD_UNIFORM4 *pUniform = (const GLT_CMD_UNIFORM4 *)pArgs;
+                glUniform4fv(pUniform->iLocation, 1, pUniform->vValue);
+                bUniformsChanged = true;
+                pRecord += GLT_CMD_WORDS(GLT_CMD_UNIFORM4);
+                break;
+                }
+
+            case CMD_UNIFORM1I: {
+                const GLT_CMD_UNIFORM1I *pUniform = (const GLT_CMD_UNIFORM1I *)pArgs;
+                glUniform1i(pUniform->iLocation, pUniform->iValue);
+                bUniformsChanged = true;
+                pRecord += GLT_CMD_WORDS(GLT_CMD_UNIFORM1I);
+                break;
+                }
+
+            case CMD_BIND_TEXTURE: {
+                const GLT_CMD_TEXTURE *pTexture = (const GLT_CMD_TEXTURE *)pArgs;
+                pState->ActiveTexture(pTexture->eUnit);
+                pState->BindTexture(pTexture->eTarget, pTexture->uiTexture);
+                pRecord += GLT_CMD_WORDS(GLT_CMD_TEXTURE);
+                break;
+                }
+
+            case CMD_DRAW:
+                ((const GLT_CMD_DRAW *)pArgs)->pBatch->Draw();
+                pRecord += GLT_CMD_WORDS(GLT_CMD_DRAW);
+                break;
+
+            case CMD_DRAW_INSTANCED: {
+                const GLT_CMD_DRAW_INSTANCED *pDraw = (const GLT_CMD_DRAW_INSTANCED *)pArgs;
+                pDraw->pBatch->DrawInstanced(pDraw->nInstances);
+                pRecord += GLT_CMD_WORDS(GLT_CMD_DRAW_INSTANCED);
+                break;
+                }
+
+            case CMD_DRAW_OBJECT: {
+                const GLT_CMD_DRAW_OBJECT *pDraw = (const GLT_CMD_DRAW_OBJECT *)pArgs;
+                if(bUniformsChanged) {
+                    shaderManager.InvalidateUniformCache();
+                    bUniformsChanged = false;
+                    }
+                shaderManager.UseObject(pDraw->nShaderID, iFirstObject + pDraw->iObject, pDraw->iTextureUnit);
+                pDraw->pBatch->Draw();
+                pRecord += GLT_CMD_WORDS(GLT_CMD_DRAW_OBJECT);
+                break;
+                }
+
+            default:        // Can't happen, but don't spin forever if it does
+                pRecord = pEnd;
+                break;
+            }
+        }
+
+    if(bUniformsChanged)
+        shaderManager.InvalidateUniformCache();
+    }
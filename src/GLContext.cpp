@@ -0,0 +1,108 @@
+/*
+GLContext.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLTools.h"
+#include "GLContext.h"
+#include "GLFrameSync.h"
+#include "GLDeleteQueue.h"
+#include "GLBufferPool.h"
+#include <unordered_map>
+
+// Every context anyone has used, guarded by contextMutex
+static std::mutex                                   contextMutex;
+static std::unordered_map<void*, GLTCONTEXTDATA*>   contexts;
+
+// What this thread is using. pCurrentData is looked up on first use.
+static thread_local void            *pCurrentContext = NULL;
+static thread_local GLTCONTEXTDATA  *pCurrentData = NULL;
+
+
+///////////////////////////////////////////////////////////////////////////////
+void gltMakeContextCurrent(void *pContext)
+    {
+    if(pContext != pCurrentContext) {
+        pCurrentContext = pContext;
+        pCurrentData = NULL;
+        }
+    }
+
+void *gltGetCurrentContext(void)
+    {
+    return pCurrentContext;
+    }
+
+GLTCONTEXTDATA *gltGetContextData(void)
+    {
+    if(pCurrentData != NULL)
+        return pCurrentData;
+
+    std::lock_guard<std::mutex> lock(contextMutex);
+    GLTCONTEXTDATA *&pData = contexts[pCurrentContext];
+    if(pData == NULL) {
+        pData = new GLTCONTEXTDATA;
+        pData->pTools = NULL;
+        pData->pStateCache = NULL;
+        pData->pFrameSync = NULL;
+        pData->pDeleteQueue = NULL;
+        pData->pBufferPool = NULL;
+        }
+
+    pCurrentData = pData;
+    return pData;
+    }
+
+void gltReleaseContext(void *pContext)
+    {
+    GLTCONTEXTDATA *pData = NULL;
+        {
+        std::lock_guard<std::mutex> lock(contextMutex);
+        std::unordered_map<void*, GLTCONTEXTDATA*>::iterator it = contexts.find(pContext);
+        if(it == contexts.end())
+            return;
+        pData = it->second;
+        }
+
+    // These still delete through the state cache, so they go while it can
+    // be found. The frame callbacks may queue deletes of their own, and the
+    // queue may hand ranges back to the pool.
+    delete pData->pFrameSync.load();
+    delete pData->pDeleteQueue.load();
+    delete pData->pBufferPool.load();
+
+        {
+        std::lock_guard<std::mutex> lock(contextMutex);
+        contexts.erase(pContext);
+        }
+
+    if(pCurrentData == pData)
+        pCurrentData = NULL;
+
+    delete pData->pTools.load();
+    delete pData->pStateCache.load();
+    delete pData;
+    }
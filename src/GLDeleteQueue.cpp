@@ -0,0 +1,236 @@
+/*
+GLDeleteQueue.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "GLDeleteQueue.h"
+#include "GLFrameSync.h"
+#include "GLContext.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLDeleteQueue::GLDeleteQueue(void)
+    {
+    incoming.nFrame = 0;
+    nPending = 0;
+    }
+
+// The context must still be current
+GLDeleteQueue::~GLDeleteQueue(void)
+    {
+    Flush();
+    }
+
+GLDeleteQueue* GLDeleteQueue::GetDeleteQueue(void)
+    {
+    GLTCONTEXTDATA *pData = gltGetContextData();
+    GLDeleteQueue *pQueue = pData->pDeleteQueue.load(std::memory_order_acquire);
+    if(pQueue != NULL)
+        return pQueue;
+
+    std::lock_guard<std::mutex> lock(pData->createMutex);
+    pQueue = pData->pDeleteQueue.load(std::memory_order_relaxed);
+    if(pQueue == NULL) {
+        pQueue = new GLDeleteQueue();
+        pData->pDeleteQueue.store(pQueue, std::memory_order_release);
+        }
+
+    return pQueue;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLDeleteQueue::DeleteBuffers(GLsizei n, const GLuint *pBuffers)
+    {
+    Queue(DELETE_BUFFER, n, pBuffers);
+    }
+
+void GLDeleteQueue::DeleteVertexArrays(GLsizei n, const GLuint *pVertexArrays)
+    {
+    Queue(DELETE_VERTEX_ARRAY, n, pVertexArrays);
+    }
+
+void GLDeleteQueue::DeleteTextures(GLsizei n, const GLuint *pTextures)
+    {
+    Queue(DELETE_TEXTURE, n, pTextures);
+    }
+
+void GLDeleteQueue::DeleteFramebuffers(GLsizei n, const GLuint *pFramebuffers)
+    {
+    Queue(DELETE_FRAMEBUFFER, n, pFramebuffers);
+    }
+
+void GLDeleteQueue::DeleteRenderbuffers(GLsizei n, const GLuint *pRenderbuffers)
+    {
+    Queue(DELETE_RENDERBUFFER, n, pRenderbuffers);
+    }
+
+void GLDeleteQueue::DeleteProgram(GLuint uiProgram)
+    {
+    Queue(DELETE_PROGRAM, 1, &uiProgram);
+    }
+
+void GLDeleteQueue::FreeBufferRange(const GLTBUFFERRANGE& range)
+    {
+    if(range.uiBuffer == 0)
+        return;
+
+    if(range.pPool == NULL) {
+        DeleteBuffers(1, &range.uiBuffer);
+        return;
+        }
+
+    std::unique_lock<std::mutex> lock(incomingMutex);
+    incoming.ranges.push_back(range);
+    nPending++;
+    lock.unlock();
+
+    if(CanDeleteNow())
+        Flush();
+    }
+
+void GLDeleteQueue::Queue(GLint eType, GLsizei n, const GLuint *pNames)
+    {
+    std::unique_lock<std::mutex> lock(incomingMutex);
+    for(GLsizei i = 0; i < n; i++)
+        if(pNames[i] != 0) {
+            incoming.names[eType].push_back(pNames[i]);
+            nPending++;
+            }
+    lock.unlock();
+
+    if(CanDeleteNow())
+        Flush();
+    }
+
+// Without a GLFrameSync nobody counts frames, and may never call Update().
+// The context's own thread then deletes right away, as GL did before there
+// was a queue, and takes whatever other threads left with it.
+bool GLDeleteQueue::CanDeleteNow(void)
+    {
+    GLTCONTEXTDATA *pData = gltGetContextData();
+    if(pData->pFrameSync.load(std::memory_order_acquire) != NULL)
+        return false;
+
+    GLStateCache *pCache = pData->pStateCache.load(std::memory_order_acquire);
+    return (pCache != NULL && pCache->IsContextThread());
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Whatever was queued so far can't be used after the frame under way now, so
+// it's tagged with that one. It may have stopped a frame earlier; waiting the
+// extra frame costs nothing but a little memory.
+GLint GLDeleteQueue::Update(void)
+    {
+    GLFrameSync *pSync = gltGetContextData()->pFrameSync.load(std::memory_order_acquire);
+    if(pSync == NULL)
+        return Flush();
+
+    Collect(pSync->GetFrameNumber());
+
+    GLint nDeleted = 0;
+    while(!pending.empty() && pSync->IsFrameComplete(pending.front().nFrame)) {
+        nDeleted += Free(pending.front());
+        pending.pop_front();
+        }
+
+    return nDeleted;
+    }
+
+GLint GLDeleteQueue::Flush(void)
+    {
+    Collect(0);
+
+    GLint nDeleted = 0;
+    while(!pending.empty()) {
+        nDeleted += Free(pending.front());
+        pending.pop_front();
+        }
+
+    return nDeleted;
+    }
+
+void GLDeleteQueue::Collect(GLuint64 nFrame)
+    {
+    std::lock_guard<std::mutex> lock(incomingMutex);
+    bool bEmpty = incoming.ranges.empty();
+    for(GLint t = 0; t < DELETE_LAST; t++)
+        if(!incoming.names[t].empty())
+            bEmpty = false;
+
+    if(!bEmpty) {
+        incoming.nFrame = nFrame;
+        pending.push_back(DELETEBATCH());
+        std::swap(pending.back(), incoming);
+        }
+    }
+
+// One call per type, through the state cache so it forgets the bindings
+GLint GLDeleteQueue::Free(DELETEBATCH& batch)
+    {
+    GLStateCache *pCache = GLStateCache::GetStateCache();
+    GLint nDeleted = 0;
+
+    for(GLint t = 0; t < DELETE_LAST; t++) {
+        std::vector<GLuint>& names = batch.names[t];
+        if(names.empty())
+            continue;
+
+        GLsizei n = (GLsizei)names.size();
+        switch(t) {
+            case DELETE_BUFFER:
+                pCache->DeleteBuffers(n, &names[0]);
+                break;
+            case DELETE_VERTEX_ARRAY:
+                pCache->DeleteVertexArrays(n, &names[0]);
+                break;
+            case DELETE_TEXTURE:
+                pCache->DeleteTextures(n, &names[0]);
+                break;
+            case DELETE_FRAMEBUFFER:
+                pCache->DeleteFramebuffers(n, &names[0]);
+                break;
+            case DELETE_RENDERBUFFER:
+                pCache->DeleteRenderbuffers(n, &names[0]);
+                break;
+            case DELETE_PROGRAM:
+                for(GLsizei i = 0; i < n; i++)
+                    pCache->DeleteProgram(names[i]);
+                break;
+            }
+
+        nDeleted += n;
+        }
+
+    for(size_t r = 0; r < batch.ranges.size(); r++)
+        batch.ranges[r].pPool->Free(batch.ranges[r]);
+    nDeleted += (GLint)batch.ranges.size();
+
+    nPending -= nDeleted;
+    return nDeleted;
+    }
@@ -0,0 +1,86 @@
+/*
+GLDrawList.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLDrawList.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLDrawList::GLDrawList(void)
+    {
+    }
+
+GLint GLDrawList::Add(GLBatchBase& batch)
+    {
+    GLTDrawItem item;
+    if(!batch.GetDrawItem(item))
+        return -1;
+    return Add(item);
+    }
+
+GLint GLDrawList::Add(const GLTDrawItem& item)
+    {
+    items.push_back(item);
+    return (GLint)items.size() - 1;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLDrawList::Draw(void)
+    {
+    Draw(0, (GLsizei)items.size());
+    }
+
+// Consecutive entries on the same vertex array only bind it once
+void GLDrawList::Draw(GLsizei iFirst, GLsizei nItems)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    if(iFirst < 0 || nItems <= 0 || iFirst >= (GLsizei)items.size())
+        return;
+    if(nItems > (GLsizei)items.size() - iFirst)
+        nItems = (GLsizei)items.size() - iFirst;
+
+    GLStateCache *pState = GLStateCache::GetStateCache();
+    const GLTDrawItem *pItem = items.data() + iFirst;
+    const GLTDrawItem *pEnd = pItem + nItems;
+    GLuint uiVertexArray = pItem->uiVertexArray;
+    pState->BindVertexArray(uiVertexArray);
+
+    for(; pItem < pEnd; pItem++) {
+        if(pItem->uiVertexArray != uiVertexArray) {
+            uiVertexArray = pItem->uiVertexArray;
+            pState->BindVertexArray(uiVertexArray);
+            }
+
+        if(pItem->eIndexType == 0)
+            glDrawArrays(pItem->ePrimitive, (GLint)pItem->nFirst, pItem->nCount);
+        else
+            glDrawElements(pItem->ePrimitive, pItem->nCount, pItem->eIndexType, (const GLvoid *)pItem->nFirst);
+        }
+    }
@@ -0,0 +1,207 @@
+/*
+GLFrameSync.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "GLFrameSync.h"
+#include "GLDeleteQueue.h"
+#include "GLContext.h"
+#include "target.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLFrameSync::GLFrameSync(void)
+    {
+    nFramesInFlight = GLT_FRAMES_IN_FLIGHT;
+    nNextFramesInFlight = GLT_FRAMES_IN_FLIGHT;
+    iFrameIndex = 0;
+    nFrameNumber = 0;
+    nCompletedFrame = 0;
+    nStalls = 0;
+    }
+
+// The context must still be current. Anything still waiting on the GPU is
+// called back now; GL holds on to objects deleted while they're in use.
+GLFrameSync::~GLFrameSync(void)
+    {
+    for(size_t i = 0; i < inFlight.size(); i++) {
+        glDeleteSync(inFlight[i].fence);
+        for(size_t c = 0; c < inFlight[i].callbacks.size(); c++)
+            inFlight[i].callbacks[c].pCallback(inFlight[i].callbacks[c].pUserData);
+        }
+
+    for(size_t c = 0; c < callbacks.size(); c++)
+        callbacks[c].pCallback(callbacks[c].pUserData);
+    }
+
+GLFrameSync* GLFrameSync::GetFrameSync(void)
+    {
+    GLTCONTEXTDATA *pData = gltGetContextData();
+    GLFrameSync *pSync = pData->pFrameSync.load(std::memory_order_acquire);
+    if(pSync != NULL)
+        return pSync;
+
+    std::lock_guard<std::mutex> lock(pData->createMutex);
+    pSync = pData->pFrameSync.load(std::memory_order_relaxed);
+    if(pSync == NULL) {
+        pSync = new GLFrameSync();
+#ifdef QT_IS_AVAILABLE
+        pSync->initializeOpenGLFunctions();
+#endif
+        pData->pFrameSync.store(pSync, std::memory_order_release);
+        }
+
+    return pSync;
+    }
+
+void GLFrameSync::SetFramesInFlight(GLint nFrames)
+    {
+    if(nFrames < 1)
+        nFrames = 1;
+    if(nFrames > GLT_MAX_FRAMES_IN_FLIGHT)
+        nFrames = GLT_MAX_FRAMES_IN_FLIGHT;
+
+    nNextFramesInFlight = nFrames;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The frame this one's index last belonged to was nFramesInFlight ago. Once
+// that is done, so is every copy this frame might touch. Whatever the delete
+// queue holds from finished frames goes now too.
+void GLFrameSync::BeginFrame(void)
+    {
+    if(nNextFramesInFlight != nFramesInFlight) {
+        WaitIdle();
+        nFramesInFlight = nNextFramesInFlight;
+        }
+
+    nFrameNumber++;
+    iFrameIndex = (GLint)(nFrameNumber % (GLuint64)nFramesInFlight);
+
+    if(nFrameNumber > (GLuint64)nFramesInFlight)
+        Retire(nFrameNumber - nFramesInFlight);
+    else
+        Retire(0);
+
+    GLDeleteQueue::GetDeleteQueue()->Update();
+    }
+
+void GLFrameSync::EndFrame(void)
+    {
+    FRAMERECORD record;
+    record.nFrame = nFrameNumber;
+    record.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    record.callbacks.swap(callbacks);
+    inFlight.push_back(record);
+    }
+
+void GLFrameSync::OnFrameComplete(GLT_FRAME_CALLBACK pCallback, void *pUserData)
+    {
+    FRAMECALLBACK callback = { pCallback, pUserData };
+    callbacks.push_back(callback);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLuint64 GLFrameSync::GetCompletedFrame(void)
+    {
+    Retire(0);
+    return nCompletedFrame;
+    }
+
+bool GLFrameSync::IsFrameComplete(GLuint64 nFrame)
+    {
+    if(nFrame <= nCompletedFrame)
+        return true;
+
+    Retire(0);
+    return (nFrame <= nCompletedFrame);
+    }
+
+void GLFrameSync::WaitForFrame(GLuint64 nFrame)
+    {
+    Retire(nFrame);
+    }
+
+// Fences anything sent since the last EndFrame(), so its callbacks run too
+void GLFrameSync::WaitIdle(void)
+    {
+    if(!callbacks.empty())
+        EndFrame();
+
+    if(!inFlight.empty())
+        Retire(inFlight.back().nFrame);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fences pass in the order they were made, so we stop at the first one that
+// hasn't. Frames up to nWaitFor are waited for; later ones are only checked.
+void GLFrameSync::Retire(GLuint64 nWaitFor)
+    {
+    while(!inFlight.empty()) {
+        FRAMERECORD& record = inFlight.front();
+        if(!WaitFence(record.fence, record.nFrame <= nWaitFor))
+            break;
+
+        glDeleteSync(record.fence);
+        nCompletedFrame = record.nFrame;
+
+        // A callback may add more callbacks, which go with the next frame
+        std::vector<FRAMECALLBACK> done;
+        done.swap(record.callbacks);
+        inFlight.pop_front();
+        for(size_t c = 0; c < done.size(); c++)
+            done[c].pCallback(done[c].pUserData);
+        }
+    }
+
+bool GLFrameSync::WaitFence(GLsync fence, bool bBlock)
+    {
+    GLenum eResult = glClientWaitSync(fence, 0, 0);
+    if(eResult == GL_TIMEOUT_EXPIRED && bBlock) {
+        nStalls++;
+#ifdef __EMSCRIPTEN__
+        // WebGL can't block on a fence. Its buffer updates are copied when
+        // they're made, and deletes wait for the GPU anyway, so go ahead.
+        return true;
+#else
+        do {
+            eResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLT_FRAME_WAIT_TIMEOUT);
+            } while(eResult == GL_TIMEOUT_EXPIRED);
+#endif
+        }
+
+    // Most likely the context is gone. Don't hang on it.
+    if(eResult == GL_WAIT_FAILED) {
+        LOG_ERROR("GLFrameSync: glClientWaitSync failed.\n");
+        return true;
+        }
+
+    return (eResult != GL_TIMEOUT_EXPIRED);
+    }
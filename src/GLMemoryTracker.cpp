@@ -0,0 +1,261 @@
+/*
+GLMemoryTracker.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "GLMemoryTracker.h"
+#include "GLContext.h"
+#include <algorithm>
+
+static const char *szCategoryNames[GLT_MEMORY_ALL + 1] = { "Vertex", "Index", "Texture", "Framebuffer", "All" };
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLMemoryTracker::GLMemoryTracker(void)
+    {
+    for(GLint c = 0; c <= GLT_MEMORY_ALL; c++) {
+        totals[c] = 0;
+        highWater[c] = 0;
+        budgets[c].nBytes = 0;
+        budgets[c].pCallback = NULL;
+        budgets[c].pUserData = NULL;
+        budgets[c].bOver = false;
+        }
+    }
+
+GLMemoryTracker* GLMemoryTracker::GetMemoryTracker(void)
+    {
+    static GLMemoryTracker tracker;
+    return &tracker;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLMemoryTracker::SetUsage(GLT_MEMORY_CATEGORY eCategory, const void *pOwner, GLsizeiptr nBytes, const char *szTag)
+    {
+    if(eCategory < 0 || eCategory >= GLT_MEMORY_ALL || pOwner == NULL)
+        return;
+
+    Change(eCategory, MEMORYKEY(pOwner, 0), nBytes, szTag);
+    }
+
+void GLMemoryTracker::SetTextureUsage(GLuint uiTexture, GLsizeiptr nBytes, const char *szTag)
+    {
+    if(uiTexture == 0)
+        return;
+
+    // Names are only unique within a context
+    Change(GLT_MEMORY_TEXTURE, MEMORYKEY(gltGetCurrentContext(), uiTexture), nBytes, szTag);
+    }
+
+void GLMemoryTracker::ForgetTexture(GLuint uiTexture)
+    {
+    SetTextureUsage(uiTexture, 0);
+    }
+
+void GLMemoryTracker::Forget(const void *pOwner)
+    {
+    for(GLint c = 0; c < GLT_MEMORY_ALL; c++)
+        Change(c, MEMORYKEY(pOwner, 0), 0, NULL);
+
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    tags.erase(pOwner);
+    }
+
+void GLMemoryTracker::SetTag(const void *pOwner, const char *szTag)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    if(szTag != NULL)
+        tags[pOwner] = szTag;
+    else
+        tags.erase(pOwner);
+    }
+
+// Budget callbacks may call back in here, so they're made without the lock
+void GLMemoryTracker::Change(GLint eCategory, const MEMORYKEY& key, GLsizeiptr nBytes, const char *szTag)
+    {
+    std::vector<GLint> over;
+        {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        GLsizeiptr nOld = 0;
+        std::map<MEMORYKEY, MEMORYENTRY>::iterator it = entries[eCategory].find(key);
+        if(it != entries[eCategory].end())
+            nOld = it->second.nBytes;
+
+        if(nBytes <= 0) {
+            if(it == entries[eCategory].end())
+                return;
+            entries[eCategory].erase(it);
+            nBytes = 0;
+            }
+        else {
+            MEMORYENTRY& entry = entries[eCategory][key];
+            entry.nBytes = nBytes;
+            if(szTag != NULL)
+                entry.strTag = szTag;
+            }
+
+        totals[eCategory] += nBytes - nOld;
+        totals[GLT_MEMORY_ALL] += nBytes - nOld;
+        highWater[eCategory] = std::max(highWater[eCategory], totals[eCategory]);
+        highWater[GLT_MEMORY_ALL] = std::max(highWater[GLT_MEMORY_ALL], totals[GLT_MEMORY_ALL]);
+
+        CheckBudgets(eCategory);
+        CheckBudgets(GLT_MEMORY_ALL);
+        over.swap(crossed);
+        }
+
+    for(size_t i = 0; i < over.size(); i++) {
+        MEMORYBUDGET budget = budgets[over[i]];
+        if(budget.pCallback != NULL)
+            budget.pCallback((GLT_MEMORY_CATEGORY)over[i], GetTotal((GLT_MEMORY_CATEGORY)over[i]), budget.nBytes, budget.pUserData);
+        }
+    }
+
+// With trackerMutex held
+void GLMemoryTracker::CheckBudgets(GLint eCategory)
+    {
+    MEMORYBUDGET& budget = budgets[eCategory];
+    if(budget.nBytes <= 0)
+        return;
+
+    if(totals[eCategory] <= budget.nBytes)
+        budget.bOver = false;
+    else if(!budget.bOver) {
+        budget.bOver = true;
+        crossed.push_back(eCategory);
+        }
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLsizeiptr GLMemoryTracker::GetTotal(GLT_MEMORY_CATEGORY eCategory)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    return totals[eCategory];
+    }
+
+GLsizeiptr GLMemoryTracker::GetHighWater(GLT_MEMORY_CATEGORY eCategory)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    return highWater[eCategory];
+    }
+
+GLint GLMemoryTracker::GetObjectCount(GLT_MEMORY_CATEGORY eCategory)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    if(eCategory != GLT_MEMORY_ALL)
+        return (GLint)entries[eCategory].size();
+
+    GLint nCount = 0;
+    for(GLint c = 0; c < GLT_MEMORY_ALL; c++)
+        nCount += (GLint)entries[c].size();
+    return nCount;
+    }
+
+void GLMemoryTracker::ResetHighWater(void)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    for(GLint c = 0; c <= GLT_MEMORY_ALL; c++)
+        highWater[c] = totals[c];
+    }
+
+// A budget set while already over it calls back on the next change
+void GLMemoryTracker::SetBudget(GLT_MEMORY_CATEGORY eCategory, GLsizeiptr nBytes,
+                                GLT_MEMORY_BUDGET_CALLBACK pCallback, void *pUserData)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    budgets[eCategory].nBytes = nBytes;
+    budgets[eCategory].pCallback = pCallback;
+    budgets[eCategory].pUserData = pUserData;
+    budgets[eCategory].bOver = false;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// With trackerMutex held
+std::string GLMemoryTracker::TagFor(const MEMORYKEY& key, const MEMORYENTRY& entry)
+    {
+    if(key.second == 0) {
+        std::map<const void*, std::string>::iterator it = tags.find(key.first);
+        if(it != tags.end())
+            return it->second;
+        }
+
+    return entry.strTag.empty() ? std::string("(untagged)") : entry.strTag;
+    }
+
+void GLMemoryTracker::GetEntries(std::vector<GLTMEMORYENTRY>& list)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    list.clear();
+    for(GLint c = 0; c < GLT_MEMORY_ALL; c++)
+        for(std::map<MEMORYKEY, MEMORYENTRY>::iterator it = entries[c].begin(); it != entries[c].end(); it++) {
+            GLTMEMORYENTRY entry;
+            entry.pOwner = it->first.first;
+            entry.uiTexture = it->first.second;
+            entry.eCategory = (GLT_MEMORY_CATEGORY)c;
+            entry.nBytes = it->second.nBytes;
+            entry.strTag = TagFor(it->first, it->second);
+            list.push_back(entry);
+            }
+    }
+
+void GLMemoryTracker::Report(FILE *pFile)
+    {
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    fprintf(pFile, "GPU memory held by GLTools objects\n");
+    for(GLint c = 0; c <= GLT_MEMORY_ALL; c++) {
+        GLint nCount = 0;
+        if(c < GLT_MEMORY_ALL)
+            nCount = (GLint)entries[c].size();
+        else
+            for(GLint e = 0; e < GLT_MEMORY_ALL; e++)
+                nCount += (GLint)entries[e].size();
+
+        fprintf(pFile, "  %-12s %12lld bytes  %6d objects  high water %12lld\n", szCategoryNames[c],
+                (long long)totals[c], nCount, (long long)highWater[c]);
+        }
+
+    // Add up each tag's objects, in every category
+    std::map<std::string, std::pair<GLsizeiptr, GLint> > byTag;
+    for(GLint c = 0; c < GLT_MEMORY_ALL; c++)
+        for(std::map<MEMORYKEY, MEMORYENTRY>::iterator it = entries[c].begin(); it != entries[c].end(); it++) {
+            std::pair<GLsizeiptr, GLint>& sum = byTag[TagFor(it->first, it->second)];
+            sum.first += it->second.nBytes;
+            sum.second++;
+            }
+
+    std::vector<std::pair<GLsizeiptr, std::string> > sorted;
+    for(std::map<std::string, std::pair<GLsizeiptr, GLint> >::iterator it = byTag.begin(); it != byTag.end(); it++)
+        sorted.push_back(std::make_pair(it->second.first, it->first));
+    std::sort(sorted.rbegin(), sorted.rend());
+
+    for(size_t i = 0; i < sorted.size(); i++)
+        fprintf(pFile, "  %12lld bytes  %6d  %s\n", (long long)sorted[i].first,
+                byTag[sorted[i].second].second, sorted[i].second.c_str());
+    }
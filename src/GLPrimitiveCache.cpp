@@ -0,0 +1,172 @@
+/*
+GLPrimitiveCache.cpp
+ 
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLTools.h"
+#include "GLPrimitiveCache.h"
+
+static const char *szPrimitiveNames[GLT_PRIMITIVE_LAST] = { "sphere", "torus", "disk", "cylinder" };
+
+
+GLPrimitiveCache::GLPrimitiveCache(void)
+    {
+    szCacheDirectory[0] = '\0';
+    }
+
+GLPrimitiveCache::~GLPrimitiveCache(void)
+    {
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Where to keep meshes between runs. The directory must already exist.
+void GLPrimitiveCache::SetCacheDirectory(const char *szDirectory)
+    {
+    if(szDirectory == NULL) {
+        szCacheDirectory[0] = '\0';
+        return;
+        }
+
+    strncpy(szCacheDirectory, szDirectory, MAX_CACHE_PATH_LENGTH);
+    szCacheDirectory[MAX_CACHE_PATH_LENGTH-1] = '\0';
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unused parameters stay zero so they don't split otherwise identical keys
+std::shared_ptr<GLTriangleBatch> GLPrimitiveCache::Sphere(GLfloat fRadius, GLint iSlices, GLint iStacks)
+    {
+    PRIMITIVEKEY key = { GLT_PRIMITIVE_SPHERE, { fRadius, GLfloat(iSlices), GLfloat(iStacks), 0.0f, 0.0f, 0.0f } };
+    return Lookup(key);
+    }
+
+std::shared_ptr<GLTriangleBatch> GLPrimitiveCache::Torus(GLfloat majorRadius, GLfloat minorRadius, GLint numMajor, GLint numMinor)
+    {
+    PRIMITIVEKEY key = { GLT_PRIMITIVE_TORUS, { majorRadius, minorRadius, GLfloat(numMajor), GLfloat(numMinor), 0.0f, 0.0f } };
+    return Lookup(key);
+    }
+
+std::shared_ptr<GLTriangleBatch> GLPrimitiveCache::Disk(GLfloat innerRadius, GLfloat outerRadius, GLint nSlices, GLint nStacks, GLfloat fDegrees)
+    {
+    PRIMITIVEKEY key = { GLT_PRIMITIVE_DISK, { innerRadius, outerRadius, GLfloat(nSlices), GLfloat(nStacks), fDegrees, 0.0f } };
+    return Lookup(key);
+    }
+
+std::shared_ptr<GLTriangleBatch> GLPrimitiveCache::Cylinder(GLfloat baseRadius, GLfloat topRadius, GLfloat fLength,
+                                                            GLint numSlices, GLint numStacks, GLfloat fDegrees)
+    {
+    PRIMITIVEKEY key = { GLT_PRIMITIVE_CYLINDER, { baseRadius, topRadius, fLength, GLfloat(numSlices), GLfloat(numStacks), fDegrees } };
+    return Lookup(key);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Return the one we already have, or load/make it and keep it around
+std::shared_ptr<GLTriangleBatch> GLPrimitiveCache::Lookup(const PRIMITIVEKEY& key)
+    {
+    std::map<PRIMITIVEKEY, std::shared_ptr<GLTriangleBatch> >::iterator it = cache.find(key);
+    if(it != cache.end())
+        return it->second;
+
+    std::shared_ptr<GLTriangleBatch> pBatch = std::make_shared<GLTriangleBatch>();
+
+    // Try the disk cache first. If it isn't there, make it and put it there.
+    // Every primitive has normals and texture coordinates, so a file that's
+    // short of either was cut off while it was being saved; replace it.
+    char szFileName[MAX_CACHE_PATH_LENGTH + 64];
+    bool bOnDisk = GetCacheFileName(key, szFileName, sizeof(szFileName));
+    if(bOnDisk && pBatch->ReadMesh(szFileName) && pBatch->HasNormals() && pBatch->HasTexCoords())
+        pBatch->End();
+    else {
+        pBatch = std::make_shared<GLTriangleBatch>();
+        Generate(key, *pBatch);
+        // Don't leave a half written file behind to trip over next time
+        if(bOnDisk && !pBatch->SaveMesh(szFileName))
+            remove(szFileName);
+        }
+
+    cache[key] = pBatch;
+    return pBatch;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLPrimitiveCache::Generate(const PRIMITIVEKEY& key, GLTriangleBatch& batch)
+    {
+    const GLfloat *p = key.fParams;
+
+    switch(key.primitive)
+        {
+        case GLT_PRIMITIVE_SPHERE:
+            gltMakeSphere(batch, p[0], GLint(p[1]), GLint(p[2]));
+            break;
+
+        case GLT_PRIMITIVE_TORUS:
+            gltMakeTorus(batch, p[0], p[1], GLint(p[2]), GLint(p[3]));
+            break;
+
+        case GLT_PRIMITIVE_DISK:
+            gltMakeDisk(batch, p[0], p[1], GLint(p[2]), GLint(p[3]), p[4]);
+            break;
+
+        case GLT_PRIMITIVE_CYLINDER:
+            gltMakeCylinder(batch, p[0], p[1], p[2], GLint(p[3]), GLint(p[4]), p[5]);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cache files are named for the generator and a hash of its parameters.
+// Returns false if there is no cache directory.
+bool GLPrimitiveCache::GetCacheFileName(const PRIMITIVEKEY& key, char *szFileName, size_t nLength)
+    {
+    if(szCacheDirectory[0] == '\0' || key.primitive >= GLT_PRIMITIVE_LAST)
+        return false;
+
+    uint64_t hash = gltHashBytes(key.fParams, sizeof(key.fParams));
+    snprintf(szFileName, nLength, "%s/%s_%016llx.mesh", szCacheDirectory, szPrimitiveNames[key.primitive],
+             (unsigned long long)hash);
+    return true;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// If the cache holds the only reference, nobody is drawing it
+void GLPrimitiveCache::Purge(void)
+    {
+    std::map<PRIMITIVEKEY, std::shared_ptr<GLTriangleBatch> >::iterator it = cache.begin();
+    while(it != cache.end()) {
+        if(it->second.use_count() == 1)
+            it = cache.erase(it);
+        else
+            ++it;
+        }
+    }
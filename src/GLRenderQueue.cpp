@@ -0,0 +1,224 @@
+/*
+GLRenderQueue.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLRenderQueue.h"
+
+// Sort key layout. Opaque, high bit clear:
+//      shader (5) | texture (12) | batch (14) | depth (32)
+// Transparent, high bit set:
+//      inverted depth (32) | shader (5) | texture (12) | batch (14)
+// Texture and batch numbers wrap if there are more than fit. That only
+// makes the grouping a little worse; each draw still uses its own.
+#define GLT_KEY_TRANSPARENT     0x8000000000000000ULL
+#define GLT_KEY_SHADER_BITS     5
+#define GLT_KEY_TEXTURE_BITS    12
+#define GLT_KEY_BATCH_BITS      14
+#define GLT_KEY_STATE_BITS      (GLT_KEY_SHADER_BITS + GLT_KEY_TEXTURE_BITS + GLT_KEY_BATCH_BITS)
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLRenderQueue::GLRenderQueue(void)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    nStateChanges = 0;
+    nStateChangesAvoided = 0;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLRenderQueue::Clear(void)
+    {
+    submissions.clear();
+    objects.clear();
+    sortEntries.clear();
+    batchIDs.clear();
+    textureIDs.clear();
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Positive floats sort the same way as their bits do
+uint64_t GLRenderQueue::MakeKey(GLint nShaderID, GLuint iTexture, GLuint iBatch, GLfloat fDepth, bool bTransparent)
+    {
+    uint32_t uiDepth = 0;
+    if(fDepth > 0.0f)
+        memcpy(&uiDepth, &fDepth, sizeof(uint32_t));
+
+    uint64_t state = ((uint64_t)(nShaderID & ((1 << GLT_KEY_SHADER_BITS) - 1)) << (GLT_KEY_TEXTURE_BITS + GLT_KEY_BATCH_BITS)) |
+                     ((uint64_t)(iTexture & ((1 << GLT_KEY_TEXTURE_BITS) - 1)) << GLT_KEY_BATCH_BITS) |
+                     (uint64_t)(iBatch & ((1 << GLT_KEY_BATCH_BITS) - 1));
+
+    if(bTransparent)
+        return GLT_KEY_TRANSPARENT | ((uint64_t)(~uiDepth) << GLT_KEY_STATE_BITS) | state;
+
+    return (state << 32) | uiDepth;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLRenderQueue::Submit(GLBatchBase *pBatch, GLT_STOCK_SHADER nShaderID, const GLTObjectData& object,
+                            GLuint uiTexture, GLfloat fDepth, bool bTransparent)
+    {
+    if(pBatch == nullptr || nShaderID < 0 || nShaderID >= GLT_SHADER_LAST)
+        return;
+
+    GLuint iBatch = batchIDs.emplace(pBatch, (GLuint)batchIDs.size()).first->second;
+    GLuint iTexture = textureIDs.emplace(uiTexture, (GLuint)textureIDs.size()).first->second;
+
+    SUBMISSION submission;
+    submission.pBatch = pBatch;
+    submission.nShaderID = nShaderID;
+    submission.uiTexture = uiTexture;
+    submissions.push_back(submission);
+    objects.push_back(object);
+
+    SORTENTRY entry;
+    entry.key = MakeKey(nShaderID, iTexture, iBatch, fDepth, bTransparent);
+    entry.iSubmission = (GLuint)(submissions.size() - 1);
+    sortEntries.push_back(entry);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Least significant byte first. All eight histograms are built in one pass,
+// and bytes that are the same in every key are skipped, which is most of
+// them for a typical frame.
+void GLRenderQueue::RadixSort(void)
+    {
+    size_t nEntries = sortEntries.size();
+    sortScratch.resize(nEntries);
+
+    size_t histogram[8][256];
+    memset(histogram, 0, sizeof(histogram));
+    for(size_t i = 0; i < nEntries; i++) {
+        uint64_t key = sortEntries[i].key;
+        for(int b = 0; b < 8; b++)
+            histogram[b][(key >> (b * 8)) & 0xFF]++;
+        }
+
+    SORTENTRY *pFrom = sortEntries.data();
+    SORTENTRY *pTo = sortScratch.data();
+    for(int b = 0; b < 8; b++) {
+        size_t *pCounts = histogram[b];
+        if(pCounts[(pFrom[0].key >> (b * 8)) & 0xFF] == nEntries)
+            continue;
+
+        size_t nOffset = 0;
+        for(int i = 0; i < 256; i++) {
+            size_t nCount = pCounts[i];
+            pCounts[i] = nOffset;
+            nOffset += nCount;
+            }
+
+        for(size_t i = 0; i < nEntries; i++)
+            pTo[pCounts[(pFrom[i].key >> (b * 8)) & 0xFF]++] = pFrom[i];
+
+        SORTENTRY *pSwap = pFrom;
+        pFrom = pTo;
+        pTo = pSwap;
+        }
+
+    if(pFrom != sortEntries.data())
+        sortEntries.swap(sortScratch);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLuint GLRenderQueue::CountStateChanges(const SUBMISSION *pFirst, const SUBMISSION *pSecond)
+    {
+    GLuint nChanges = 0;
+    if(pFirst == nullptr || pFirst->nShaderID != pSecond->nShaderID)
+        nChanges++;
+    if(pFirst == nullptr || pFirst->pBatch != pSecond->pBatch)
+        nChanges++;
+    if(pSecond->uiTexture != 0 && (pFirst == nullptr || pFirst->uiTexture != pSecond->uiTexture))
+        nChanges++;
+    return nChanges;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLRenderQueue::Draw(GLShaderManager& shaderManager)
+    {
+    nStateChanges = 0;
+    nStateChangesAvoided = 0;
+    if(submissions.empty())
+        return;
+
+    // Sorting is stable, so drawing the same queue again sorts it the same way
+    RadixSort();
+
+    // The objects go up in draw order, so the object windows are used in turn
+    GLuint nDraws = (GLuint)submissions.size();
+    sortedObjects.resize(nDraws);
+    for(GLuint i = 0; i < nDraws; i++)
+        sortedObjects[i] = objects[sortEntries[i].iSubmission];
+    shaderManager.SetObjects(sortedObjects.data(), nDraws);
+
+    GLStateCache *pState = GLStateCache::GetStateCache();
+    const SUBMISSION *pLast = nullptr;
+    bool bBlending = false;
+    for(GLuint i = 0; i < nDraws; i++) {
+        const SUBMISSION& submission = submissions[sortEntries[i].iSubmission];
+
+        if(!bBlending && (sortEntries[i].key & GLT_KEY_TRANSPARENT)) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+            bBlending = true;
+            }
+
+        if(submission.uiTexture != 0) {
+            pState->ActiveTexture(GL_TEXTURE0);
+            pState->BindTexture(GL_TEXTURE_2D, submission.uiTexture);
+            }
+
+        shaderManager.UseObject(submission.nShaderID, i);
+        submission.pBatch->Draw();
+
+        nStateChanges += CountStateChanges(pLast, &submission);
+        pLast = &submission;
+        }
+
+    if(bBlending) {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        }
+
+    // What it would have cost as submitted
+    GLuint nUnsorted = 0;
+    pLast = nullptr;
+    for(GLuint i = 0; i < nDraws; i++) {
+        nUnsorted += CountStateChanges(pLast, &submissions[i]);
+        pLast = &submissions[i];
+        }
+    if(nUnsorted > nStateChanges)
+        nStateChangesAvoided = nUnsorted - nStateChanges;
+    }
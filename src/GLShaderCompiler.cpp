@@ -0,0 +1,256 @@
+/*
+GLShaderCompiler.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLShaderCompiler.h"
+
+// From GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR    0x91B1
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLShaderCompiler::GLShaderCompiler(void)
+    {
+    nPending = 0;
+    iFirstPending = 0;
+    bParallel = false;
+    bChecked = false;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLint GLShaderCompiler::Add(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+                            const GLint *pIndexes, const char * const *pNames, const char *szName)
+    {
+    PROGRAMENTRY entry;
+    entry.strVertexSrc = szVertexSrc;
+    entry.strFragmentSrc = szFragmentSrc;
+    if(szName != NULL)
+        entry.strName = szName;
+
+    if(nAttributes > GLT_MAX_SHADER_ATTRIBUTES)
+        nAttributes = GLT_MAX_SHADER_ATTRIBUTES;
+    entry.nAttributes = nAttributes;
+    for(GLint i = 0; i < nAttributes; i++) {
+        entry.iIndexes[i] = pIndexes[i];
+        entry.strAttributes[i] = pNames[i];
+        }
+
+    entry.hVertexShader = 0;
+    entry.hFragmentShader = 0;
+    entry.hProgram = 0;
+    entry.key = 0;
+    entry.bCache = false;
+    entry.status = GLT_PROGRAM_QUEUED;
+
+    entries.push_back(entry);
+    return (GLint)entries.size() - 1;
+    }
+
+GLint GLShaderCompiler::AddShaderPairSrcWithAttributes(const char *szVertexSrc, const char *szFragmentSrc, ...)
+    {
+    GLint iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+    const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
+
+    va_list attributeList;
+    va_start(attributeList, szFragmentSrc);
+    GLint nAttributes = gltGetShaderAttributes(attributeList, iIndexes, szNames);
+    va_end(attributeList);
+
+    return Add(szVertexSrc, szFragmentSrc, nAttributes, iIndexes, szNames);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Every compile goes in, then every link, and nothing is asked about until
+// Poll(). Asking would make the driver finish that one first.
+void GLShaderCompiler::Submit(void)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    GLTools *pTools = GLTools::GetGLTools();
+    if(!bChecked) {
+        bParallel = pTools->gltIsExtensionSupported("GL_KHR_parallel_shader_compile");
+        bChecked = true;
+        }
+
+    for(size_t i = iFirstPending; i < entries.size(); i++) {
+        PROGRAMENTRY& entry = entries[i];
+        if(entry.status != GLT_PROGRAM_QUEUED)
+            continue;
+
+        const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
+        for(GLint a = 0; a < entry.nAttributes; a++)
+            szNames[a] = entry.strAttributes[a].c_str();
+
+        entry.bCache = pTools->gltGetProgramCacheKey(entry.strVertexSrc.c_str(), entry.strFragmentSrc.c_str(),
+                                                     entry.nAttributes, entry.iIndexes, szNames, entry.key);
+        if(entry.bCache) {
+            entry.hProgram = pTools->gltLoadProgramBinary(entry.key);
+            if(entry.hProgram != 0) {
+                entry.status = GLT_PROGRAM_READY;
+                continue;
+                }
+            }
+
+        entry.hVertexShader = glCreateShader(GL_VERTEX_SHADER);
+        entry.hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        pTools->gltLoadShaderSrc(entry.strVertexSrc.c_str(), entry.hVertexShader);
+        pTools->gltLoadShaderSrc(entry.strFragmentSrc.c_str(), entry.hFragmentShader);
+        glCompileShader(entry.hVertexShader);
+        glCompileShader(entry.hFragmentShader);
+        }
+
+    for(size_t i = iFirstPending; i < entries.size(); i++) {
+        PROGRAMENTRY& entry = entries[i];
+        if(entry.status != GLT_PROGRAM_QUEUED)
+            continue;
+
+        entry.hProgram = glCreateProgram();
+        glAttachShader(entry.hProgram, entry.hVertexShader);
+        glAttachShader(entry.hProgram, entry.hFragmentShader);
+        for(GLint a = 0; a < entry.nAttributes; a++)
+            glBindAttribLocation(entry.hProgram, entry.iIndexes[a], entry.strAttributes[a].c_str());
+
+#ifndef __EMSCRIPTEN__
+        if(entry.bCache)
+            glProgramParameteri(entry.hProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(entry.hProgram);
+
+        entry.status = GLT_PROGRAM_PENDING;
+        nPending++;
+        }
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool GLShaderCompiler::Poll(GLint nMaxWaits)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    GLint nWaits = 0;
+    for(size_t i = iFirstPending; i < entries.size() && nPending > 0; i++) {
+        PROGRAMENTRY& entry = entries[i];
+        if(entry.status != GLT_PROGRAM_PENDING)
+            continue;
+
+        if(bParallel) {
+            GLint bDone = GL_FALSE;
+            glGetProgramiv(entry.hProgram, GL_COMPLETION_STATUS_KHR, &bDone);
+            if(bDone == GL_FALSE)
+                continue;
+            }
+        else if(nWaits++ >= nMaxWaits)
+            break;
+
+        Complete(entry);
+        }
+
+    while(iFirstPending < (GLint)entries.size() && entries[iFirstPending].status >= GLT_PROGRAM_READY)
+        iFirstPending++;
+
+    return nPending == 0;
+    }
+
+void GLShaderCompiler::Finish(void)
+    {
+    Submit();
+    for(size_t i = iFirstPending; i < entries.size(); i++)
+        if(entries[i].status == GLT_PROGRAM_PENDING)
+            Complete(entries[i]);
+
+    iFirstPending = (GLint)entries.size();
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The link status is the only thing that has to be asked. The compile logs
+// are only needed if it failed.
+void GLShaderCompiler::Complete(PROGRAMENTRY& entry)
+    {
+    GLTools *pTools = GLTools::GetGLTools();
+    const char *szName = entry.strName.empty() ? NULL : entry.strName.c_str();
+
+    GLint testVal;
+    glGetProgramiv(entry.hProgram, GL_LINK_STATUS, &testVal);
+    if(testVal == GL_FALSE) {
+        pTools->gltLogProgramErrors(entry.hProgram, entry.hVertexShader, entry.hFragmentShader, szName, szName);
+        glDeleteProgram(entry.hProgram);
+        entry.hProgram = 0;
+        entry.status = GLT_PROGRAM_FAILED;
+        }
+    else {
+        if(entry.bCache)
+            pTools->gltSaveProgramBinary(entry.hProgram, entry.key);
+        entry.status = GLT_PROGRAM_READY;
+        }
+
+    glDeleteShader(entry.hVertexShader);
+    glDeleteShader(entry.hFragmentShader);
+    entry.hVertexShader = 0;
+    entry.hFragmentShader = 0;
+    nPending--;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLT_PROGRAM_STATUS GLShaderCompiler::GetStatus(GLint iHandle)
+    {
+    if(iHandle < 0 || iHandle >= (GLint)entries.size())
+        return GLT_PROGRAM_FAILED;
+    return entries[iHandle].status;
+    }
+
+GLuint GLShaderCompiler::GetProgram(GLint iHandle)
+    {
+    if(GetStatus(iHandle) != GLT_PROGRAM_READY)
+        return 0;
+    return entries[iHandle].hProgram;
+    }
+
+// Anything still in flight was never handed out, so it goes
+void GLShaderCompiler::Clear(void)
+    {
+    for(size_t i = iFirstPending; i < entries.size(); i++) {
+        PROGRAMENTRY& entry = entries[i];
+        if(entry.status != GLT_PROGRAM_PENDING)
+            continue;
+
+        glDeleteProgram(entry.hProgram);
+        glDeleteShader(entry.hVertexShader);
+        glDeleteShader(entry.hFragmentShader);
+        }
+
+    entries.clear();
+    nPending = 0;
+    iFirstPending = 0;
+    }
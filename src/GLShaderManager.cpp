@@ -26,34 +26,54 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 
 #include "GLTools.h"
 #include "GLShaderManager.h"
+#include "GLShaderCompiler.h"
+#include "GLShaderPreprocessor.h"
+#include "target.h"
+#include <stddef.h>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Stock Shader Source Code
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// Uniform blocks shared by the stock shaders. They match GLTFrameData and
+// GLTObjectData. Per-object values come from the plain uniforms, or from
+// objects[iObject] when iObject isn't negative (see UseObject()).
+#define GLT_STRINGIFY(x)    GLT_STRINGIFY2(x)
+#define GLT_STRINGIFY2(x)   #x
+
+#define GLT_FRAME_BLOCK_SRC     "layout(std140) uniform GLTFrame { mat4 pMatrix; vec4 vLightPos; };"
+#define GLT_OBJECT_BLOCK_SRC    "struct GLTObject { mat4 mvMatrix; mat4 mvpMatrix; mat3 normalMatrix; vec4 vColor; };" \
+                                "layout(std140) uniform GLTObjects { GLTObject objects[" GLT_STRINGIFY(GLT_BLOCK_OBJECTS) "]; };" \
+                                "uniform int iObject;"
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Every stock shader goes through GLShaderPreprocessor, which puts the right
+// #version line in front. Several stock shaders come from the same source,
+// told apart by the defines in stockSources below. Those sources need real
+// line breaks, since the #ifdefs have to start lines.
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Identity Shader (GLT_SHADER_IDENTITY)
 // This shader does no transformations at all, and uses the current
 // glColor value for fragments.
 // It will shade between verticies.
 static const char *szIdentityShaderVP =
-#ifndef OPENGL_ES
-                                        "#version 400\r\n"
-#else
-                                        "#version 300 es\r\n"
-#endif
                                         "in vec4 vVertex;"
                                         "void main(void) "
                                         "{ gl_Position = vVertex; "
                                         "}";
 
 static const char *szIdentityShaderFP =
-#ifndef OPENGL_ES
-                                        "#version 400\r\n"
-#else
-                                        "#version 300 es\r\n"
-#endif
                                         "precision mediump float;"
                                         "out vec4 vFragmentColor;"
                                         "uniform vec4 vColor;"
@@ -63,63 +83,76 @@ static const char *szIdentityShaderFP =
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Flat Shader (GLT_SHADER_FLAT)
-// This shader applies the given model view matrix to the verticies,
-// and uses a uniform color value.
-static const char *szFlatShaderVP =
-#ifndef OPENGL_ES
-                                    "#version 400\r\n"
-#else
-                                    "#version 300 es\r\n"
-
-#endif
-                                    "precision mediump float;"
-                                    "uniform mat4 mvpMatrix;"
-                                    "in vec4 vVertex;"
-                                    "void main(void) "
-                                    "{ gl_Position = mvpMatrix * vVertex; "
-                                    "}";
-
-static const char *szFlatShaderFP =
-#ifndef OPENGL_ES
-                                            "#version 400\r\n"
-#else
-                                            "#version 300 es\r\n"
-
-#endif
-                                    "precision mediump float;"
-                                    "out vec4 vFragmentColor;"
-                                    "uniform vec4 vColor;"
-                                    "void main(void) "
-                                    "{ vFragmentColor = vColor; "
-                                    "}";
+// Unlit Shader
+// Applies the given model view projection matrix to the verticies, with no
+// lighting. GLT_COLOR uses a uniform color value (GLT_SHADER_FLAT), and
+// GLT_TEXTURE puts the texture on the polygons (GLT_SHADER_TEXTURE_REPLACE).
+// With both, the texture is multiplied by the color (GLT_SHADER_TEXTURE_MODULATE).
+static const char *szUnlitVP =
+                                    "precision mediump float;\n"
+                                    "uniform mat4 mvpMatrix;\n"
+                                    GLT_OBJECT_BLOCK_SRC "\n"
+                                    "in vec4 vVertex;\n"
+                                    "#ifdef GLT_COLOR\n"
+                                    "uniform vec4 vColor;\n"
+                                    "out vec4 vFlatColor;\n"
+                                    "#endif\n"
+                                    "#ifdef GLT_TEXTURE\n"
+                                    "in vec2 vTexCoord0;\n"
+                                    "out vec2 vTex;\n"
+                                    "#endif\n"
+                                    "void main(void) {\n"
+                                    "#ifdef GLT_TEXTURE\n"
+                                    " vTex = vTexCoord0;\n"
+                                    "#endif\n"
+                                    " if(iObject >= 0) {\n"
+                                    "#ifdef GLT_COLOR\n"
+                                    "   vFlatColor = objects[iObject].vColor;\n"
+                                    "#endif\n"
+                                    "   gl_Position = objects[iObject].mvpMatrix * vVertex; }\n"
+                                    " else {\n"
+                                    "#ifdef GLT_COLOR\n"
+                                    "   vFlatColor = vColor;\n"
+                                    "#endif\n"
+                                    "   gl_Position = mvpMatrix * vVertex; }\n"
+                                    "}\n";
+
+static const char *szUnlitFP =
+                                    "precision mediump float;\n"
+                                    "out vec4 vFragmentColor;\n"
+                                    "#ifdef GLT_COLOR\n"
+                                    "in vec4 vFlatColor;\n"
+                                    "#endif\n"
+                                    "#ifdef GLT_TEXTURE\n"
+                                    "in vec2 vTex;\n"
+                                    "uniform sampler2D textureUnit0;\n"
+                                    "#endif\n"
+                                    "void main(void) {\n"
+                                    " vFragmentColor = vec4(1.0);\n"
+                                    "#ifdef GLT_COLOR\n"
+                                    " vFragmentColor *= vFlatColor;\n"
+                                    "#endif\n"
+                                    "#ifdef GLT_TEXTURE\n"
+                                    " vFragmentColor *= texture(textureUnit0, vTex);\n"
+                                    "#endif\n"
+                                    "}\n";
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // GLT_SHADER_SHADED
 // Point light, diffuse lighting only
 static const char *szShadedVP =
-#ifndef OPENGL_ES
-                                    "#version 400\r\n"
-#else
-                                    "#version 300 es\r\n"
-#endif
                                     "uniform mat4 mvpMatrix;"
+                                    GLT_OBJECT_BLOCK_SRC
                                     "in vec4 vColor;"
                                     "in vec4 vVertex;"
                                     "out vec4 vFragColor;"
                                     "void main(void) {"
                                     "vFragColor = vColor; "
-                                    " gl_Position = mvpMatrix * vVertex; "
+                                    " gl_Position = ((iObject >= 0) ? objects[iObject].mvpMatrix : mvpMatrix) * vVertex; "
                                     "}";
 
 static const char *szShadedFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-
-        #endif
                                     "precision mediump float;"
                                     "out vec4 vFragmentColor;"
                                     "in vec4 vFragColor; "
@@ -130,236 +163,79 @@ static const char *szShadedFP =
 #endif
                                     "}";
 
-// GLT_SHADER_DEFAULT_LIGHT
-// Simple diffuse, directional, and vertex based light
-static const char *szDefaultLightVP =
-#ifndef OPENGL_ES
-                                    "#version 400\r\n"
-#else
-                                     "#version 300 es\r\n"
-
-#endif
-                                      "uniform mat4 mvMatrix;"
-                                      "uniform mat4 pMatrix;"
-                                      "out vec4 vFragColor;"
-                                      "in vec4 vVertex;"
-                                      "in vec3 vNormal;"
-                                      "uniform vec4 vColor;"
-                                      "void main(void) { "
-                                      " mat3 mNormalMatrix;"
-                                      " mNormalMatrix[0] = normalize(mvMatrix[0].xyz);"
-                                      " mNormalMatrix[1] = normalize(mvMatrix[1].xyz);"
-                                      " mNormalMatrix[2] = normalize(mvMatrix[2].xyz);"
-                                      " vec3 vNorm = normalize(mNormalMatrix * normalize(vNormal));"
-                                      " vec3 vLightDir = vec3(0.0, 0.0, 1.0); "
-                                      " float fDot = max(0.0, dot(vNorm, vLightDir)); "
-                                      " vFragColor.rgb = vColor.rgb * fDot;"
-                                      " vFragColor.a = vColor.a;"
-                                      " mat4 mvpMatrix;"
-                                      " mvpMatrix = pMatrix * mvMatrix;"
-                                      " gl_Position = mvpMatrix * vVertex; "
-                                      "}";
-
-
-static const char *szDefaultLightFP =
- #ifndef OPENGL_ES
-                                            "#version 400\r\n"
- #else
-                                        "#version 300 es\r\n"
-
- #endif
-                                        "precision mediump float;"
-                                        "out vec4 vFragmentColor;"
-                                        "in vec4 vFragColor; "
-                                        "void main(void) { "
-                                        " vFragmentColor = vFragColor; "
-                                        "}";
-
-//GLT_SHADER_POINT_LIGHT_DIFF
-// Point light, diffuse lighting only
-static const char *szPointLightDiffVP =
-#ifndef OPENGL_ES
-                                          "#version 400\r\n"
-#else
-        "#version 300 es\r\n"
-#endif
-                                          "uniform mat4 mvMatrix;"
-                                          "uniform mat4 pMatrix;"
-                                          "uniform vec3 vLightPos;"
-                                          "uniform vec4 vColor;"
-                                          "in vec4 vVertex;"
-                                          "in vec3 vNormal;"
-                                          "out vec4 vFragColor;"
-                                          "void main(void) { "
-                                          " mat3 mNormalMatrix;"
-                                          " mNormalMatrix[0] = normalize(mvMatrix[0].xyz);"
-                                          " mNormalMatrix[1] = normalize(mvMatrix[1].xyz);"
-                                          " mNormalMatrix[2] = normalize(mvMatrix[2].xyz);"
-                                          " vec3 vNorm = normalize(mNormalMatrix * vNormal);"
-                                          " vec4 ecPosition;"
-                                          " vec3 ecPosition3;"
-                                          " ecPosition = mvMatrix * vVertex;"
-                                          " ecPosition3 = ecPosition.xyz /ecPosition.w;"
-                                          " vec3 vLightDir = normalize(vLightPos - ecPosition3);"
-                                          " float fDot = max(0.0, dot(vNorm, vLightDir)); "
-                                          " vFragColor.rgb = vColor.rgb * fDot;"
-                                          " vFragColor.a = vColor.a;"
-                                          " mat4 mvpMatrix;"
-                                          " mvpMatrix = pMatrix * mvMatrix;"
-                                          " gl_Position = mvpMatrix * vVertex; "
-                                          "}";
-
-
-static const char *szPointLightDiffFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-
-        #endif
-                                        "precision mediump float;"
-                                        "out vec4 vFragmentColor;"
-                                        "in vec4 vFragColor; "
-                                        "void main(void) { "
-                                        " vFragmentColor = vFragColor; "
-                                        "}";
-
-//GLT_SHADER_TEXTURE_REPLACE
-// Just put the texture on the polygons
-static const char *szTextureReplaceVP =
-#ifndef OPENGL_ES
-                                        "#version 400\r\n"
-#else
-                                        "#version 300 es\r\n"
-#endif
-                                        "uniform mat4 mvpMatrix;"
-                                        "in vec4 vVertex;"
-                                        "in vec2 vTexCoord0;"
-                                        "out vec2 vTex;"
-                                        "void main(void) "
-                                        "{ vTex = vTexCoord0;"
-                                        " gl_Position = mvpMatrix * vVertex; "
-                                        "}";
-
-static const char *szTextureReplaceFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-
-        #endif
-                                        "precision mediump float;"
-                                        "out vec4 vFragColor;"
-                                        "in vec2 vTex;"
-                                        "uniform sampler2D textureUnit0;"
-                                        "void main(void) "
-                                        "{ "
-                                        "vFragColor = texture(textureUnit0, vTex);"
-                                        "}";
-
-
-
-//GLT_SHADER_TEXTURE_MODULATE
-// Just put the texture on the polygons, but multiply by the color (as a unifomr)
-static const char *szTextureModulateVP =
-#ifndef OPENGL_ES
-                                        "#version 400\r\n"
-#else
-        "#version 300 es\r\n"
-#endif
-                                        "uniform mat4 mvpMatrix;"
-                                        "in vec4 vVertex;"
-                                        "in vec2 vTexCoord0;"
-                                        "out vec2 vTex;"
-                                        "void main(void) "
-                                        "{ vTex = vTexCoord0;"
-                                        " gl_Position = mvpMatrix * vVertex; "
-                                        "}";
-
-static const char *szTextureModulateFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-        #endif
-                                        "precision mediump float;"
-                                        "out vec4 vFragmentColor;"
-                                        "in vec2 vTex;"
-                                        "uniform sampler2D textureUnit0;"
-                                        "uniform vec4 vColor;"
-                                        "void main(void) "
-                                        "{ vFragmentColor = vColor * texture(textureUnit0, vTex); "
-                                        "}";
-
-
-
-
-//GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF
-// Point light (Diffuse only), with texture (modulated)
-static const char *szTexturePointLightDiffVP =
-#ifndef OPENGL_ES
-                                                 "#version 400\r\n"
-#else
-        "#version 300 es\r\n"
-#endif
-                                                  "uniform mat4 mvMatrix;"
-                                                  "uniform mat4 pMatrix;"
-                                                  "uniform vec3 vLightPos;"
-                                                  "uniform vec4 vColor;"
-                                                  "in vec4 vVertex;"
-                                                  "in vec3 vNormal;"
-                                                  "out vec4 vFragColor;"
-                                                  "in vec2 vTexCoord0;"
-                                                  "out vec2 vTex;"
-                                                  "void main(void) { "
-                                                  " mat3 mNormalMatrix;"
-                                                  " mNormalMatrix[0] = normalize(mvMatrix[0].xyz);"
-                                                  " mNormalMatrix[1] = normalize(mvMatrix[1].xyz);"
-                                                  " mNormalMatrix[2] = normalize(mvMatrix[2].xyz);"
-                                                  " vec3 vNorm = normalize(mNormalMatrix * vNormal);"
-                                                  " vec4 ecPosition;"
-                                                  " vec3 ecPosition3;"
-                                                  " ecPosition = mvMatrix * vVertex;"
-                                                  " ecPosition3 = ecPosition.xyz /ecPosition.w;"
-                                                  " vec3 vLightDir = normalize(vLightPos - ecPosition3);"
-                                                  " float fDot = max(0.0, dot(vNorm, vLightDir)); "
-                                                  " vFragColor.rgb = (vColor.rgb * fDot);"
-                                                  " vFragColor.a = vColor.a;"
-                                                  " vTex = vTexCoord0;"
-                                                  " mat4 mvpMatrix;"
-                                                  " mvpMatrix = pMatrix * mvMatrix;"
-                                                  " gl_Position = mvpMatrix * vVertex; "
-                                                  "}";
-
-
-static const char *szTexturePointLightDiffFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-
-        #endif
-                                                "precision mediump float;"
-                                                "out vec4 vFragmentColor;"
-                                                "in vec4 vFragColor;"
-                                                "in vec2 vTex;"
-                                                "uniform sampler2D textureUnit0;"
-                                                "void main(void) { "
-                                                " vFragmentColor = vFragColor * texture(textureUnit0, vTex);"
-                                                "}";
-
-
 
+///////////////////////////////////////////////////////////////////////////////
+// Lit Shader
+// Diffuse, vertex based light. By itself the light is directional, straight
+// down the z axis (GLT_SHADER_DEFAULT_LIGHT). GLT_POINT_LIGHT uses the point
+// light in GLTFrame instead (GLT_SHADER_POINT_LIGHT_DIFF), and GLT_TEXTURE
+// modulates a texture by the result (GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF).
+static const char *szLitVP =
+                                      "uniform mat4 mvpMatrix;\n"
+                                      "uniform mat3 normalMatrix;\n"
+                                      "uniform vec4 vColor;\n"
+                                      "#ifdef GLT_POINT_LIGHT\n"
+                                      "uniform mat4 mvMatrix;\n"
+                                      GLT_FRAME_BLOCK_SRC "\n"
+                                      "#endif\n"
+                                      GLT_OBJECT_BLOCK_SRC "\n"
+                                      "in vec4 vVertex;\n"
+                                      "in vec3 vNormal;\n"
+                                      "out vec4 vFragColor;\n"
+                                      "#ifdef GLT_TEXTURE\n"
+                                      "in vec2 vTexCoord0;\n"
+                                      "out vec2 vTex;\n"
+                                      "#endif\n"
+                                      "void main(void) {\n"
+                                      " mat4 mvpObject = mvpMatrix;\n"
+                                      " mat3 mNormalMatrix = normalMatrix;\n"
+                                      " vec4 vObjectColor = vColor;\n"
+                                      "#ifdef GLT_POINT_LIGHT\n"
+                                      " mat4 mvObject = mvMatrix;\n"
+                                      "#endif\n"
+                                      " if(iObject >= 0) {\n"
+                                      "   mvpObject = objects[iObject].mvpMatrix;\n"
+                                      "   mNormalMatrix = objects[iObject].normalMatrix;\n"
+                                      "#ifdef GLT_POINT_LIGHT\n"
+                                      "   mvObject = objects[iObject].mvMatrix;\n"
+                                      "#endif\n"
+                                      "   vObjectColor = objects[iObject].vColor; }\n"
+                                      " vec3 vNorm = normalize(mNormalMatrix * vNormal);\n"
+                                      "#ifdef GLT_POINT_LIGHT\n"
+                                      " vec4 ecPosition = mvObject * vVertex;\n"
+                                      " vec3 ecPosition3 = ecPosition.xyz / ecPosition.w;\n"
+                                      " vec3 vLightDir = normalize(vLightPos.xyz - ecPosition3);\n"
+                                      "#else\n"
+                                      " vec3 vLightDir = vec3(0.0, 0.0, 1.0);\n"
+                                      "#endif\n"
+                                      " float fDot = max(0.0, dot(vNorm, vLightDir));\n"
+                                      " vFragColor.rgb = vObjectColor.rgb * fDot;\n"
+                                      " vFragColor.a = vObjectColor.a;\n"
+                                      "#ifdef GLT_TEXTURE\n"
+                                      " vTex = vTexCoord0;\n"
+                                      "#endif\n"
+                                      " gl_Position = mvpObject * vVertex;\n"
+                                      "}\n";
+
+static const char *szLitFP =
+                                        "precision mediump float;\n"
+                                        "out vec4 vFragmentColor;\n"
+                                        "in vec4 vFragColor;\n"
+                                        "#ifdef GLT_TEXTURE\n"
+                                        "in vec2 vTex;\n"
+                                        "uniform sampler2D textureUnit0;\n"
+                                        "#endif\n"
+                                        "void main(void) {\n"
+                                        " vFragmentColor = vFragColor;\n"
+                                        "#ifdef GLT_TEXTURE\n"
+                                        " vFragmentColor *= texture(textureUnit0, vTex);\n"
+                                        "#endif\n"
+                                        "}\n";
 
 
 // GLT_SHADER_POINT_SPRITES
 // Draws point sprites of a given size and color. Custom texture coordinates are required, as they are generally a lookup.
 static const char *szPointSpriteVP =
-#ifndef OPENGL_ES
-                                        "#version 400\r\n"
-#else
-        "#version 300 es\r\n"
-#endif
                                         "uniform mat4 mvpMatrix;"
                                         "in vec4 vVertex;"   // XYZ, and size
                                         "in vec4 vTexCoord0;"
@@ -374,12 +250,6 @@ static const char *szPointSpriteVP =
                                         "}";
 
 static const char *szPointSpriteFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-
-        #endif
                                         "precision mediump float;"
                                         "out vec4 vFragmentColor;"
                                         "in vec4 vTex;"
@@ -400,11 +270,6 @@ static const char *szPointSpriteFP =
 // GLT_SHADER_POINT_SPRITES_PLAIN
 // Draws point sprites of a given size and color. No texture.
 static const char *szPointSpritePlainVP =
-#ifndef OPENGL_ES
-                                        "#version 400\r\n"
-#else
-                                        "#version 300 es\r\n"
-#endif
                                         "uniform mat4 mvpMatrix;"
                                         "in vec4 vVertex;"   // XYZ, and size
                                         "in vec4 vColor;"
@@ -417,12 +282,6 @@ static const char *szPointSpritePlainVP =
                                         "}";
 
 static const char *szPointSpritePlainFP =
-        #ifndef OPENGL_ES
-                                            "#version 400\r\n"
-        #else
-                                            "#version 300 es\r\n"
-
-        #endif
                                         "precision mediump float;"
                                         "out vec4 vFragmentColor;"
                                         "in vec4 vPointColor;"
@@ -435,9 +294,59 @@ static const char *szPointSpritePlainFP =
                                         "}";
 
 
+///////////////////////////////////////////////////////////////////////////////
+// GLT_SHADER_INSTANCED_BOX
+// Draws the unit cube from gltMakeInstancedCube() once per box. Each box
+// brings its own center, half size, and color. A fixed light from above
+// keeps the faces apart.
+static const char *szInstancedBoxVP =
+                                    "uniform mat4 mvpMatrix;"
+                                    "in vec4 vVertex;"
+                                    "in vec3 vNormal;"
+                                    "in vec3 vInstanceCenter;"
+                                    "in vec3 vInstanceExtent;"
+                                    "in vec4 vInstanceColor;"
+                                    "out vec4 vFragColor;"
+                                    "void main(void) {"
+                                    " float fShade = 0.75 + 0.25 * dot(vNormal, vec3(0.27, 0.8, 0.53));"
+                                    " vFragColor = vec4(vInstanceColor.rgb * fShade, vInstanceColor.a);"
+                                    " gl_Position = mvpMatrix * vec4(vInstanceCenter + vVertex.xyz * vInstanceExtent, 1.0);"
+                                    "}";
 
+static const char *szInstancedBoxFP =
+                                    "precision mediump float;"
+                                    "out vec4 vFragmentColor;"
+                                    "in vec4 vFragColor;"
+                                    "void main(void) {"
+                                    " vFragmentColor = vFragColor;"
+                                    "}";
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Source and defines for each stock shader, in GLT_STOCK_SHADER order
+struct STOCKSOURCE {
+    const char  *szVertexSrc;
+    const char  *szFragmentSrc;
+    const char  *szDefines;
+    };
+
+static const STOCKSOURCE stockSources[GLT_SHADER_LAST] = {
+    { szIdentityShaderVP,   szIdentityShaderFP,     NULL },                             // GLT_SHADER_IDENTITY
+    { szUnlitVP,            szUnlitFP,              "GLT_COLOR" },                      // GLT_SHADER_FLAT
+    { szShadedVP,           szShadedFP,             NULL },                             // GLT_SHADER_SHADED
+    { szLitVP,              szLitFP,                NULL },                             // GLT_SHADER_DEFAULT_LIGHT
+    { szLitVP,              szLitFP,                "GLT_POINT_LIGHT" },                // GLT_SHADER_POINT_LIGHT_DIFF
+    { szUnlitVP,            szUnlitFP,              "GLT_TEXTURE" },                    // GLT_SHADER_TEXTURE_REPLACE
+    { szUnlitVP,            szUnlitFP,              "GLT_COLOR GLT_TEXTURE" },          // GLT_SHADER_TEXTURE_MODULATE
+    { szLitVP,              szLitFP,                "GLT_POINT_LIGHT GLT_TEXTURE" },    // GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF
+    { szPointSpriteVP,      szPointSpriteFP,        NULL },                             // GLT_SHADER_POINT_SPRITES
+    { szPointSpritePlainVP, szPointSpritePlainFP,   NULL },                             // GLT_POINT_SPRITES_PLAIN
+    { szInstancedBoxVP,     szInstancedBoxFP,       NULL }                              // GLT_SHADER_INSTANCED_BOX
+    };
+
+
+// Uniform names, in GLT_STOCK_UNIFORM order
+static const char *szStockUniformNames[GLT_UNIFORM_LAST] = { "mvpMatrix", "mvMatrix", "normalMatrix", "vColor", "textureUnit0", "iObject" };
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -445,13 +354,30 @@ static const char *szPointSpritePlainFP =
 GLShaderManager::GLShaderManager(void)
     {
     // Set stock shader handles to 0... uninitialized
-    for(unsigned int i = 0; i < GLT_SHADER_LAST; i++)
+    for(unsigned int i = 0; i < GLT_SHADER_LAST; i++) {
         uiStockShaders[i] = 0;
+        for(unsigned int u = 0; u < GLT_UNIFORM_LAST; u++)
+            iStockUniforms[i][u] = -1;
+        }
+
+    uiFrameBuffer = 0;
+    uiObjectBuffer = 0;
+    memset(&frameData, 0, sizeof(GLTFrameData));
+    nObjectWindowStride = 0;
+    iObjectWindow = -1;
+
+    iWatchFile = -1;
+    pReloadCompiler = NULL;
+    bReloadsWaiting = false;
+
+    InvalidateUniformCache();
     }
 
 ///////////////////////////////////////////////////////////////////////////////
 GLShaderManager::~GLShaderManager(void)
     {
+    WatchShaderFiles(false);
+    delete pReloadCompiler;
     }
 
 
@@ -461,8 +387,38 @@ void GLShaderManager::freeGL(void)
     if(uiStockShaders[0] != 0) {
         unsigned int i;
         for(i = 0; i < GLT_SHADER_LAST; i++)
-            glDeleteProgram(uiStockShaders[i]);
+            GLStateCache::GetStateCache()->DeleteProgram(uiStockShaders[i]);
+        }
+
+    // Every loaded program, however many references are left
+    std::unordered_map<uint64_t, SHADERLOOKUPENTRY>::iterator it;
+    for(it = shaderTable.begin(); it != shaderTable.end(); ++it) {
+        GLStateCache::GetStateCache()->DeleteProgram(it->second.uiShaderID);
+        for(size_t i = 0; i < it->second.oldPrograms.size(); i++)
+            GLStateCache::GetStateCache()->DeleteProgram(it->second.oldPrograms[i]);
+        }
+    shaderTable.clear();
+    shaderNames.clear();
+
+    // Reloads still building
+    if(pReloadCompiler != NULL)
+        pReloadCompiler->Clear();
+
+    if(uiFrameBuffer != 0) {
+        GLStateCache::GetStateCache()->DeleteBuffers(1, &uiFrameBuffer);
+        GLStateCache::GetStateCache()->DeleteBuffers(1, &uiObjectBuffer);
+        uiFrameBuffer = 0;
+        uiObjectBuffer = 0;
         }
+
+    InvalidateUniformCache();
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLShaderManager::SetProgramCacheDirectory(const char *szDirectory)
+    {
+    GLTools::GetGLTools()->gltSetProgramCacheDirectory(szDirectory);
     }
 
 
@@ -474,50 +430,115 @@ bool GLShaderManager::InitializeStockShaders(void)
     initializeOpenGLFunctions();
 #endif
 
-    uiStockShaders[GLT_SHADER_IDENTITY]			= GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szIdentityShaderVP, szIdentityShaderFP, 1, GLT_ATTRIBUTE_VERTEX, "vVertex");
-    uiStockShaders[GLT_SHADER_FLAT]				= GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szFlatShaderVP, szFlatShaderFP, 1, GLT_ATTRIBUTE_VERTEX, "vVertex");
+    GLShaderPreprocessor preprocessor;
+    std::string strVP[GLT_SHADER_LAST], strFP[GLT_SHADER_LAST];
+    for(int shader = GLT_SHADER_IDENTITY; shader < GLT_SHADER_LAST; shader++) {
+        preprocessor.Process(stockSources[shader].szVertexSrc, stockSources[shader].szDefines, strVP[shader]);
+        preprocessor.Process(stockSources[shader].szFragmentSrc, stockSources[shader].szDefines, strFP[shader]);
+        }
+
+    // Every compile and link goes to the driver before any of them is waited on
+    GLShaderCompiler compiler;
+    GLint iHandles[GLT_SHADER_LAST];
+
+    iHandles[GLT_SHADER_IDENTITY]			= compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_IDENTITY].c_str(), strFP[GLT_SHADER_IDENTITY].c_str(), 1, GLT_ATTRIBUTE_VERTEX, "vVertex");
+    iHandles[GLT_SHADER_FLAT]				= compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_FLAT].c_str(), strFP[GLT_SHADER_FLAT].c_str(), 1, GLT_ATTRIBUTE_VERTEX, "vVertex");
 
-    uiStockShaders[GLT_SHADER_SHADED]			= GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szShadedVP, szShadedFP, 2,
+    iHandles[GLT_SHADER_SHADED]			= compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_SHADED].c_str(), strFP[GLT_SHADER_SHADED].c_str(), 2,
                                                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_COLOR, "vColor");
 
 
-    uiStockShaders[GLT_SHADER_DEFAULT_LIGHT]	= GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szDefaultLightVP, szDefaultLightFP, 2,
+    iHandles[GLT_SHADER_DEFAULT_LIGHT]	= compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_DEFAULT_LIGHT].c_str(), strFP[GLT_SHADER_DEFAULT_LIGHT].c_str(), 2,
                                                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_NORMAL, "vNormal");
 
-    uiStockShaders[GLT_SHADER_POINT_LIGHT_DIFF] = GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szPointLightDiffVP, szPointLightDiffFP, 2,
+    iHandles[GLT_SHADER_POINT_LIGHT_DIFF] = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_POINT_LIGHT_DIFF].c_str(), strFP[GLT_SHADER_POINT_LIGHT_DIFF].c_str(), 2,
                                                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_NORMAL, "vNormal");
 
-    uiStockShaders[GLT_SHADER_TEXTURE_REPLACE]  = GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szTextureReplaceVP, szTextureReplaceFP, 2,
+    iHandles[GLT_SHADER_TEXTURE_REPLACE]  = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_TEXTURE_REPLACE].c_str(), strFP[GLT_SHADER_TEXTURE_REPLACE].c_str(), 2,
                                                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_TEXTURE0, "vTexCoord0");
 
-    uiStockShaders[GLT_SHADER_TEXTURE_MODULATE] = GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szTextureModulateVP, szTextureModulateFP, 2,
+    iHandles[GLT_SHADER_TEXTURE_MODULATE] = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_TEXTURE_MODULATE].c_str(), strFP[GLT_SHADER_TEXTURE_MODULATE].c_str(), 2,
                                                         GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_TEXTURE0, "vTexCoord0");
 
-    uiStockShaders[GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF] = GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szTexturePointLightDiffVP, szTexturePointLightDiffFP, 3,
+    iHandles[GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF] = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF].c_str(), strFP[GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF].c_str(), 3,
                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_NORMAL, "vNormal", GLT_ATTRIBUTE_TEXTURE0, "vTexCoord0");
 
 
-    uiStockShaders[GLT_SHADER_POINT_SPRITES] = GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szPointSpriteVP, szPointSpriteFP, 3,
+    iHandles[GLT_SHADER_POINT_SPRITES] = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_POINT_SPRITES].c_str(), strFP[GLT_SHADER_POINT_SPRITES].c_str(), 3,
                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_COLOR, "vColor", GLT_ATTRIBUTE_TEXTURE0, "vTexCoord0");
 
-    uiStockShaders[GLT_POINT_SPRITES_PLAIN] = GLTools::GetGLTools()->gltLoadShaderPairSrcWithAttributes(szPointSpritePlainVP, szPointSpritePlainFP, 2,
+    iHandles[GLT_POINT_SPRITES_PLAIN] = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_POINT_SPRITES_PLAIN].c_str(), strFP[GLT_POINT_SPRITES_PLAIN].c_str(), 2,
                                                                 GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_COLOR, "vColor");
 
+    iHandles[GLT_SHADER_INSTANCED_BOX] = compiler.AddShaderPairSrcWithAttributes(strVP[GLT_SHADER_INSTANCED_BOX].c_str(), strFP[GLT_SHADER_INSTANCED_BOX].c_str(), 5,
+                                                                GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_NORMAL, "vNormal",
+                                                                GLT_ATTRIBUTE_INSTANCE_CENTER, "vInstanceCenter", GLT_ATTRIBUTE_INSTANCE_EXTENT, "vInstanceExtent",
+                                                                GLT_ATTRIBUTE_INSTANCE_COLOR, "vInstanceColor");
+
+    compiler.Finish();
+    for(int shader = GLT_SHADER_IDENTITY; shader < GLT_SHADER_LAST; shader++)
+        uiStockShaders[shader] = compiler.GetProgram(iHandles[shader]);
+
     // if any shader failed to build, return false
     for(int shader = GLT_SHADER_IDENTITY; shader < GLT_SHADER_LAST; shader++)
         if(uiStockShaders[shader] == 0)
             return false;
 
+    // Look up the uniforms once, here, instead of on every draw. Uniforms
+    // a shader doesn't have come back as -1, which glUniform* ignores.
+    for(int shader = GLT_SHADER_IDENTITY; shader < GLT_SHADER_LAST; shader++)
+        for(int uniform = 0; uniform < GLT_UNIFORM_LAST; uniform++)
+            iStockUniforms[shader][uniform] = glGetUniformLocation(uiStockShaders[shader], szStockUniformNames[uniform]);
+
+    // Point every shader's blocks at the shared binding points
+    for(int shader = GLT_SHADER_IDENTITY; shader < GLT_SHADER_LAST; shader++) {
+        GLuint iBlock = glGetUniformBlockIndex(uiStockShaders[shader], "GLTFrame");
+        if(iBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(uiStockShaders[shader], iBlock, GLT_FRAME_BLOCK_BINDING);
+
+        iBlock = glGetUniformBlockIndex(uiStockShaders[shader], "GLTObjects");
+        if(iBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(uiStockShaders[shader], iBlock, GLT_OBJECT_BLOCK_BINDING);
+        }
+
+    // Ranges of the object buffer have to start on the right boundary
+    GLint nAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &nAlignment);
+    GLsizeiptr nWindowSize = sizeof(GLTObjectData) * GLT_BLOCK_OBJECTS;
+    nObjectWindowStride = ((nWindowSize + nAlignment - 1) / nAlignment) * nAlignment;
+
+    // Both blocks always have something behind them, even before the first
+    // frame. WebGL won't draw otherwise.
+    if(uiFrameBuffer == 0) {
+        glGenBuffers(1, &uiFrameBuffer);
+        glGenBuffers(1, &uiObjectBuffer);
+        }
+
+    memset(&frameData, 0, sizeof(GLTFrameData));
+    GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, uiFrameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GLTFrameData), &frameData, GL_DYNAMIC_DRAW);
+    GLStateCache::GetStateCache()->BindBufferBase(GL_UNIFORM_BUFFER, GLT_FRAME_BLOCK_BINDING, uiFrameBuffer);
+
+    GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, uiObjectBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, nObjectWindowStride, NULL, GL_DYNAMIC_DRAW);
+    GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, 0);
+    iObjectWindow = -1;
+    BindObjectWindow(0);
+
+    // New programs, nothing has been set yet
+    InvalidateUniformCache();
     return true;
     }
 
 
 ///////////////////////////////////////////////////////////////////////
-// Use a specific stock shader, and set the appropriate uniforms
+// Use a specific stock shader, and set the appropriate uniforms. The
+// uniform locations were all looked up in InitializeStockShaders(), and
+// values that are already there are skipped.
 GLint GLShaderManager::UseStockShader(int nShaderID, ...)
     {
     // Check for out of bounds
-    if(nShaderID >= GLT_SHADER_LAST)
+    if(nShaderID < 0 || nShaderID >= GLT_SHADER_LAST)
         return -1;
 
     // List of uniforms
@@ -525,10 +546,9 @@ GLint GLShaderManager::UseStockShader(int nShaderID, ...)
     va_start(uniformList, nShaderID);
 
     // Bind to the correct shader
-    glUseProgram(uiStockShaders[nShaderID]);
+    BindStockShader(nShaderID);
 
     // Set up the uniforms
-    GLint iTransform, iModelMatrix, iProjMatrix, iColor, iLight, iTextureUnit;
     int				iInteger;
     M3DMatrix44f* mvpMatrix;
     M3DMatrix44f*  pMatrix;
@@ -540,97 +560,93 @@ GLint GLShaderManager::UseStockShader(int nShaderID, ...)
     switch(nShaderID)
         {
         case GLT_SHADER_FLAT:			// Just the modelview projection matrix and the color
-            iTransform = glGetUniformLocation(uiStockShaders[nShaderID], "mvpMatrix");
             mvpMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iTransform, 1, GL_FALSE, *mvpMatrix);
+            SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, *mvpMatrix);
 
-            iColor = glGetUniformLocation(uiStockShaders[nShaderID], "vColor");
             vColor = va_arg(uniformList, M3DVector4f*);
-            glUniform4fv(iColor, 1, *vColor);
+            SetUniform4(nShaderID, GLT_UNIFORM_COLOR, *vColor);
             break;
 
     case GLT_SHADER_TEXTURE_REPLACE:	// Just the texture place
-            iTransform = glGetUniformLocation(uiStockShaders[nShaderID], "mvpMatrix");
             mvpMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iTransform, 1, GL_FALSE, *mvpMatrix);
+            SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, *mvpMatrix);
 
-            iTextureUnit = glGetUniformLocation(uiStockShaders[nShaderID], "textureUnit0");
             iInteger = va_arg(uniformList, int);
-            glUniform1i(iTextureUnit, iInteger);
+            SetUniformInt(nShaderID, GLT_UNIFORM_TEXTURE_UNIT0, iInteger);
             break;
 
         case GLT_SHADER_TEXTURE_MODULATE: // Multiply the texture by the geometry color
-            iTransform = glGetUniformLocation(uiStockShaders[nShaderID], "mvpMatrix");
             mvpMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iTransform, 1, GL_FALSE, *mvpMatrix);
+            SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, *mvpMatrix);
 
-            iColor = glGetUniformLocation(uiStockShaders[nShaderID], "vColor");
             vColor = va_arg(uniformList, M3DVector4f*);
-            glUniform4fv(iColor, 1, *vColor);
+            SetUniform4(nShaderID, GLT_UNIFORM_COLOR, *vColor);
 
-            iTextureUnit = glGetUniformLocation(uiStockShaders[nShaderID], "textureUnit0");
             iInteger = va_arg(uniformList, int);
-            glUniform1i(iTextureUnit, iInteger);
+            SetUniformInt(nShaderID, GLT_UNIFORM_TEXTURE_UNIT0, iInteger);
             break;
 
         case GLT_SHADER_POINT_SPRITES:
-            iTransform = glGetUniformLocation(uiStockShaders[nShaderID], "mvpMatrix");
             mvpMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iTransform, 1, GL_FALSE, *mvpMatrix);
+            SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, *mvpMatrix);
 
-            iTextureUnit = glGetUniformLocation(uiStockShaders[nShaderID], "textureUnit0");
             iInteger = va_arg(uniformList, int);
-            glUniform1i(iTextureUnit, iInteger);
+            SetUniformInt(nShaderID, GLT_UNIFORM_TEXTURE_UNIT0, iInteger);
             break;
 
         case GLT_POINT_SPRITES_PLAIN:
-            iTransform = glGetUniformLocation(uiStockShaders[nShaderID], "mvpMatrix");
+        case GLT_SHADER_INSTANCED_BOX:  // Color comes with each instance
             mvpMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iTransform, 1, GL_FALSE, *mvpMatrix);
+            SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, *mvpMatrix);
             break;
 
         case GLT_SHADER_DEFAULT_LIGHT:
-            iModelMatrix = glGetUniformLocation(uiStockShaders[nShaderID], "mvMatrix");
             mvMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iModelMatrix, 1, GL_FALSE, *mvMatrix);
-
-            iProjMatrix = glGetUniformLocation(uiStockShaders[nShaderID], "pMatrix");
             pMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iProjMatrix, 1, GL_FALSE, *pMatrix);
+            SetFrameProjection(*pMatrix);
+            SetLightMatrices(nShaderID, *mvMatrix);
 
-            iColor = glGetUniformLocation(uiStockShaders[nShaderID], "vColor");
             vColor = va_arg(uniformList, M3DVector4f*);
-            glUniform4fv(iColor, 1, *vColor);
+            SetUniform4(nShaderID, GLT_UNIFORM_COLOR, *vColor);
             break;
 
         case GLT_SHADER_POINT_LIGHT_DIFF:
-            iModelMatrix = glGetUniformLocation(uiStockShaders[nShaderID], "mvMatrix");
             mvMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iModelMatrix, 1, GL_FALSE, *mvMatrix);
+            pMatrix = va_arg(uniformList, M3DMatrix44f*);
+            SetFrameProjection(*pMatrix);
+            SetLightMatrices(nShaderID, *mvMatrix);
+
+            vLightPos = va_arg(uniformList, M3DVector3f*);
+            SetFrameLight(*vLightPos);
+
+            vColor = va_arg(uniformList, M3DVector4f*);
+            SetUniform4(nShaderID, GLT_UNIFORM_COLOR, *vColor);
+            break;
 
-            iProjMatrix = glGetUniformLocation(uiStockShaders[nShaderID], "pMatrix");
+        case GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF:   // Same as above, plus the texture unit
+            mvMatrix = va_arg(uniformList, M3DMatrix44f*);
             pMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iProjMatrix, 1, GL_FALSE, *pMatrix);
+            SetFrameProjection(*pMatrix);
+            SetLightMatrices(nShaderID, *mvMatrix);
 
-            iLight = glGetUniformLocation(uiStockShaders[nShaderID], "vLightPos");
             vLightPos = va_arg(uniformList, M3DVector3f*);
-            glUniform3fv(iLight, 1, *vLightPos);
+            SetFrameLight(*vLightPos);
 
-            iColor = glGetUniformLocation(uiStockShaders[nShaderID], "vColor");
             vColor = va_arg(uniformList, M3DVector4f*);
-            glUniform4fv(iColor, 1, *vColor);
+            SetUniform4(nShaderID, GLT_UNIFORM_COLOR, *vColor);
+
+            iInteger = va_arg(uniformList, int);
+            SetUniformInt(nShaderID, GLT_UNIFORM_TEXTURE_UNIT0, iInteger);
             break;
 
         case GLT_SHADER_SHADED:		// Just the modelview projection matrix. Color is an attribute
-            iTransform = glGetUniformLocation(uiStockShaders[nShaderID], "mvpMatrix");
             pMatrix = va_arg(uniformList, M3DMatrix44f*);
-            glUniformMatrix4fv(iTransform, 1, GL_FALSE, *pMatrix);
+            SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, *pMatrix);
             break;
 
         case GLT_SHADER_IDENTITY:	// Just the Color
-            iColor = glGetUniformLocation(uiStockShaders[nShaderID], "vColor");
             vColor = va_arg(uniformList, M3DVector4f*);
-            glUniform4fv(iColor, 1, *vColor);
+            SetUniform4(nShaderID, GLT_UNIFORM_COLOR, *vColor);
         default:
             break;
         }
@@ -640,221 +656,767 @@ GLint GLShaderManager::UseStockShader(int nShaderID, ...)
     }
 
 
+///////////////////////////////////////////////////////////////////////
+// Forget every value we've sent, so the next ones all go through
+void GLShaderManager::InvalidateUniformCache(void)
+    {
+    for(unsigned int i = 0; i < GLT_SHADER_LAST; i++)
+        for(unsigned int u = 0; u < GLT_UNIFORM_LAST; u++)
+            uniformCache[i][u].bValid = false;
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// Compare against what this uniform was last set to, and remember the new
+// value. Uniforms the shader doesn't have never need setting.
+bool GLShaderManager::UniformChanged(int nShaderID, GLT_STOCK_UNIFORM uniform, const void *pValue, size_t nBytes)
+    {
+    if(iStockUniforms[nShaderID][uniform] == -1)
+        return false;
+
+    UNIFORMCACHE& cache = uniformCache[nShaderID][uniform];
+    if(cache.bValid && memcmp(cache.fValue, pValue, nBytes) == 0)
+        return false;
+
+    memcpy(cache.fValue, pValue, nBytes);
+    cache.bValid = true;
+    return true;
+    }
+
+void GLShaderManager::SetUniformMatrix(int nShaderID, GLT_STOCK_UNIFORM uniform, const GLfloat *pMatrix)
+    {
+    if(pMatrix != NULL && UniformChanged(nShaderID, uniform, pMatrix, sizeof(GLfloat) * 16))
+        glUniformMatrix4fv(iStockUniforms[nShaderID][uniform], 1, GL_FALSE, pMatrix);
+    }
+
+void GLShaderManager::SetUniformMatrix3(int nShaderID, GLT_STOCK_UNIFORM uniform, const GLfloat *pMatrix)
+    {
+    if(pMatrix != NULL && UniformChanged(nShaderID, uniform, pMatrix, sizeof(GLfloat) * 9))
+        glUniformMatrix3fv(iStockUniforms[nShaderID][uniform], 1, GL_FALSE, pMatrix);
+    }
+
+void GLShaderManager::SetUniform4(int nShaderID, GLT_STOCK_UNIFORM uniform, const GLfloat *pVector)
+    {
+    if(pVector != NULL && UniformChanged(nShaderID, uniform, pVector, sizeof(GLfloat) * 4))
+        glUniform4fv(iStockUniforms[nShaderID][uniform], 1, pVector);
+    }
+
+void GLShaderManager::SetUniformInt(int nShaderID, GLT_STOCK_UNIFORM uniform, GLint iValue)
+    {
+    if(UniformChanged(nShaderID, uniform, &iValue, sizeof(GLint)))
+        glUniform1i(iStockUniforms[nShaderID][uniform], iValue);
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// The lighting shaders don't rebuild these for every vertex. Work them out
+// once here, from the modelview and the projection in the frame block. Only
+// the point lights still need the modelview itself, for the light direction.
+void GLShaderManager::SetLightMatrices(int nShaderID, const GLfloat *mvMatrix)
+    {
+    if(mvMatrix == NULL)
+        return;
+
+    const M3DMatrix44f& mModelView = *reinterpret_cast<const M3DMatrix44f*>(mvMatrix);
+    SetUniformMatrix(nShaderID, GLT_UNIFORM_MV_MATRIX, mModelView);
+
+    M3DMatrix44f mvpMatrix;
+    m3dMatrixMultiply44(mvpMatrix, frameData.pMatrix, mModelView);
+    SetUniformMatrix(nShaderID, GLT_UNIFORM_MVP_MATRIX, mvpMatrix);
+
+    M3DMatrix33f mNormal;
+    gltComputeNormalMatrix(mNormal, mModelView);
+    SetUniformMatrix3(nShaderID, GLT_UNIFORM_NORMAL_MATRIX, mNormal);
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// Make a stock shader current, taking its per-object values from the
+// plain uniforms rather than the object block
+GLuint GLShaderManager::BindStockShader(int nShaderID)
+    {
+    GLStateCache::GetStateCache()->UseProgram(uiStockShaders[nShaderID]);
+    SetUniformInt(nShaderID, GLT_UNIFORM_OBJECT, -1);
+    return uiStockShaders[nShaderID];
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// The frame block is shared by every stock shader, so it only needs
+// updating when the values actually change, no matter which shader is used.
+void GLShaderManager::SetFrame(const GLTFrameData& frame)
+    {
+    if(memcmp(&frame, &frameData, sizeof(GLTFrameData)) != 0) {
+        memcpy(&frameData, &frame, sizeof(GLTFrameData));
+        GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, uiFrameBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GLTFrameData), &frameData);
+        }
+
+    // In case anyone else has used these binding points
+    GLStateCache::GetStateCache()->BindBufferBase(GL_UNIFORM_BUFFER, GLT_FRAME_BLOCK_BINDING, uiFrameBuffer);
+    GLint iWindow = iObjectWindow;
+    iObjectWindow = -1;
+    BindObjectWindow(iWindow < 0 ? 0 : iWindow);
+    }
+
+void GLShaderManager::SetFrameProjection(const GLfloat *pMatrix)
+    {
+    if(pMatrix == NULL || memcmp(pMatrix, frameData.pMatrix, sizeof(M3DMatrix44f)) == 0)
+        return;
+
+    memcpy(frameData.pMatrix, pMatrix, sizeof(M3DMatrix44f));
+    GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, uiFrameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offsetof(GLTFrameData, pMatrix), sizeof(M3DMatrix44f), frameData.pMatrix);
+    }
+
+void GLShaderManager::SetFrameLight(const GLfloat *vLightPos)
+    {
+    if(vLightPos == NULL || memcmp(vLightPos, frameData.vLightPos, sizeof(M3DVector3f)) == 0)
+        return;
+
+    memcpy(frameData.vLightPos, vLightPos, sizeof(M3DVector3f));
+    frameData.vLightPos[3] = 1.0f;
+    GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, uiFrameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offsetof(GLTFrameData, vLightPos), sizeof(M3DVector4f), frameData.vLightPos);
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// The object block only sees GLT_BLOCK_OBJECTS at a time, so the buffer is
+// split into windows of that many, and the right one is bound as needed.
+void GLShaderManager::SetObjects(const GLTObjectData *pObjects, GLsizei nObjects)
+    {
+    GLsizei nWindows = (nObjects + GLT_BLOCK_OBJECTS - 1) / GLT_BLOCK_OBJECTS;
+    if(nWindows < 1)
+        nWindows = 1;
+
+    // Orphan the old contents; the last pass may still be drawing from them
+    GLStateCache::GetStateCache()->BindBuffer(GL_UNIFORM_BUFFER, uiObjectBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, nObjectWindowStride * nWindows, NULL, GL_DYNAMIC_DRAW);
+    for(GLsizei w = 0; w < nWindows && pObjects != NULL; w++) {
+        GLsizei nCount = nObjects - w * GLT_BLOCK_OBJECTS;
+        if(nCount > GLT_BLOCK_OBJECTS)
+            nCount = GLT_BLOCK_OBJECTS;
+        if(nCount > 0)
+            glBufferSubData(GL_UNIFORM_BUFFER, nObjectWindowStride * w, sizeof(GLTObjectData) * nCount,
+                            pObjects + w * GLT_BLOCK_OBJECTS);
+        }
+
+    iObjectWindow = -1;
+    BindObjectWindow(0);
+    }
+
+void GLShaderManager::BindObjectWindow(GLint iWindow)
+    {
+    if(iWindow == iObjectWindow)
+        return;
+
+    GLStateCache::GetStateCache()->BindBufferRange(GL_UNIFORM_BUFFER, GLT_OBJECT_BLOCK_BINDING, uiObjectBuffer,
+                                        nObjectWindowStride * iWindow, sizeof(GLTObjectData) * GLT_BLOCK_OBJECTS);
+    iObjectWindow = iWindow;
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// std140 pads each column of a mat3 out to a vec4
+void GLShaderManager::MakeObjectData(GLTObjectData& object, const M3DMatrix44f mvMatrix,
+                                     const M3DMatrix44f pMatrix, const M3DVector4f vColor)
+    {
+    memcpy(object.mvMatrix, mvMatrix, sizeof(M3DMatrix44f));
+    m3dMatrixMultiply44(object.mvpMatrix, pMatrix, mvMatrix);
+
+    M3DMatrix33f mNormal;
+    gltComputeNormalMatrix(mNormal, *reinterpret_cast<const M3DMatrix44f*>(mvMatrix));
+    for(int i = 0; i < 3; i++) {
+        memcpy(&object.normalMatrix[i * 4], &mNormal[i * 3], sizeof(GLfloat) * 3);
+        object.normalMatrix[i * 4 + 3] = 0.0f;
+        }
+
+    memcpy(object.vColor, vColor, sizeof(M3DVector4f));
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// Use a stock shader with one of the objects from SetObjects(). The
+// shaders without per-object values (identity, point sprites, instanced
+// boxes) ignore it. Textured shaders sample iTextureUnit.
+GLuint GLShaderManager::UseObject(int nShaderID, GLint iObject, GLint iTextureUnit)
+    {
+    if(nShaderID < 0 || nShaderID >= GLT_SHADER_LAST || iObject < 0)
+        return 0;
+
+    GLStateCache::GetStateCache()->UseProgram(uiStockShaders[nShaderID]);
+    BindObjectWindow(iObject / GLT_BLOCK_OBJECTS);
+    SetUniformInt(nShaderID, GLT_UNIFORM_OBJECT, iObject % GLT_BLOCK_OBJECTS);
+    SetUniformInt(nShaderID, GLT_UNIFORM_TEXTURE_UNIT0, iTextureUnit);
+    return uiStockShaders[nShaderID];
+    }
+
+
+///////////////////////////////////////////////////////////////////////
+// Typed versions of UseStockShader()
+GLuint GLShaderManager::Use(const IdentityParams& params)
+    {
+    BindStockShader(GLT_SHADER_IDENTITY);
+    SetUniform4(GLT_SHADER_IDENTITY, GLT_UNIFORM_COLOR, params.vColor);
+    return uiStockShaders[GLT_SHADER_IDENTITY];
+    }
+
+GLuint GLShaderManager::Use(const FlatParams& params)
+    {
+    BindStockShader(GLT_SHADER_FLAT);
+    SetUniformMatrix(GLT_SHADER_FLAT, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    SetUniform4(GLT_SHADER_FLAT, GLT_UNIFORM_COLOR, params.vColor);
+    return uiStockShaders[GLT_SHADER_FLAT];
+    }
+
+GLuint GLShaderManager::Use(const ShadedParams& params)
+    {
+    BindStockShader(GLT_SHADER_SHADED);
+    SetUniformMatrix(GLT_SHADER_SHADED, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    return uiStockShaders[GLT_SHADER_SHADED];
+    }
+
+GLuint GLShaderManager::Use(const DefaultLightParams& params)
+    {
+    BindStockShader(GLT_SHADER_DEFAULT_LIGHT);
+    SetFrameProjection(params.pMatrix);
+    SetLightMatrices(GLT_SHADER_DEFAULT_LIGHT, params.mvMatrix);
+    SetUniform4(GLT_SHADER_DEFAULT_LIGHT, GLT_UNIFORM_COLOR, params.vColor);
+    return uiStockShaders[GLT_SHADER_DEFAULT_LIGHT];
+    }
+
+GLuint GLShaderManager::Use(const PointLightParams& params)
+    {
+    BindStockShader(GLT_SHADER_POINT_LIGHT_DIFF);
+    SetFrameProjection(params.pMatrix);
+    SetLightMatrices(GLT_SHADER_POINT_LIGHT_DIFF, params.mvMatrix);
+    SetFrameLight(params.vLightPos);
+    SetUniform4(GLT_SHADER_POINT_LIGHT_DIFF, GLT_UNIFORM_COLOR, params.vColor);
+    return uiStockShaders[GLT_SHADER_POINT_LIGHT_DIFF];
+    }
+
+GLuint GLShaderManager::Use(const TextureReplaceParams& params)
+    {
+    BindStockShader(GLT_SHADER_TEXTURE_REPLACE);
+    SetUniformMatrix(GLT_SHADER_TEXTURE_REPLACE, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    SetUniformInt(GLT_SHADER_TEXTURE_REPLACE, GLT_UNIFORM_TEXTURE_UNIT0, params.iTextureUnit);
+    return uiStockShaders[GLT_SHADER_TEXTURE_REPLACE];
+    }
+
+GLuint GLShaderManager::Use(const TextureModulateParams& params)
+    {
+    BindStockShader(GLT_SHADER_TEXTURE_MODULATE);
+    SetUniformMatrix(GLT_SHADER_TEXTURE_MODULATE, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    SetUniform4(GLT_SHADER_TEXTURE_MODULATE, GLT_UNIFORM_COLOR, params.vColor);
+    SetUniformInt(GLT_SHADER_TEXTURE_MODULATE, GLT_UNIFORM_TEXTURE_UNIT0, params.iTextureUnit);
+    return uiStockShaders[GLT_SHADER_TEXTURE_MODULATE];
+    }
+
+GLuint GLShaderManager::Use(const TexturePointLightParams& params)
+    {
+    BindStockShader(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF);
+    SetFrameProjection(params.pMatrix);
+    SetLightMatrices(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF, params.mvMatrix);
+    SetFrameLight(params.vLightPos);
+    SetUniform4(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF, GLT_UNIFORM_COLOR, params.vColor);
+    SetUniformInt(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF, GLT_UNIFORM_TEXTURE_UNIT0, params.iTextureUnit);
+    return uiStockShaders[GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF];
+    }
+
+GLuint GLShaderManager::Use(const PointSpriteParams& params)
+    {
+    BindStockShader(GLT_SHADER_POINT_SPRITES);
+    SetUniformMatrix(GLT_SHADER_POINT_SPRITES, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    SetUniformInt(GLT_SHADER_POINT_SPRITES, GLT_UNIFORM_TEXTURE_UNIT0, params.iTextureUnit);
+    return uiStockShaders[GLT_SHADER_POINT_SPRITES];
+    }
+
+GLuint GLShaderManager::Use(const PointSpritePlainParams& params)
+    {
+    BindStockShader(GLT_POINT_SPRITES_PLAIN);
+    SetUniformMatrix(GLT_POINT_SPRITES_PLAIN, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    return uiStockShaders[GLT_POINT_SPRITES_PLAIN];
+    }
+
+GLuint GLShaderManager::Use(const InstancedBoxParams& params)
+    {
+    BindStockShader(GLT_SHADER_INSTANCED_BOX);
+    SetUniformMatrix(GLT_SHADER_INSTANCED_BOX, GLT_UNIFORM_MVP_MATRIX, params.mvpMatrix);
+    return uiStockShaders[GLT_SHADER_INSTANCED_BOX];
+    }
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Load a shader pair from file. The shader pair root is added to the shader
 // lookup table and can be found again if necessary with LookupShader.
 GLuint GLShaderManager::LoadShaderPair(const char *szVertexProgFileName, const char *szFragProgFileName)
     {
-    SHADERLOOKUPENTRY shaderEntry;
-
-    // Load shader and test for fail
-    shaderEntry.uiShaderID = GLTools::GetGLTools()->gltLoadShaderPair(szVertexProgFileName, szFragProgFileName);
-    if(shaderEntry.uiShaderID == 0)
-        return 0;
-
-    // Add to the table
-    strncpy(shaderEntry.szVertexShaderName, szVertexProgFileName, MAX_SHADER_NAME_LENGTH);
-    strncpy(shaderEntry.szFragShaderName, szFragProgFileName, MAX_SHADER_NAME_LENGTH);
-//	shaderTable.push_back(shaderEntry);
-    return shaderEntry.uiShaderID;
+    return LoadShaderPairWithAttributes(szVertexProgFileName, szFragProgFileName, 0);
     }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Load shaders from source text. If the szName is NULL, just make it and return the handle
-// (useful for stock shaders). Otherwize, make sure it's not already there, then add to list
+// (useful for stock shaders). Otherwize, use the one already there, or add it to the list
 GLuint GLShaderManager::LoadShaderPairSrc(const char *szName, const char *szVertexSrc, const char *szFragSrc)
     {
     // Just make it and return
     if(szName == NULL)
         return GLTools::GetGLTools()->gltLoadShaderPairSrc(szVertexSrc, szFragSrc);
 
-
-    // Ok, make it and add to table
-    SHADERLOOKUPENTRY shaderEntry;
-    shaderEntry.uiShaderID = GLTools::GetGLTools()->gltLoadShaderPairSrc(szVertexSrc, szFragSrc);
-    if(shaderEntry.uiShaderID == 0)
-        return 0;	// Game over, won't compile
-
-    // Add it...
-    strncpy(shaderEntry.szVertexShaderName, szName, MAX_SHADER_NAME_LENGTH);
-    strncpy(shaderEntry.szFragShaderName, szName, MAX_SHADER_NAME_LENGTH);
-//	shaderTable.push_back(shaderEntry);
-    return shaderEntry.uiShaderID;
+    return RegisterShader(szName, szName, szVertexSrc, szFragSrc, 0, NULL, NULL);
     }
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
-// Load the shader file, with the supplied named attributes
+// Load the shader file, with the supplied named attributes. The files are read either
+// way, so an edited file isn't mistaken for the one already loaded.
 GLuint GLShaderManager::LoadShaderPairWithAttributes(const char *szVertexProgFileName, const char *szFragmentProgFileName, ...)
     {
-    SHADERLOOKUPENTRY shaderEntry;
-
-    // Temporary Shader objects
-    GLuint hVertexShader;
-    GLuint hFragmentShader;
-    GLint testVal;
+    GLint iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+    const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
 
-    // Create shader objects
-    hVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    // List of attributes
+    va_list attributeList;
+    va_start(attributeList, szFragmentProgFileName);
+    GLint nAttributes = gltGetShaderAttributes(attributeList, iIndexes, szNames);
+    va_end(attributeList);
 
-    // Load them. If fail clean up and return null
-    if(GLTools::GetGLTools()->gltLoadShaderFile(szVertexProgFileName, hVertexShader) == false)
-        {
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
+    std::string strVertexSrc, strFragmentSrc;
+    if(!GLTools::GetGLTools()->gltReadShaderFile(szVertexProgFileName, strVertexSrc)) {
+        LOG_ERROR("GLShaderManager: The shader at %s could not be found.\n", szVertexProgFileName);
         return 0;
         }
 
-    if(GLTools::GetGLTools()->gltLoadShaderFile(szFragmentProgFileName, hFragmentShader) == false)
-        {
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
+    if(!GLTools::GetGLTools()->gltReadShaderFile(szFragmentProgFileName, strFragmentSrc)) {
+        LOG_ERROR("GLShaderManager: The shader at %s could not be found.\n", szFragmentProgFileName);
         return 0;
         }
 
-    // Compile them
-    glCompileShader(hVertexShader);
-    glCompileShader(hFragmentShader);
-
-    // Check for errors
-    glGetShaderiv(hVertexShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-        {
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return 0;
-        }
-
-    glGetShaderiv(hFragmentShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-        {
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return 0;
-        }
+    return RegisterShader(szVertexProgFileName, szFragmentProgFileName, strVertexSrc.c_str(), strFragmentSrc.c_str(),
+                          nAttributes, iIndexes, szNames, true);
+    }
 
-    // Link them - assuming it works...
-    shaderEntry.uiShaderID = glCreateProgram();
-    glAttachShader(shaderEntry.uiShaderID, hVertexShader);
-    glAttachShader(shaderEntry.uiShaderID, hFragmentShader);
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Load the shader from source, with the supplied named attributes
+GLuint GLShaderManager::LoadShaderPairSrcWithAttributes(const char *szName, const char *szVertexProg, const char *szFragmentProg, ...)
+    {
+    GLint iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+    const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
 
     // List of attributes
     va_list attributeList;
-    va_start(attributeList, szFragmentProgFileName);
+    va_start(attributeList, szFragmentProg);
+    GLint nAttributes = gltGetShaderAttributes(attributeList, iIndexes, szNames);
+    va_end(attributeList);
 
-    char *szNextArg;
-    int iArgCount = va_arg(attributeList, int);	// Number of attributes
-    for(int i = 0; i < iArgCount; i++)
-        {
-        int index = va_arg(attributeList, int);
-        szNextArg = va_arg(attributeList, char*);
-        glBindAttribLocation(shaderEntry.uiShaderID, index, szNextArg);
+    if(szName == NULL)
+        return GLTools::GetGLTools()->gltBuildProgram(szVertexProg, szFragmentProg, nAttributes, iIndexes, szNames);
+
+    return RegisterShader(szName, szName, szVertexProg, szFragmentProg, nAttributes, iIndexes, szNames);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Where a program lives in the table. The terminators are hashed too, so
+// text can't slide from one string into the next and still match.
+static uint64_t gltShaderTableKey(const char *szVertexName, const char *szFragName, const char *szVertexSrc,
+                                  const char *szFragSrc, GLint nAttributes, const GLint *pIndexes, const char * const *pNames)
+    {
+    uint64_t key = gltHashBytes(szVertexName, strlen(szVertexName) + 1);
+    key = gltHashBytes(szFragName, strlen(szFragName) + 1, key);
+    key = gltHashBytes(szVertexSrc, strlen(szVertexSrc) + 1, key);
+    key = gltHashBytes(szFragSrc, strlen(szFragSrc) + 1, key);
+    for(GLint i = 0; i < nAttributes; i++) {
+        key = gltHashBytes(&pIndexes[i], sizeof(GLint), key);
+        key = gltHashBytes(pNames[i], strlen(pNames[i]) + 1, key);
         }
 
-    va_end(attributeList);
+    return key;
+    }
 
-    glLinkProgram(shaderEntry.uiShaderID);
+// Names as the table keeps them, both together, for shaderNames
+static std::string gltShaderNameKey(const char *szVertexName, const char *szFragName)
+    {
+    std::string strKey(szVertexName, strnlen(szVertexName, MAX_SHADER_NAME_LENGTH-1));
+    strKey += '\0';
+    strKey.append(szFragName, strnlen(szFragName, MAX_SHADER_NAME_LENGTH-1));
+    return strKey;
+    }
 
-    // These are no longer needed
-    glDeleteShader(hVertexShader);
-    glDeleteShader(hFragmentShader);
+// The entry's program, or one a reload replaced that someone still holds
+static bool gltEntryHasProgram(const SHADERLOOKUPENTRY& entry, GLuint uiShader)
+    {
+    if(entry.uiShaderID == uiShader)
+        return true;
+    return std::find(entry.oldPrograms.begin(), entry.oldPrograms.end(), uiShader) != entry.oldPrograms.end();
+    }
 
-    // Make sure link worked too
-    glGetProgramiv(shaderEntry.uiShaderID, GL_LINK_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-        {
-        glDeleteProgram(shaderEntry.uiShaderID);
-        return 0;
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Return the program already made from exactly these, or make it and add it
+// to the table. Programs from files remember the files, to reload them.
+GLuint GLShaderManager::RegisterShader(const char *szVertexName, const char *szFragName, const char *szVertexSrc,
+                                       const char *szFragSrc, GLint nAttributes, const GLint *pIndexes, const char * const *pNames,
+                                       bool bFiles)
+    {
+    uint64_t key = gltShaderTableKey(szVertexName, szFragName, szVertexSrc, szFragSrc, nAttributes, pIndexes, pNames);
+
+    std::unordered_map<uint64_t, SHADERLOOKUPENTRY>::iterator it = shaderTable.find(key);
+    if(it != shaderTable.end()) {
+        it->second.nReferences++;
+        shaderNames[gltShaderNameKey(szVertexName, szFragName)] = key;
+        return it->second.uiShaderID;
         }
 
+    SHADERLOOKUPENTRY shaderEntry;
+    shaderEntry.uiShaderID = GLTools::GetGLTools()->gltBuildProgram(szVertexSrc, szFragSrc, nAttributes, pIndexes, pNames,
+                                                                    szVertexName, szFragName);
+    if(shaderEntry.uiShaderID == 0)
+        return 0;	// Game over, won't compile
 
     // Add it...
-    strncpy(shaderEntry.szVertexShaderName, szVertexProgFileName, MAX_SHADER_NAME_LENGTH);
-    strncpy(shaderEntry.szFragShaderName, szFragmentProgFileName, MAX_SHADER_NAME_LENGTH);
-//	shaderTable.push_back(shaderEntry);
+    strncpy(shaderEntry.szVertexShaderName, szVertexName, MAX_SHADER_NAME_LENGTH);
+    shaderEntry.szVertexShaderName[MAX_SHADER_NAME_LENGTH-1] = '\0';
+    strncpy(shaderEntry.szFragShaderName, szFragName, MAX_SHADER_NAME_LENGTH);
+    shaderEntry.szFragShaderName[MAX_SHADER_NAME_LENGTH-1] = '\0';
+    shaderEntry.nReferences = 1;
+    shaderEntry.iReload = -1;
+    shaderEntry.reloadKey = 0;
+    shaderEntry.bReloadAgain = false;
+
+    if(bFiles) {
+        shaderEntry.strVertexFile = szVertexName;
+        shaderEntry.strFragFile = szFragName;
+        shaderEntry.attributeIndexes.assign(pIndexes, pIndexes + nAttributes);
+        shaderEntry.attributeNames.assign(pNames, pNames + nAttributes);
+        if(iWatchFile >= 0)
+            WatchEntry(shaderEntry);
+        }
+
+    // The same names with other source keep their program for whoever holds
+    // it, but LookupShader() finds the latest
+    shaderTable[key] = shaderEntry;
+    shaderNames[gltShaderNameKey(szVertexName, szFragName)] = key;
     return shaderEntry.uiShaderID;
     }
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
-// Load the shader from source, with the supplied named attributes
-GLuint GLShaderManager::LoadShaderPairSrcWithAttributes(const char *szName, const char *szVertexProg, const char *szFragmentProg, ...)
+// The last one out deletes the program
+void GLShaderManager::ReleaseShader(GLuint uiShader)
     {
-    SHADERLOOKUPENTRY shaderEntry;
+    // The handle may be one a reload replaced
+    std::unordered_map<uint64_t, SHADERLOOKUPENTRY>::iterator it;
+    for(it = shaderTable.begin(); it != shaderTable.end(); ++it)
+        if(gltEntryHasProgram(it->second, uiShader))
+            break;
 
-    // Temporary Shader objects
-    GLuint hVertexShader;
-    GLuint hFragmentShader;
-    GLint testVal;
+    if(it == shaderTable.end() || --it->second.nReferences > 0)
+        return;
+
+    // If these names found this one, let them find another with the same names
+    std::string strNames = gltShaderNameKey(it->second.szVertexShaderName, it->second.szFragShaderName);
+    uint64_t key = it->first;
+    GLStateCache::GetStateCache()->DeleteProgram(it->second.uiShaderID);
+    for(size_t i = 0; i < it->second.oldPrograms.size(); i++)
+        GLStateCache::GetStateCache()->DeleteProgram(it->second.oldPrograms[i]);
+    shaderTable.erase(it);
+
+    std::unordered_map<std::string, uint64_t>::iterator name = shaderNames.find(strNames);
+    if(name == shaderNames.end() || name->second != key)
+        return;
+
+    shaderNames.erase(name);
+    for(it = shaderTable.begin(); it != shaderTable.end(); ++it)
+        if(gltShaderNameKey(it->second.szVertexShaderName, it->second.szFragShaderName) == strNames) {
+            shaderNames[strNames] = it->first;
+            break;
+            }
+    }
 
-    // Create shader objects
-    hVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+GLuint GLShaderManager::LookupShader(const char *szVertexProg, const char *szFragProg)
+    {
+    if(szFragProg == NULL)
+        szFragProg = szVertexProg;
 
-    // Load them.
-    GLTools::GetGLTools()->gltLoadShaderSrc(szVertexProg, hVertexShader);
-    GLTools::GetGLTools()->gltLoadShaderSrc(szFragmentProg, hFragmentShader);
+    // Names longer than the table keeps only have to match as far as it goes
+    std::unordered_map<std::string, uint64_t>::iterator name = shaderNames.find(gltShaderNameKey(szVertexProg, szFragProg));
+    if(name == shaderNames.end())
+        return 0;
 
-    // Compile them
-    glCompileShader(hVertexShader);
-    glCompileShader(hFragmentShader);
+    return shaderTable[name->second].uiShaderID;
+    }
 
-    // Check for errors
-    glGetShaderiv(hVertexShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-        {
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Uniform locations for loaded programs, kept with them in the table
+GLint GLShaderManager::GetUniformLocation(GLuint uiShader, const char *szUniform)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    std::unordered_map<uint64_t, SHADERLOOKUPENTRY>::iterator it;
+    for(it = shaderTable.begin(); it != shaderTable.end(); ++it)
+        if(it->second.uiShaderID == uiShader)
+            break;
+
+    if(it == shaderTable.end())
+        return glGetUniformLocation(uiShader, szUniform);
+
+    std::unordered_map<std::string, GLint>::iterator uniform = it->second.uniforms.find(szUniform);
+    if(uniform != it->second.uniforms.end())
+        return uniform->second;
+
+    GLint iLocation = glGetUniformLocation(uiShader, szUniform);
+    it->second.uniforms[szUniform] = iLocation;
+    return iLocation;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Hot reloading. Editors often save by writing a new file and renaming it over
+// the old one, so it's the directories that are watched, not the files.
+static std::string gltWatchDirectory(const std::string& strFile)
+    {
+    size_t iSlash = strFile.find_last_of('/');
+    if(iSlash == std::string::npos)
+        return ".";
+    if(iSlash == 0)
+        return "/";
+    return strFile.substr(0, iSlash);
+    }
+
+// The file as it will come back from the watch, to compare with
+static std::string gltWatchPath(const std::string& strFile)
+    {
+    size_t iSlash = strFile.find_last_of('/');
+    std::string strName = (iSlash == std::string::npos) ? strFile : strFile.substr(iSlash + 1);
+    return gltWatchDirectory(strFile) + "/" + strName;
+    }
+
+bool GLShaderManager::WatchShaderFiles(bool bWatch)
+    {
+#ifdef __linux__
+    if(!bWatch) {
+        if(iWatchFile >= 0)
+            close(iWatchFile);
+        iWatchFile = -1;
+        watchDirectories.clear();
+        return true;
         }
 
-    glGetShaderiv(hFragmentShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-        {
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return 0;
+    if(iWatchFile < 0) {
+        iWatchFile = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(iWatchFile < 0)
+            return false;
         }
 
-    // Link them - assuming it works...
-    shaderEntry.uiShaderID = glCreateProgram();
-    glAttachShader(shaderEntry.uiShaderID, hVertexShader);
-    glAttachShader(shaderEntry.uiShaderID, hFragmentShader);
+    std::unordered_map<uint64_t, SHADERLOOKUPENTRY>::iterator it;
+    for(it = shaderTable.begin(); it != shaderTable.end(); ++it)
+        WatchEntry(it->second);
+    return true;
+#else
+    return !bWatch;
+#endif
+    }
 
-    // List of attributes
-    va_list attributeList;
-    va_start(attributeList, szFragmentProg);
+void GLShaderManager::WatchEntry(const SHADERLOOKUPENTRY& entry)
+    {
+#ifdef __linux__
+    const std::string *pFiles[2] = { &entry.strVertexFile, &entry.strFragFile };
+    for(int i = 0; i < 2; i++) {
+        if(pFiles[i]->empty())
+            continue;
+
+        std::string strDirectory = gltWatchDirectory(*pFiles[i]);
+        int iWatch = inotify_add_watch(iWatchFile, strDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if(iWatch >= 0)
+            watchDirectories[iWatch] = strDirectory;
+        }
+#else
+    (void)entry;
+#endif
+    }
 
-    char *szNextArg;
-    int iArgCount = va_arg(attributeList, int);	// Number of attributes
-    for(int i = 0; i < iArgCount; i++)
-        {
-        int index = va_arg(attributeList, int);
-        szNextArg = va_arg(attributeList, char*);
-        glBindAttribLocation(shaderEntry.uiShaderID, index, szNextArg);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Nothing here waits on the driver, unless it can't compile in parallel; then
+// each call waits for one program at most.
+GLint GLShaderManager::UpdateShaders(void)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    std::vector<std::string> changed;
+
+#ifdef __linux__
+    if(iWatchFile >= 0) {
+        char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        ssize_t nRead;
+        while((nRead = read(iWatchFile, buffer, sizeof(buffer))) > 0) {
+            for(char *pEvent = buffer; pEvent < buffer + nRead; ) {
+                const struct inotify_event *pWatchEvent = (const struct inotify_event *)pEvent;
+                std::unordered_map<int, std::string>::iterator dir = watchDirectories.find(pWatchEvent->wd);
+                if(pWatchEvent->len > 0 && dir != watchDirectories.end())
+                    changed.push_back(dir->second + "/" + pWatchEvent->name);
+                pEvent += sizeof(struct inotify_event) + pWatchEvent->len;
+                }
+            }
         }
-    va_end(attributeList);
+#endif
 
+    if(changed.empty() && pReloadCompiler == NULL)
+        return 0;
 
-    glLinkProgram(shaderEntry.uiShaderID);
+    if(pReloadCompiler == NULL)
+        pReloadCompiler = new GLShaderCompiler;
+
+    // Start building everything that changed. Anything already building is
+    // built again once it's done, so the newest save is the one that sticks.
+    // A file that can't be read is probably halfway through being saved; the
+    // next event brings it back.
+    bool bStartWaiting = bReloadsWaiting;
+    bReloadsWaiting = false;
+    std::unordered_map<uint64_t, SHADERLOOKUPENTRY>::iterator it;
+    for(it = shaderTable.begin(); it != shaderTable.end() && (!changed.empty() || bStartWaiting); ++it) {
+        SHADERLOOKUPENTRY& entry = it->second;
+        if(entry.strVertexFile.empty())
+            continue;
+
+        if(!(entry.bReloadAgain && entry.iReload < 0) &&
+           std::find(changed.begin(), changed.end(), gltWatchPath(entry.strVertexFile)) == changed.end() &&
+           std::find(changed.begin(), changed.end(), gltWatchPath(entry.strFragFile)) == changed.end())
+            continue;
+
+        if(entry.iReload >= 0) {
+            entry.bReloadAgain = true;
+            continue;
+            }
+        entry.bReloadAgain = false;
+
+        std::string strVertexSrc, strFragmentSrc;
+        if(!GLTools::GetGLTools()->gltReadShaderFile(entry.strVertexFile.c_str(), strVertexSrc) ||
+           !GLTools::GetGLTools()->gltReadShaderFile(entry.strFragFile.c_str(), strFragmentSrc))
+            continue;
+
+        GLint nAttributes = (GLint)entry.attributeNames.size();
+        const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
+        for(GLint i = 0; i < nAttributes; i++)
+            szNames[i] = entry.attributeNames[i].c_str();
+
+        entry.iReload = pReloadCompiler->Add(strVertexSrc.c_str(), strFragmentSrc.c_str(), nAttributes,
+                                             entry.attributeIndexes.data(), szNames, entry.szVertexShaderName);
+        entry.reloadKey = gltShaderTableKey(entry.strVertexFile.c_str(), entry.strFragFile.c_str(), strVertexSrc.c_str(),
+                                            strFragmentSrc.c_str(), nAttributes, entry.attributeIndexes.data(), szNames);
+        }
 
-    // These are no longer needed
-    glDeleteShader(hVertexShader);
-    glDeleteShader(hFragmentShader);
+    pReloadCompiler->Submit();
+    pReloadCompiler->Poll();
+
+    // Swap in whatever linked. Its key changes with its source, so it's
+    // found again by the next load of the same files.
+    std::vector<uint64_t> moved;
+    GLint nSwapped = 0;
+    bool bBuilding = false;
+    for(it = shaderTable.begin(); it != shaderTable.end(); ++it) {
+        SHADERLOOKUPENTRY& entry = it->second;
+        if(entry.iReload < 0)
+            continue;
+
+        GLT_PROGRAM_STATUS status = pReloadCompiler->GetStatus(entry.iReload);
+        if(status == GLT_PROGRAM_READY) {
+            SwapProgram(entry, pReloadCompiler->GetProgram(entry.iReload));
+            if(entry.reloadKey != it->first)
+                moved.push_back(it->first);
+            nSwapped++;
+            }
+        else if(status != GLT_PROGRAM_FAILED) {
+            bBuilding = true;
+            continue;
+            }
+
+        entry.iReload = -1;
+        if(entry.bReloadAgain)
+            bReloadsWaiting = true;
+        }
 
-    // Make sure link worked too
-    glGetProgramiv(shaderEntry.uiShaderID, GL_LINK_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-        {
-        glDeleteProgram(shaderEntry.uiShaderID);
-        return 0;
+    // Out from under the old key, so loading the old source builds it afresh.
+    // If the new source is already loaded under the same names, the two become
+    // one entry, and its holders release this one's program through it.
+    for(size_t i = 0; i < moved.size(); i++) {
+        it = shaderTable.find(moved[i]);
+        SHADERLOOKUPENTRY entry = std::move(it->second);
+        shaderTable.erase(it);
+
+        uint64_t reloadKey = entry.reloadKey;
+        std::unordered_map<std::string, uint64_t>::iterator name =
+            shaderNames.find(gltShaderNameKey(entry.szVertexShaderName, entry.szFragShaderName));
+        if(name != shaderNames.end() && name->second == moved[i])
+            name->second = reloadKey;
+
+        it = shaderTable.find(reloadKey);
+        if(it == shaderTable.end()) {
+            shaderTable[reloadKey] = std::move(entry);
+            continue;
+            }
+
+        SHADERLOOKUPENTRY& loaded = it->second;
+        loaded.nReferences += entry.nReferences;
+        loaded.oldPrograms.push_back(entry.uiShaderID);
+        loaded.oldPrograms.insert(loaded.oldPrograms.end(), entry.oldPrograms.begin(), entry.oldPrograms.end());
+        if(entry.bReloadAgain)
+            loaded.bReloadAgain = true;
         }
 
-    // Add it...
-    strncpy(shaderEntry.szVertexShaderName, szName, MAX_SHADER_NAME_LENGTH);
-    strncpy(shaderEntry.szFragShaderName, szName, MAX_SHADER_NAME_LENGTH);
-//	shaderTable.push_back(shaderEntry);
-    return shaderEntry.uiShaderID;
+    // Handles are only good until the compiler is cleared
+    if(!bBuilding)
+        pReloadCompiler->Clear();
+
+    return nSwapped;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Put the new program behind the old handle, so nobody holding it has to know.
+// That takes a program binary. If the driver won't, the new handle replaces it,
+// and the old program stays alive for its holders until the entry is released.
+void GLShaderManager::SwapProgram(SHADERLOOKUPENTRY& entry, GLuint uiProgram)
+    {
+    bool bSwapped = false;
+
+#ifndef __EMSCRIPTEN__
+    GLint nFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+
+    GLint nLength = 0;
+    if(nFormats > 0)
+        glGetProgramiv(uiProgram, GL_PROGRAM_BINARY_LENGTH, &nLength);
+
+    if(nLength > 0) {
+        std::vector<unsigned char> binary(nLength);
+        GLsizei nWritten = 0;
+        GLenum eFormat = 0;
+        glGetProgramBinary(uiProgram, nLength, &nWritten, &eFormat, binary.data());
+
+        GLint testVal = GL_FALSE;
+        if(nWritten > 0) {
+            glProgramBinary(entry.uiShaderID, eFormat, binary.data(), nWritten);
+            glGetProgramiv(entry.uiShaderID, GL_LINK_STATUS, &testVal);
+            }
+        bSwapped = (testVal != GL_FALSE);
+        }
+#endif
+
+    // Whoever holds the old handle still draws with it; ReleaseShader() knows it
+    if(bSwapped)
+        GLStateCache::GetStateCache()->DeleteProgram(uiProgram);
+    else {
+        entry.oldPrograms.push_back(entry.uiShaderID);
+        entry.uiShaderID = uiProgram;
+        }
+
+    std::unordered_map<std::string, GLint>::iterator uniform;
+    for(uniform = entry.uniforms.begin(); uniform != entry.uniforms.end(); ++uniform)
+        uniform->second = glGetUniformLocation(entry.uiShaderID, uniform->first.c_str());
     }
@@ -0,0 +1,167 @@
+/*
+GLShaderPreprocessor.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLShaderPreprocessor.h"
+#include "target.h"
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLShaderPreprocessor::GLShaderPreprocessor(void)
+    {
+    strVersion = GLT_SHADER_VERSION;
+    szIncludeDirectory[0] = '\0';
+    }
+
+void GLShaderPreprocessor::AddInclude(const char *szName, const char *szSource)
+    {
+    includes[szName] = szSource;
+    }
+
+void GLShaderPreprocessor::SetIncludeDirectory(const char *szDirectory)
+    {
+    if(szDirectory == NULL) {
+        szIncludeDirectory[0] = '\0';
+        return;
+        }
+
+    strncpy(szIncludeDirectory, szDirectory, MAX_CACHE_PATH_LENGTH);
+    szIncludeDirectory[MAX_CACHE_PATH_LENGTH-1] = '\0';
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The version line, then the defines, then the source with its includes
+// pasted in. #version has to come before anything else but comments.
+bool GLShaderPreprocessor::Process(const char *szSource, const char *szDefines, std::string& strOut)
+    {
+    strOut.clear();
+    included.clear();
+
+    const char *pBody = szSource;
+    while(*pBody == ' ' || *pBody == '\t' || *pBody == '\r' || *pBody == '\n')
+        pBody++;
+
+    if(strncmp(pBody, "#version", 8) == 0) {
+        const char *pEnd = strchr(pBody, '\n');
+        pEnd = (pEnd == NULL) ? pBody + strlen(pBody) : pEnd + 1;
+        strOut.append(pBody, pEnd - pBody);
+        if(strOut[strOut.size() - 1] != '\n')
+            strOut += '\n';
+        pBody = pEnd;
+        }
+    else {
+        strOut = strVersion;
+        pBody = szSource;
+        }
+
+    // NAME=value becomes #define NAME value
+    const char *pDefine = (szDefines != NULL) ? szDefines : "";
+    while(*pDefine != '\0') {
+        size_t nLength = strcspn(pDefine, " \t");
+        if(nLength > 0) {
+            std::string strDefine(pDefine, nLength);
+            std::replace(strDefine.begin(), strDefine.end(), '=', ' ');
+            strOut += "#define ";
+            strOut += strDefine;
+            strOut += '\n';
+            }
+        pDefine += nLength;
+        pDefine += strspn(pDefine, " \t");
+        }
+
+    return Expand(pBody, strOut, 0);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy a line at a time, pasting in includes as they come up
+bool GLShaderPreprocessor::Expand(const char *szSource, std::string& strOut, int iDepth)
+    {
+    if(iDepth > GLT_MAX_INCLUDE_DEPTH) {
+        LOG_ERROR("GLShaderPreprocessor: Includes nest deeper than %d.\n", GLT_MAX_INCLUDE_DEPTH);
+        return false;
+        }
+
+    const char *pLine = szSource;
+    while(*pLine != '\0') {
+        const char *pEnd = strchr(pLine, '\n');
+        pEnd = (pEnd == NULL) ? pLine + strlen(pLine) : pEnd + 1;
+
+        const char *pDirective = pLine + strspn(pLine, " \t");
+        if(strncmp(pDirective, "#include", 8) != 0) {
+            strOut.append(pLine, pEnd - pLine);
+            pLine = pEnd;
+            continue;
+            }
+
+        // The name is between quotes or angle brackets
+        const char *pName = strpbrk(pDirective + 8, "\"<");
+        const char *pNameEnd = (pName != NULL) ? strpbrk(pName + 1, "\">\n") : NULL;
+        if(pNameEnd == NULL || *pNameEnd == '\n' || pNameEnd >= pEnd) {
+            LOG_ERROR("GLShaderPreprocessor: Can't read the name in %.*s\n", (int)(pEnd - pLine), pLine);
+            return false;
+            }
+
+        std::string strName(pName + 1, pNameEnd - pName - 1);
+        pLine = pEnd;
+        if(std::find(included.begin(), included.end(), strName) != included.end())
+            continue;
+
+        std::string strInclude;
+        if(!FindInclude(strName, strInclude)) {
+            LOG_ERROR("GLShaderPreprocessor: The include %s could not be found.\n", strName.c_str());
+            return false;
+            }
+
+        included.push_back(strName);
+        if(!Expand(strInclude.c_str(), strOut, iDepth + 1))
+            return false;
+        if(strOut.empty() || strOut[strOut.size() - 1] != '\n')
+            strOut += '\n';
+        }
+
+    return true;
+    }
+
+bool GLShaderPreprocessor::FindInclude(const std::string& strName, std::string& strSource)
+    {
+    std::unordered_map<std::string, std::string>::iterator it = includes.find(strName);
+    if(it != includes.end()) {
+        strSource = it->second;
+        return true;
+        }
+
+    if(szIncludeDirectory[0] == '\0')
+        return false;
+
+    std::string strPath = szIncludeDirectory;
+    strPath += '/';
+    strPath += strName;
+    return GLTools::GetGLTools()->gltReadShaderFile(strPath.c_str(), strSource);
+    }
@@ -0,0 +1,144 @@
+/*
+GLShaderVariants.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLShaderVariants.h"
+#include "GLStateCache.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLShaderVariants::GLShaderVariants(void)
+    {
+    nAttributes = 0;
+    }
+
+GLShaderVariants::~GLShaderVariants(void)
+    {
+    // Programs may outlive the context; call Free() while it's current
+    }
+
+void GLShaderVariants::SetSource(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttr,
+                                 const GLint *pIndexes, const char * const *pNames)
+    {
+    strVertexSrc = szVertexSrc;
+    strFragmentSrc = szFragmentSrc;
+
+    nAttributes = (nAttr < GLT_MAX_SHADER_ATTRIBUTES) ? nAttr : GLT_MAX_SHADER_ATTRIBUTES;
+    for(GLint i = 0; i < nAttributes; i++) {
+        iIndexes[i] = pIndexes[i];
+        strAttributes[i] = pNames[i];
+        }
+    }
+
+void GLShaderVariants::SetFeatureNames(const char * const *pNames, GLint nNames)
+    {
+    featureNames.clear();
+    for(GLint i = 0; i < nNames && i < 32; i++)
+        featureNames.push_back(pNames[i]);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Queue every variant not already asked for, then start them all together
+void GLShaderVariants::Precompile(const GLuint *pVariants, GLint nVariants)
+    {
+    for(GLint i = 0; i < nVariants; i++)
+        if(variants.find(pVariants[i]) == variants.end())
+            variants[pVariants[i]] = Submit(pVariants[i]);
+
+    compiler.Submit();
+    }
+
+GLuint GLShaderVariants::GetProgram(GLuint uiVariant)
+    {
+    std::unordered_map<GLuint, GLint>::iterator it = variants.find(uiVariant);
+    if(it == variants.end()) {
+        Precompile(&uiVariant, 1);
+        it = variants.find(uiVariant);
+        }
+
+    if(it->second < 0)
+        return 0;
+
+    // Most likely it's done already. If not, finish off everything queued.
+    if(compiler.GetStatus(it->second) != GLT_PROGRAM_READY)
+        compiler.Finish();
+
+    return compiler.GetProgram(it->second);
+    }
+
+GLT_PROGRAM_STATUS GLShaderVariants::GetStatus(GLuint uiVariant)
+    {
+    std::unordered_map<GLuint, GLint>::iterator it = variants.find(uiVariant);
+    if(it == variants.end())
+        return GLT_PROGRAM_QUEUED;
+
+    if(it->second < 0)
+        return GLT_PROGRAM_FAILED;
+
+    return compiler.GetStatus(it->second);
+    }
+
+void GLShaderVariants::Free(void)
+    {
+    compiler.Finish();
+
+    std::unordered_map<GLuint, GLint>::iterator it;
+    for(it = variants.begin(); it != variants.end(); ++it)
+        if(it->second >= 0 && compiler.GetProgram(it->second) != 0)
+            GLStateCache::GetStateCache()->DeleteProgram(compiler.GetProgram(it->second));
+
+    compiler.Clear();
+    variants.clear();
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Preprocess both shaders with this variant's defines, and hand them to the
+// compiler. Returns the compiler handle, or -1 if the source wouldn't process.
+GLint GLShaderVariants::Submit(GLuint uiVariant)
+    {
+    std::string strDefines;
+    for(size_t i = 0; i < featureNames.size(); i++)
+        if(uiVariant & (1u << i)) {
+            strDefines += featureNames[i];
+            strDefines += ' ';
+            }
+
+    std::string strVP, strFP;
+    if(!preprocessor.Process(strVertexSrc.c_str(), strDefines.c_str(), strVP) ||
+       !preprocessor.Process(strFragmentSrc.c_str(), strDefines.c_str(), strFP))
+        return -1;
+
+    const char *pNames[GLT_MAX_SHADER_ATTRIBUTES];
+    for(GLint i = 0; i < nAttributes; i++)
+        pNames[i] = strAttributes[i].c_str();
+
+    char szName[32];
+    sprintf(szName, "variant 0x%x", uiVariant);
+    return compiler.Add(strVP.c_str(), strFP.c_str(), nAttributes, iIndexes, pNames, szName);
+    }
@@ -0,0 +1,298 @@
+/*
+GLStateCache.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLStateCache.h"
+#include "GLContext.h"
+#include "GLMemoryTracker.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLStateCache::GLStateCache(void)
+    {
+    nCallsMade = 0;
+    nCallsSaved = 0;
+    contextThread = std::this_thread::get_id();
+    Invalidate();
+    }
+
+// Made by whichever thread gets here first with the context current
+GLStateCache* GLStateCache::GetStateCache(void)
+    {
+    GLTCONTEXTDATA *pData = gltGetContextData();
+    GLStateCache *pCache = pData->pStateCache.load(std::memory_order_acquire);
+    if(pCache != NULL)
+        return pCache;
+
+    std::lock_guard<std::mutex> lock(pData->createMutex);
+    pCache = pData->pStateCache.load(std::memory_order_relaxed);
+    if(pCache == NULL) {
+        pCache = new GLStateCache();
+#ifdef QT_IS_AVAILABLE
+        pCache->initializeOpenGLFunctions();
+#endif
+        pData->pStateCache.store(pCache, std::memory_order_release);
+        }
+
+    return pCache;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// With nothing known, the next bind of each kind always goes through
+void GLStateCache::Invalidate(void)
+    {
+    uiCurrentProgram = GLT_STATE_UNKNOWN;
+    uiCurrentVertexArray = GLT_STATE_UNKNOWN;
+    for(int i = 0; i < BUFFER_LAST; i++)
+        uiBuffers[i] = GLT_STATE_UNKNOWN;
+
+    iActiveTexture = GLT_STATE_UNKNOWN;
+    for(int u = 0; u < GLT_STATE_TEXTURE_UNITS; u++)
+        for(int t = 0; t < TEXTURE_LAST; t++)
+            uiTextures[u][t] = GLT_STATE_UNKNOWN;
+
+    uiDrawFramebuffer = GLT_STATE_UNKNOWN;
+    uiReadFramebuffer = GLT_STATE_UNKNOWN;
+    uiRenderbuffer = GLT_STATE_UNKNOWN;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Targets we don't track come back as -1 and are always bound
+int GLStateCache::BufferSlot(GLenum eTarget)
+    {
+    switch(eTarget)
+        {
+        case GL_ARRAY_BUFFER:               return BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER:       return BUFFER_ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER:             return BUFFER_UNIFORM;
+        case GL_COPY_READ_BUFFER:           return BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER:          return BUFFER_COPY_WRITE;
+        case GL_PIXEL_PACK_BUFFER:          return BUFFER_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER:        return BUFFER_PIXEL_UNPACK;
+        case GL_TRANSFORM_FEEDBACK_BUFFER:  return BUFFER_TRANSFORM_FEEDBACK;
+        default:                            return -1;
+        }
+    }
+
+int GLStateCache::TextureSlot(GLenum eTarget)
+    {
+    switch(eTarget)
+        {
+        case GL_TEXTURE_2D:         return TEXTURE_2D;
+        case GL_TEXTURE_CUBE_MAP:   return TEXTURE_CUBE_MAP;
+        case GL_TEXTURE_3D:         return TEXTURE_3D;
+        case GL_TEXTURE_2D_ARRAY:   return TEXTURE_2D_ARRAY;
+        default:                    return -1;
+        }
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLStateCache::UseProgram(GLuint uiProgram)
+    {
+    if(Changed(uiCurrentProgram, uiProgram))
+        glUseProgram(uiProgram);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The element array binding belongs to the vertex array object, so it
+// changes along with it
+void GLStateCache::BindVertexArray(GLuint uiVertexArray)
+    {
+    if(!Changed(uiCurrentVertexArray, uiVertexArray))
+        return;
+
+#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
+    glBindVertexArrayOES(uiVertexArray);
+#else
+    glBindVertexArray(uiVertexArray);
+#endif
+    uiBuffers[BUFFER_ELEMENT_ARRAY] = GLT_STATE_UNKNOWN;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLStateCache::BindBuffer(GLenum eTarget, GLuint uiBuffer)
+    {
+    int iSlot = BufferSlot(eTarget);
+    if(iSlot < 0) {
+        nCallsMade++;
+        glBindBuffer(eTarget, uiBuffer);
+        }
+    else if(Changed(uiBuffers[iSlot], uiBuffer))
+        glBindBuffer(eTarget, uiBuffer);
+    }
+
+// These bind the generic target as well as the indexed one. The indexed
+// bindings themselves aren't tracked.
+void GLStateCache::BindBufferBase(GLenum eTarget, GLuint iIndex, GLuint uiBuffer)
+    {
+    nCallsMade++;
+    glBindBufferBase(eTarget, iIndex, uiBuffer);
+
+    int iSlot = BufferSlot(eTarget);
+    if(iSlot >= 0)
+        uiBuffers[iSlot] = uiBuffer;
+    }
+
+void GLStateCache::BindBufferRange(GLenum eTarget, GLuint iIndex, GLuint uiBuffer, GLintptr nOffset, GLsizeiptr nSize)
+    {
+    nCallsMade++;
+    glBindBufferRange(eTarget, iIndex, uiBuffer, nOffset, nSize);
+
+    int iSlot = BufferSlot(eTarget);
+    if(iSlot >= 0)
+        uiBuffers[iSlot] = uiBuffer;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+void GLStateCache::ActiveTexture(GLenum eUnit)
+    {
+    if(Changed(iActiveTexture, eUnit - GL_TEXTURE0))
+        glActiveTexture(eUnit);
+    }
+
+void GLStateCache::BindTexture(GLenum eTarget, GLuint uiTexture)
+    {
+    int iSlot = TextureSlot(eTarget);
+    if(iSlot < 0 || iActiveTexture >= GLT_STATE_TEXTURE_UNITS) {
+        nCallsMade++;
+        glBindTexture(eTarget, uiTexture);
+        }
+    else if(Changed(uiTextures[iActiveTexture][iSlot], uiTexture))
+        glBindTexture(eTarget, uiTexture);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GL_FRAMEBUFFER is both the draw and the read framebuffer
+void GLStateCache::BindFramebuffer(GLenum eTarget, GLuint uiFramebuffer)
+    {
+    if(eTarget == GL_FRAMEBUFFER) {
+        if(uiDrawFramebuffer == uiFramebuffer && uiReadFramebuffer == uiFramebuffer) {
+            nCallsSaved++;
+            return;
+            }
+        uiDrawFramebuffer = uiFramebuffer;
+        uiReadFramebuffer = uiFramebuffer;
+        nCallsMade++;
+        glBindFramebuffer(eTarget, uiFramebuffer);
+        }
+    else if(Changed(eTarget == GL_READ_FRAMEBUFFER ? uiReadFramebuffer : uiDrawFramebuffer, uiFramebuffer))
+        glBindFramebuffer(eTarget, uiFramebuffer);
+    }
+
+void GLStateCache::BindRenderbuffer(GLenum eTarget, GLuint uiRenderbuffer)
+    {
+    if(Changed(this->uiRenderbuffer, uiRenderbuffer))
+        glBindRenderbuffer(eTarget, uiRenderbuffer);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GL unbinds an object when it is deleted, so a binding to a deleted name
+// is really a binding to zero. Zero itself is never deleted.
+void GLStateCache::DeleteProgram(GLuint uiProgram)
+    {
+    if(uiProgram == 0)
+        return;
+
+    glDeleteProgram(uiProgram);
+
+    // A program that is in use lives on until something else is used. Make
+    // sure the next UseProgram() goes through, even if it reuses the name.
+    if(uiCurrentProgram == uiProgram)
+        uiCurrentProgram = GLT_STATE_UNKNOWN;
+    }
+
+void GLStateCache::DeleteVertexArrays(GLsizei n, const GLuint *pVertexArrays)
+    {
+#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
+    glDeleteVertexArraysOES(n, pVertexArrays);
+#else
+    glDeleteVertexArrays(n, pVertexArrays);
+#endif
+    for(GLsizei i = 0; i < n; i++)
+        if(pVertexArrays[i] != 0 && uiCurrentVertexArray == pVertexArrays[i]) {
+            uiCurrentVertexArray = 0;
+            uiBuffers[BUFFER_ELEMENT_ARRAY] = GLT_STATE_UNKNOWN;
+            }
+    }
+
+void GLStateCache::DeleteBuffers(GLsizei n, const GLuint *pBuffers)
+    {
+    glDeleteBuffers(n, pBuffers);
+    for(GLsizei i = 0; i < n; i++) {
+        if(pBuffers[i] == 0)
+            continue;
+
+        for(int b = 0; b < BUFFER_LAST; b++)
+            if(uiBuffers[b] == pBuffers[i])
+                uiBuffers[b] = 0;
+        }
+    }
+
+void GLStateCache::DeleteTextures(GLsizei n, const GLuint *pTextures)
+    {
+    glDeleteTextures(n, pTextures);
+    for(GLsizei i = 0; i < n; i++) {
+        if(pTextures[i] == 0)
+            continue;
+
+        GLMemoryTracker::GetMemoryTracker()->ForgetTexture(pTextures[i]);
+        for(int u = 0; u < GLT_STATE_TEXTURE_UNITS; u++)
+            for(int t = 0; t < TEXTURE_LAST; t++)
+                if(uiTextures[u][t] == pTextures[i])
+                    uiTextures[u][t] = 0;
+        }
+    }
+
+void GLStateCache::DeleteFramebuffers(GLsizei n, const GLuint *pFramebuffers)
+    {
+    glDeleteFramebuffers(n, pFramebuffers);
+    for(GLsizei i = 0; i < n; i++) {
+        if(pFramebuffers[i] == 0)
+            continue;
+
+        if(uiDrawFramebuffer == pFramebuffers[i])
+            uiDrawFramebuffer = 0;
+        if(uiReadFramebuffer == pFramebuffers[i])
+            uiReadFramebuffer = 0;
+        }
+    }
+
+void GLStateCache::DeleteRenderbuffers(GLsizei n, const GLuint *pRenderbuffers)
+    {
+    glDeleteRenderbuffers(n, pRenderbuffers);
+    for(GLsizei i = 0; i < n; i++)
+        if(pRenderbuffers[i] != 0 && uiRenderbuffer == pRenderbuffers[i])
+            uiRenderbuffer = 0;
+    }
@@ -0,0 +1,375 @@
+/*
+GLTerrainBatch.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLTerrainBatch.h"
+#include <stddef.h>
+#include <float.h>
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLTerrainBatch::GLTerrainBatch(void)
+    {
+    pChunks = nullptr;
+    nChunksX = 0;
+    nChunksZ = 0;
+    nChunkQuads = 0;
+    nLODs = 0;
+    indexBufferObject = 0;
+    fLODDistance = 0.0f;
+    nTrianglesDrawn = 0;
+    }
+
+GLTerrainBatch::~GLTerrainBatch(void)
+    {
+    Free();
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Release all the GL objects, once the GPU is done with them
+void GLTerrainBatch::Free(void)
+    {
+    GLDeleteQueue *pQueue = GLDeleteQueue::GetDeleteQueue();
+    if(pChunks != nullptr) {
+        for(GLint i = 0; i < nChunksX * nChunksZ; i++) {
+            pQueue->DeleteVertexArrays(1, &pChunks[i].vertexArrayObject);
+            pQueue->DeleteBuffers(1, &pChunks[i].vertexBufferObject);
+            }
+
+        delete [] pChunks;
+        pChunks = nullptr;
+        }
+
+    if(indexBufferObject != 0) {
+        pQueue->DeleteBuffers(1, &indexBufferObject);
+        indexBufferObject = 0;
+        }
+
+    nChunksX = 0;
+    nChunksZ = 0;
+    nLODs = 0;
+    GLMemoryTracker::GetMemoryTracker()->Forget(this);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert the red or luminance channel to heights, and build from those
+bool GLTerrainBatch::BuildFromImage(const GLbyte *pBits, GLint nWidth, GLint nDepth, GLenum eFormat,
+                    GLfloat fSpacing, GLfloat fHeightScale, GLint nQuads, GLint nLevels)
+    {
+    GLint nPixelBytes, iRed;
+    switch(eFormat)
+        {
+        case GL_LUMINANCE:
+        case GL_RED:
+            nPixelBytes = 1;
+            iRed = 0;
+            break;
+
+        case GL_RGB:
+            nPixelBytes = 3;
+            iRed = 0;
+            break;
+
+        case GL_RGBA:
+            nPixelBytes = 4;
+            iRed = 0;
+            break;
+
+#ifndef OPENGL_ES
+        case GL_BGRA_EXT:
+            nPixelBytes = 4;
+            iRed = 2;
+            break;
+#endif
+
+        default:
+            return false;
+        }
+
+    if(pBits == nullptr)
+        return false;
+
+    size_t nSamples = size_t(nWidth) * size_t(nDepth);
+    GLfloat *pHeights = new GLfloat[nSamples];
+    const unsigned char *pPixels = (const unsigned char *)pBits;
+    for(size_t i = 0; i < nSamples; i++)
+        pHeights[i] = GLfloat(pPixels[i * nPixelBytes + iRed]) * fHeightScale;
+
+    bool bBuilt = Build(pHeights, nWidth, nDepth, fSpacing, nQuads, nLevels);
+    delete [] pHeights;
+    return bBuilt;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cut the heightfield into chunks and send them to the GPU. Chunks along the
+// far edges may hang off the end of the samples; those vertices are clamped
+// to the last row or column, and the extra triangles have no area.
+bool GLTerrainBatch::Build(const GLfloat *pHeights, GLint nWidth, GLint nDepth, GLfloat fSpacing,
+                    GLint nQuads, GLint nLevels)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+
+    Free();
+
+    // Chunk vertices must be reachable with short indexes
+    if(pHeights == nullptr || nWidth < 2 || nDepth < 2 || nQuads < 1 || nQuads > 128 || (nQuads & (nQuads - 1)) != 0)
+        return false;
+
+    nChunkQuads = nQuads;
+    nChunksX = (nWidth - 2) / nChunkQuads + 1;
+    nChunksZ = (nDepth - 2) / nChunkQuads + 1;
+
+    // Can't skip more samples than there are in a chunk
+    nLODs = 1;
+    while(nLODs < nLevels && nLODs < GLT_TERRAIN_MAX_LODS && (1 << nLODs) <= nChunkQuads)
+        nLODs++;
+
+    if(fLODDistance <= 0.0f)
+        fLODDistance = GLfloat(nChunkQuads) * fSpacing;
+
+    BuildIndexes();
+
+    GLint nRowVerts = nChunkQuads + 1;
+    TERRAINVERTEX *pVerts = new TERRAINVERTEX[nRowVerts * nRowVerts + 4 * nRowVerts];
+
+    pChunks = new TERRAINCHUNK[nChunksX * nChunksZ];
+    for(GLint z = 0; z < nChunksZ; z++)
+        for(GLint x = 0; x < nChunksX; x++)
+            BuildChunk(pChunks[z * nChunksX + x], x, z, pHeights, nWidth, nDepth, fSpacing, pVerts);
+
+    delete [] pVerts;
+
+    GLMemoryTracker::GetMemoryTracker()->SetUsage(GLT_MEMORY_VERTEX, this,
+        GLsizeiptr(sizeof(TERRAINVERTEX)) * (nRowVerts * nRowVerts + 4 * nRowVerts) * nChunksX * nChunksZ, "GLTerrainBatch");
+
+    GLStateCache::GetStateCache()->BindVertexArray(0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// One index buffer for every level of detail, one after the other. Vertices
+// are the (nChunkQuads+1)^2 grid, row by row, followed by a row of skirt
+// vertices for each edge: +z, -z, -x, +x.
+void GLTerrainBatch::BuildIndexes(void)
+    {
+    GLuint nRowVerts = nChunkQuads + 1;
+    GLuint iSkirt = nRowVerts * nRowVerts;
+
+    GLuint nTotalIndexes = 0;
+    for(GLint l = 0; l < nLODs; l++) {
+        GLuint nSteps = nChunkQuads >> l;
+        nTotalIndexes += nSteps * nSteps * 6 + 4 * nSteps * 6;
+        }
+
+    GLushort *pIndexes = new GLushort[nTotalIndexes];
+    GLuint iIndex = 0;
+
+    for(GLint l = 0; l < nLODs; l++) {
+        GLuint nStep = 1 << l;
+        lodFirstIndex[l] = iIndex;
+
+        for(GLuint j = 0; j < GLuint(nChunkQuads); j += nStep)
+            for(GLuint i = 0; i < GLuint(nChunkQuads); i += nStep) {
+                GLushort v00 = GLushort(j * nRowVerts + i);
+                GLushort v10 = GLushort(v00 + nStep);
+                GLushort v01 = GLushort(v00 + nStep * nRowVerts);
+                GLushort v11 = GLushort(v01 + nStep);
+
+                pIndexes[iIndex++] = v00; pIndexes[iIndex++] = v10; pIndexes[iIndex++] = v01;
+                pIndexes[iIndex++] = v10; pIndexes[iIndex++] = v11; pIndexes[iIndex++] = v01;
+                }
+
+        // Skirts. The +z and +x edges wind the other way to face outward.
+        for(GLuint e = 0; e < 4; e++)
+            for(GLuint k = 0; k < GLuint(nChunkQuads); k += nStep) {
+                GLuint a, b;
+                switch(e) {
+                    case 0:  a = k;                       b = k + nStep;                        break;  // +z
+                    case 1:  a = nChunkQuads * nRowVerts + k;  b = a + nStep;                   break;  // -z
+                    case 2:  a = k * nRowVerts;           b = a + nStep * nRowVerts;            break;  // -x
+                    default: a = k * nRowVerts + nChunkQuads;  b = a + nStep * nRowVerts;       break;  // +x
+                    }
+
+                GLushort ea = GLushort(a), eb = GLushort(b);
+                GLushort sa = GLushort(iSkirt + e * nRowVerts + k);
+                GLushort sb = GLushort(sa + nStep);
+
+                if(e == 1 || e == 2) {
+                    pIndexes[iIndex++] = ea; pIndexes[iIndex++] = eb; pIndexes[iIndex++] = sa;
+                    pIndexes[iIndex++] = eb; pIndexes[iIndex++] = sb; pIndexes[iIndex++] = sa;
+                    }
+                else {
+                    pIndexes[iIndex++] = ea; pIndexes[iIndex++] = sa; pIndexes[iIndex++] = eb;
+                    pIndexes[iIndex++] = eb; pIndexes[iIndex++] = sa; pIndexes[iIndex++] = sb;
+                    }
+                }
+
+        lodIndexCount[l] = iIndex - lodFirstIndex[l];
+        }
+
+    glGenBuffers(1, &indexBufferObject);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferObject);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * nTotalIndexes, pIndexes, GL_STATIC_DRAW);
+    delete [] pIndexes;
+
+    GLMemoryTracker::GetMemoryTracker()->SetUsage(GLT_MEMORY_INDEX, this, sizeof(GLushort) * nTotalIndexes, "GLTerrainBatch");
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fill in the vertices for one chunk, using pVerts as workspace, and upload
+// them. Normals come from the neighboring samples, which may belong to the
+// next chunk over, so there are no seams in the lighting.
+void GLTerrainBatch::BuildChunk(TERRAINCHUNK& chunk, GLint iChunkX, GLint iChunkZ, const GLfloat *pHeights,
+                        GLint nWidth, GLint nDepth, GLfloat fSpacing, TERRAINVERTEX *pVerts)
+    {
+    GLint nRowVerts = nChunkQuads + 1;
+    GLfloat fHalfWidth = GLfloat(nWidth - 1) * 0.5f;
+    GLfloat fHalfDepth = GLfloat(nDepth - 1) * 0.5f;
+
+    m3dLoadVector3(chunk.vMin, FLT_MAX, FLT_MAX, FLT_MAX);
+    m3dLoadVector3(chunk.vMax, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+    for(GLint j = 0; j < nRowVerts; j++) {
+        GLint z = iChunkZ * nChunkQuads + j;
+        if(z > nDepth - 1) z = nDepth - 1;
+        const GLfloat *pRow = pHeights + size_t(z) * nWidth;
+        const GLfloat *pRowBack = (z > 0) ? pRow - nWidth : pRow;
+        const GLfloat *pRowForward = (z < nDepth - 1) ? pRow + nWidth : pRow;
+
+        for(GLint i = 0; i < nRowVerts; i++) {
+            GLint x = iChunkX * nChunkQuads + i;
+            if(x > nWidth - 1) x = nWidth - 1;
+            GLint xLeft = (x > 0) ? x - 1 : x;
+            GLint xRight = (x < nWidth - 1) ? x + 1 : x;
+
+            TERRAINVERTEX& vert = pVerts[j * nRowVerts + i];
+            vert.vVertex[0] = (GLfloat(x) - fHalfWidth) * fSpacing;
+            vert.vVertex[1] = pRow[x];
+            vert.vVertex[2] = (fHalfDepth - GLfloat(z)) * fSpacing;
+
+            // Rows run toward -z, so the forward row is "behind" in z
+            M3DVector3f vNormal = { pRow[xLeft] - pRow[xRight], 2.0f * fSpacing, pRowForward[x] - pRowBack[x] };
+            m3dNormalizeVector3(vNormal);
+            vert.vNormal[0] = GLbyte(vNormal[0] * 127.0f);
+            vert.vNormal[1] = GLbyte(vNormal[1] * 127.0f);
+            vert.vNormal[2] = GLbyte(vNormal[2] * 127.0f);
+            vert.vNormal[3] = 0;
+
+            vert.vTexCoord[0] = GLushort(GLfloat(x) / GLfloat(nWidth - 1) * 65535.0f + 0.5f);
+            vert.vTexCoord[1] = GLushort(GLfloat(z) / GLfloat(nDepth - 1) * 65535.0f + 0.5f);
+
+            for(int c = 0; c < 3; c++) {
+                if(vert.vVertex[c] < chunk.vMin[c]) chunk.vMin[c] = vert.vVertex[c];
+                if(vert.vVertex[c] > chunk.vMax[c]) chunk.vMax[c] = vert.vVertex[c];
+                }
+            }
+        }
+
+    // Skirts hang below the lowest point in the chunk. Any crack between
+    // two levels of detail is within the chunk's height range.
+    GLfloat fSkirtY = chunk.vMin[1] - fSpacing;
+    TERRAINVERTEX *pSkirt = pVerts + nRowVerts * nRowVerts;
+    for(GLint k = 0; k < nRowVerts; k++) {
+        pSkirt[k] = pVerts[k];                                                     // +z
+        pSkirt[nRowVerts + k] = pVerts[nChunkQuads * nRowVerts + k];               // -z
+        pSkirt[2 * nRowVerts + k] = pVerts[k * nRowVerts];                         // -x
+        pSkirt[3 * nRowVerts + k] = pVerts[k * nRowVerts + nChunkQuads];           // +x
+        }
+    for(GLint k = 0; k < 4 * nRowVerts; k++)
+        pSkirt[k].vVertex[1] = fSkirtY;
+    chunk.vMin[1] = fSkirtY;
+
+    // Off to the GPU
+    GLsizeiptr nBytes = sizeof(TERRAINVERTEX) * (nRowVerts * nRowVerts + 4 * nRowVerts);
+    GLsizei nStride = sizeof(TERRAINVERTEX);
+
+#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
+    glGenVertexArraysOES(1, &chunk.vertexArrayObject);
+#else
+    glGenVertexArrays(1, &chunk.vertexArrayObject);
+#endif
+    GLStateCache::GetStateCache()->BindVertexArray(chunk.vertexArrayObject);
+
+    glGenBuffers(1, &chunk.vertexBufferObject);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, chunk.vertexBufferObject);
+    glBufferData(GL_ARRAY_BUFFER, nBytes, pVerts, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(GLT_ATTRIBUTE_VERTEX, 3, GL_FLOAT, GL_FALSE, nStride, (const GLvoid *)offsetof(TERRAINVERTEX, vVertex));
+    glEnableVertexAttribArray(GLT_ATTRIBUTE_VERTEX);
+    glVertexAttribPointer(GLT_ATTRIBUTE_NORMAL, 3, GL_BYTE, GL_TRUE, nStride, (const GLvoid *)offsetof(TERRAINVERTEX, vNormal));
+    glEnableVertexAttribArray(GLT_ATTRIBUTE_NORMAL);
+    glVertexAttribPointer(GLT_ATTRIBUTE_TEXTURE0, 2, GL_UNSIGNED_SHORT, GL_TRUE, nStride, (const GLvoid *)offsetof(TERRAINVERTEX, vTexCoord));
+    glEnableVertexAttribArray(GLT_ATTRIBUTE_TEXTURE0);
+
+    // The shared indexes
+    GLStateCache::GetStateCache()->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferObject);
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The distance to a chunk is measured to the nearest point of its bounding
+// box, so the chunk the eye is over is always at full detail.
+void GLTerrainBatch::Draw(const M3DVector3f vEye)
+    {
+    nTrianglesDrawn = 0;
+    if(pChunks == nullptr)
+        return;
+
+    for(GLint i = 0; i < nChunksX * nChunksZ; i++) {
+        TERRAINCHUNK& chunk = pChunks[i];
+
+        M3DVector3f vNearest;
+        for(int c = 0; c < 3; c++) {
+            vNearest[c] = vEye[c];
+            if(vNearest[c] < chunk.vMin[c]) vNearest[c] = chunk.vMin[c];
+            if(vNearest[c] > chunk.vMax[c]) vNearest[c] = chunk.vMax[c];
+            }
+        GLfloat fDistance = m3dGetDistance3(vEye, vNearest);
+
+        GLint iLOD = 0;
+        GLfloat fLODLimit = fLODDistance;
+        while(iLOD < nLODs - 1 && fDistance > fLODLimit) {
+            iLOD++;
+            fLODLimit *= 2.0f;
+            }
+
+        GLStateCache::GetStateCache()->BindVertexArray(chunk.vertexArrayObject);
+        glDrawElements(GL_TRIANGLES, lodIndexCount[iLOD], GL_UNSIGNED_SHORT,
+                        (const GLvoid *)(sizeof(GLushort) * lodFirstIndex[iLOD]));
+        nTrianglesDrawn += lodIndexCount[iLOD] / 3;
+        }
+
+    GLStateCache::GetStateCache()->BindVertexArray(0);
+    }
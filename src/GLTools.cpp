@@ -30,10 +30,36 @@ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF S
 */
 
 #include "GLTools.h"
+#include "GLContext.h"
 #include "CSkyDataFile.h"
 #include "target.h"
 
-GLTools* GLTools::pMe = NULL;
+#include <thread>
+#include <vector>
+#include <stddef.h>
+
+char GLTools::szProgramCacheDirectory[MAX_CACHE_PATH_LENGTH] = "";
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Made by whichever thread gets here first with the context current
+GLTools* GLTools::GetGLTools()
+    {
+    GLTCONTEXTDATA *pData = gltGetContextData();
+    GLTools *pTools = pData->pTools.load(std::memory_order_acquire);
+    if(pTools != NULL)
+        return pTools;
+
+    std::lock_guard<std::mutex> lock(pData->createMutex);
+    pTools = pData->pTools.load(std::memory_order_relaxed);
+    if(pTools == NULL) {
+        pTools = new GLTools();
+        pTools->InitializeGL();
+        pData->pTools.store(pTools, std::memory_order_release);
+        }
+
+    return pTools;
+    }
 
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -68,6 +94,19 @@ void gltSetWorkingDirectory(const char *szArgv)
 	#endif
 	}
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Good enough to tell cache entries apart, and cheap enough to run over
+// whole shader sources or mesh parameters.
+uint64_t gltHashBytes(const void *pData, size_t nBytes, uint64_t hash)
+	{
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	for(size_t i = 0; i < nBytes; i++) {
+		hash ^= pBytes[i];
+		hash *= 1099511628211ULL;
+		}
+	return hash;
+	}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Derive the normal matrix from the modelview matrix. Essentially, extract just the
 // rotation matrix.
@@ -90,104 +129,118 @@ void gltComputeNormalMatrix(M3DMatrix33f& mNormal, const M3DMatrix44f& mModelVie
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Helpers for the parametric shapes below. Every one of them is a grid whose
+// sines and cosines are separable, so they are computed once per row and once per
+// column into tables, leaving the inner loops with nothing but multiplies.
+// Big grids are cut into bands of rows, one per core. A band writes only its own
+// vertices and triangles, so the threads never touch the same memory.
+#define GLT_PARALLEL_MIN_VERTS      65536
+
+template <class BANDFUNC>
+static void gltForEachRowBand(GLint nRows, GLint nRowVerts, BANDFUNC bandFunc)
+	{
+	GLint nThreads = (GLint)std::thread::hardware_concurrency();
+	if(nThreads > nRows)
+		nThreads = nRows;
+
+	// Not worth waking anyone up for
+	if(nThreads < 2 || nRows * nRowVerts < GLT_PARALLEL_MIN_VERTS) {
+		bandFunc(0, nRows);
+		return;
+		}
+
+	GLint nBandRows = (nRows + nThreads - 1) / nThreads;
+	std::vector<std::thread> workers;
+	for(GLint iFirst = nBandRows; iFirst < nRows; iFirst += nBandRows) {
+		GLint iLast = (iFirst + nBandRows < nRows) ? iFirst + nBandRows : nRows;
+		workers.push_back(std::thread(bandFunc, iFirst, iLast));
+		}
+
+	// This thread takes the first band
+	bandFunc(0, nBandRows);
+
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	}
+
+
 // Draw a torus (doughnut)  at z = fZVal... torus is in xy plane
+// The surface is a (numMajor+1) x (numMinor+1) grid of vertices. The last column
+// and row repeat the first ones so the texture coordinates can run all the way to 1.0
 void gltMakeTorus(GLTriangleBatch& torusBatch, GLfloat majorRadius, GLfloat minorRadius, GLint numMajor, GLint numMinor)
 	{
     double majorStep = 2.0f*M3D_PI / numMajor;
     double minorStep = 2.0f*M3D_PI / numMinor;
-    int i, j;
-	
-    torusBatch.BeginMesh(numMajor * (numMinor+1) * 6);
-    for (i=0; i<numMajor; ++i) 
+    GLint nRingVerts = numMinor + 1;
+
+    torusBatch.BeginIndexedMesh((numMajor + 1) * nRingVerts, numMajor * numMinor * 6);
+
+    // Around the tube. These are the same for every ring.
+    GLfloat *pMinorCos = new GLfloat[nRingVerts];
+    GLfloat *pMinorSin = new GLfloat[nRingVerts];
+    for(GLint j = 0; j <= numMinor; j++) {
+        double b = j * minorStep;
+        pMinorCos[j] = (GLfloat) cos(b);
+        pMinorSin[j] = (GLfloat) sin(b);
+        }
+
+    gltForEachRowBand(numMajor + 1, nRingVerts, [&](GLint iFirst, GLint iLast)
 		{
-		double a0 = i * majorStep;
-		double a1 = a0 + majorStep;
-		GLfloat x0 = (GLfloat) cos(a0);
-		GLfloat y0 = (GLfloat) sin(a0);
-		GLfloat x1 = (GLfloat) cos(a1);
-		GLfloat y1 = (GLfloat) sin(a1);
-
-		M3DVector3f vVertex[4];
-		M3DVector3f vNormal[4];
-		M3DVector2f vTexture[4];
-		
-		for (j=0; j<=numMinor; ++j) 
+		M3DVector3f vVertex;
+		M3DVector3f vNormal;
+		M3DVector2f vTexture;
+
+		for (GLint i = iFirst; i < iLast; ++i)
 			{
-			double b = j * minorStep;
-			GLfloat c = (GLfloat) cos(b);
-			GLfloat r = minorRadius * c + majorRadius;
-			GLfloat z = minorRadius * (GLfloat) sin(b);
-			
-			// First point
-			vTexture[0][0] = (float)(i)/(float)(numMajor);
-			vTexture[0][1] = (float)(j)/(float)(numMinor);
-			vNormal[0][0] = x0*c;
-			vNormal[0][1] = y0*c;
-			vNormal[0][2] = z/minorRadius;
-			m3dNormalizeVector3(vNormal[0]);
-			vVertex[0][0] = x0 * r;
-			vVertex[0][1] = y0 * r;
-			vVertex[0][2] = z;
-			
-			// Second point
-			vTexture[1][0] = (float)(i+1)/(float)(numMajor);
-			vTexture[1][1] = (float)(j)/(float)(numMinor);
-			vNormal[1][0] = x1*c;
-			vNormal[1][1] = y1*c;
-			vNormal[1][2] = z/minorRadius;
-			m3dNormalizeVector3(vNormal[1]);
-			vVertex[1][0] = x1*r;
-			vVertex[1][1] = y1*r;
-			vVertex[1][2] = z;
-
-			// Next one over
-			b = (j+1) * minorStep;
-			c = (GLfloat) cos(b);
-			r = minorRadius * c + majorRadius;
-			z = minorRadius * (GLfloat) sin(b);
-						
-			// Third (based on first)
-			vTexture[2][0] = (float)(i)/(float)(numMajor);
-			vTexture[2][1] = (float)(j+1)/(float)(numMinor);
-			vNormal[2][0] = x0*c;
-			vNormal[2][1] = y0*c;
-			vNormal[2][2] = z/minorRadius;
-			m3dNormalizeVector3(vNormal[2]);
-			vVertex[2][0] = x0 * r;
-			vVertex[2][1] = y0 * r;
-			vVertex[2][2] = z;
-			
-			// Fourth (based on second)
-			vTexture[3][0] = (float)(i+1)/(float)(numMajor);
-			vTexture[3][1] = (float)(j+1)/(float)(numMinor);
-			vNormal[3][0] = x1*c;
-			vNormal[3][1] = y1*c;
-			vNormal[3][2] = z/minorRadius;
-			m3dNormalizeVector3(vNormal[3]);
-			vVertex[3][0] = x1*r;
-			vVertex[3][1] = y1*r;
-			vVertex[3][2] = z;
-
-			torusBatch.AddTriangle(vVertex, vNormal, vTexture);			
-			
-			// Rearrange for next triangle
-			memcpy(vVertex[0], vVertex[1], sizeof(M3DVector3f));
-			memcpy(vNormal[0], vNormal[1], sizeof(M3DVector3f));
-			memcpy(vTexture[0], vTexture[1], sizeof(M3DVector2f));
-			
-			memcpy(vVertex[1], vVertex[3], sizeof(M3DVector3f));
-			memcpy(vNormal[1], vNormal[3], sizeof(M3DVector3f));
-			memcpy(vTexture[1], vTexture[3], sizeof(M3DVector2f));
-					
-			torusBatch.AddTriangle(vVertex, vNormal, vTexture);			
+			double a = i * majorStep;
+			GLfloat x = (GLfloat) cos(a);
+			GLfloat y = (GLfloat) sin(a);
+			vTexture[0] = (float)(i)/(float)(numMajor);
+
+			for (GLint j = 0; j <= numMinor; ++j)
+				{
+				GLfloat c = pMinorCos[j];
+				GLfloat r = minorRadius * c + majorRadius;
+				GLfloat z = minorRadius * pMinorSin[j];
+
+				vTexture[1] = (float)(j)/(float)(numMinor);
+				vNormal[0] = x*c;
+				vNormal[1] = y*c;
+				vNormal[2] = pMinorSin[j];			// Already unit length
+				vVertex[0] = x * r;
+				vVertex[1] = y * r;
+				vVertex[2] = z;
+
+				torusBatch.SetVertex(i * nRingVerts + j, vVertex, vNormal, vTexture);
+				}
+
+			// Two triangles for each quad, wound the same way the old triangle soup was
+			if(i == numMajor)
+				continue;
+
+			GLuint iTriangle = i * numMinor * 2;
+			for (GLint j = 0; j < numMinor; ++j)
+				{
+				GLuint v0 = i * nRingVerts + j;
+				GLuint v1 = v0 + nRingVerts;
+				torusBatch.SetTriangle(iTriangle++, v0, v1, v0 + 1);
+				torusBatch.SetTriangle(iTriangle++, v1, v1 + 1, v0 + 1);
+				}
 			}
-		}
+		});
+
+	delete [] pMinorCos;
+	delete [] pMinorSin;
+
 	torusBatch.End();
 	}
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // Make a sphere
 // +Z comes out the top of the sphere
+// The vertices form an (iStacks+1) x (iSlices+1) grid, top to bottom. The poles and the seam
+// are repeated because each copy has its own texture coordinate.
 void gltMakeSphere(GLTriangleBatch& sphereBatch, GLfloat fRadius, GLint iSlices, GLint iStacks)
 	{
     GLfloat drho = (GLfloat)(3.141592653589) / (GLfloat) iStacks;
@@ -196,109 +249,87 @@ void gltMakeSphere(GLTriangleBatch& sphereBatch, GLfloat fRadius, GLint iSlices,
 	GLfloat dt = 1.0f / (GLfloat) iStacks;
 	GLfloat t = 1.0f;	
 	GLfloat s = 0.0f;
-    GLint i, j;     // Looping variables
-    
-    sphereBatch.BeginMesh(iSlices * iStacks * 6);
-	for (i = 0; i < iStacks; i++) 
+    GLint nRowVerts = iSlices + 1;
+    
+    sphereBatch.BeginIndexedMesh((iStacks + 1) * nRowVerts, iSlices * iStacks * 6);
+
+    // Around the sphere, shared by every stack. Many sources of OpenGL sphere
+    // drawing code uses a triangle fan for the caps of the sphere. This however
+    // introduces texturing artifacts at the poles on some OpenGL implementations
+    GLfloat *pSinTheta = new GLfloat[nRowVerts];
+    GLfloat *pCosTheta = new GLfloat[nRowVerts];
+    GLfloat *pS = new GLfloat[nRowVerts];
+    for(GLint j = 0; j <= iSlices; j++) {
+        GLfloat theta = (j == iSlices) ? 0.0f : j * dtheta;
+        pSinTheta[j] = (GLfloat)(-sin(theta));
+        pCosTheta[j] = (GLfloat)(cos(theta));
+        pS[j] = s;
+        s += ds;
+        }
+
+    // Top to bottom
+    GLfloat *pT = new GLfloat[iStacks + 1];
+    for(GLint i = 0; i <= iStacks; i++) {
+        pT[i] = t;
+        t -= dt;
+        }
+
+    gltForEachRowBand(iStacks + 1, nRowVerts, [&](GLint iFirst, GLint iLast)
 		{
-		GLfloat rho = (GLfloat)i * drho;
-		GLfloat srho = (GLfloat)(sin(rho));
-		GLfloat crho = (GLfloat)(cos(rho));
-		GLfloat srhodrho = (GLfloat)(sin(rho + drho));
-		GLfloat crhodrho = (GLfloat)(cos(rho + drho));
-		
-        // Many sources of OpenGL sphere drawing code uses a triangle fan
-        // for the caps of the sphere. This however introduces texturing 
-        // artifacts at the poles on some OpenGL implementations
-        s = 0.0f;
-		M3DVector3f vVertex[4];
-		M3DVector3f vNormal[4];
-		M3DVector2f vTexture[4];
-
-		for ( j = 0; j < iSlices; j++) 
+		M3DVector3f vVertex;
+		M3DVector3f vNormal;
+		M3DVector2f vTexture;
+
+		for (GLint i = iFirst; i < iLast; i++) 
 			{
-			GLfloat theta = (j == iSlices) ? 0.0f : j * dtheta;
-			GLfloat stheta = (GLfloat)(-sin(theta));
-			GLfloat ctheta = (GLfloat)(cos(theta));
-			
-			GLfloat x = stheta * srho;
-			GLfloat y = ctheta * srho;
-			GLfloat z = crho;
+			GLfloat rho = (GLfloat)i * drho;
+			GLfloat srho = (GLfloat)(sin(rho));
+			GLfloat crho = (GLfloat)(cos(rho));
+			vTexture[1] = pT[i];
+		
+			for (GLint j = 0; j <= iSlices; j++) 
+				{
+				GLfloat x = pSinTheta[j] * srho;
+				GLfloat y = pCosTheta[j] * srho;
+				GLfloat z = crho;
         
-			vTexture[0][0] = s;
-			vTexture[0][1] = t;
-			vNormal[0][0] = x;
-			vNormal[0][1] = y;
-			vNormal[0][2] = z;
-			vVertex[0][0] = x * fRadius;
-			vVertex[0][1] = y * fRadius;
-			vVertex[0][2] = z * fRadius;
-			
-            x = stheta * srhodrho;
-			y = ctheta * srhodrho;
-			z = crhodrho;
-
- 			vTexture[1][0] = s;
-			vTexture[1][1] = t - dt;
-			vNormal[1][0] = x;
-			vNormal[1][1] = y;
-			vNormal[1][2] = z;
-			vVertex[1][0] = x * fRadius;
-			vVertex[1][1] = y * fRadius;
-			vVertex[1][2] = z * fRadius;
-			
+				vTexture[0] = pS[j];
+				vNormal[0] = x;
+				vNormal[1] = y;
+				vNormal[2] = z;
+				vVertex[0] = x * fRadius;
+				vVertex[1] = y * fRadius;
+				vVertex[2] = z * fRadius;
+
+				sphereBatch.SetVertex(i * nRowVerts + j, vVertex, vNormal, vTexture);
+				}
 
-			theta = ((j+1) == iSlices) ? 0.0f : (j+1) * dtheta;
-			stheta = (GLfloat)(-sin(theta));
-			ctheta = (GLfloat)(cos(theta));
-			
-			x = stheta * srho;
-			y = ctheta * srho;
-			z = crho;
-        
-            s += ds;
-			vTexture[2][0] = s;
-			vTexture[2][1] = t;
-			vNormal[2][0] = x;
-			vNormal[2][1] = y;
-			vNormal[2][2] = z;
-			vVertex[2][0] = x * fRadius;
-			vVertex[2][1] = y * fRadius;
-			vVertex[2][2] = z * fRadius;
-			
-            x = stheta * srhodrho;
-			y = ctheta * srhodrho;
-			z = crhodrho;
-
- 			vTexture[3][0] = s;
-			vTexture[3][1] = t - dt;
-			vNormal[3][0] = x;
-			vNormal[3][1] = y;
-			vNormal[3][2] = z;
-			vVertex[3][0] = x * fRadius;
-			vVertex[3][1] = y * fRadius;
-			vVertex[3][2] = z * fRadius;
-		
-			sphereBatch.AddTriangle(vVertex, vNormal, vTexture);			
-			
-			// Rearrange for next triangle
-			memcpy(vVertex[0], vVertex[1], sizeof(M3DVector3f));
-			memcpy(vNormal[0], vNormal[1], sizeof(M3DVector3f));
-			memcpy(vTexture[0], vTexture[1], sizeof(M3DVector2f));
-			
-			memcpy(vVertex[1], vVertex[3], sizeof(M3DVector3f));
-			memcpy(vNormal[1], vNormal[3], sizeof(M3DVector3f));
-			memcpy(vTexture[1], vTexture[3], sizeof(M3DVector2f));
-					
-			sphereBatch.AddTriangle(vVertex, vNormal, vTexture);			
+			if(i == iStacks)
+				continue;
+
+			GLuint iTriangle = i * iSlices * 2;
+			for (GLint j = 0; j < iSlices; j++)
+				{
+				GLuint v0 = i * nRowVerts + j;		// This stack
+				GLuint v1 = v0 + nRowVerts;			// The one below it
+				sphereBatch.SetTriangle(iTriangle++, v0, v1, v0 + 1);
+				sphereBatch.SetTriangle(iTriangle++, v1, v1 + 1, v0 + 1);
+				}
 			}
-        t -= dt;
-        }
-		sphereBatch.End();
+		});
+
+	delete [] pSinTheta;
+	delete [] pCosTheta;
+	delete [] pS;
+	delete [] pT;
+
+	sphereBatch.End();
     }
     
 
 ////////////////////////////////////////////////////////////////////////////////////////
+// A full circle shares its first and last spoke. If the inner radius is zero, the
+// whole inner ring collapses to a single vertex at the center.
 void gltMakeDisk(GLTriangleBatch& diskBatch, GLfloat innerRadius, GLfloat outerRadius, 
                                                 GLint nSlices, GLint nStacks, GLfloat fDegrees)
 	{
@@ -310,98 +341,109 @@ void gltMakeDisk(GLTriangleBatch& diskBatch, GLfloat innerRadius, GLfloat outerR
 	fStepSizeRadial /= float(nStacks);
 	
 	GLfloat fStepSizeSlice = m3dDegToRad(fDegrees) / float(nSlices);
+
+	GLint nSpokes = (fDegrees == 360.0f) ? nSlices : nSlices + 1;
+	bool bCenter = m3dCloseEnough(innerRadius, 0.0f, 0.00001f);
+
+	// The center fan only needs one triangle per slice
+	GLint nVerts = (nStacks + 1) * nSpokes;
+	GLint nTriangles = nStacks * nSlices * 2;
+	if(bCenter) {
+		nVerts -= nSpokes - 1;
+		nTriangles -= nSlices;
+		}
+
+	diskBatch.BeginIndexedMesh(nVerts, nTriangles * 3);
 	
-	diskBatch.BeginMesh(nSlices * nStacks * 6);
-	
-	M3DVector3f vVertex[4];
-	M3DVector3f vNormal[4];
-	M3DVector2f vTexture[4];
+	M3DVector3f vVertex;
+	M3DVector3f vNormal = { 0.0f, 0.0f, 1.0f };		// Surface Normal, same for everybody
+	M3DVector2f vTexture;
 	
 	float fRadialScale = 1.0f / outerRadius;
 	
-	for(GLint i = 0; i < nStacks; i++)			// Stacks
+	GLint iVertex = 0;
+	for(GLint i = 0; i <= nStacks; i++)			// Stacks
 		{
-		float theyta;
-		float theytaNext;
-		for(GLint j = 0; j < nSlices; j++)     // Slices
+		float radius = innerRadius + (float(i)) * fStepSizeRadial;
+		GLint nRingVerts = (i == 0 && bCenter) ? 1 : nSpokes;
+
+		for(GLint j = 0; j < nRingVerts; j++)     // Slices
 			{
-			float inner = innerRadius + (float(i)) * fStepSizeRadial;
-			float outer = innerRadius + (float(i+1)) * fStepSizeRadial;
-			
-			theyta = fStepSizeSlice * float(j);
-			if(j == (nSlices - 1) && fDegrees == 360.0f)
-				theytaNext = 0.0f;
-			else
-				theytaNext = fStepSizeSlice * (float(j+1));
-				
-			// Inner First
-			vVertex[0][0] = cos(theyta) * inner;	// X	
-			vVertex[0][1] = sin(theyta) * inner;	// Y
-			vVertex[0][2] = 0.0f;					// Z
-			
-			vNormal[0][0] = 0.0f;					// Surface Normal, same for everybody
-			vNormal[0][1] = 0.0f;
-			vNormal[0][2] = 1.0f;
-			
-			vTexture[0][0] = ((vVertex[0][0] * fRadialScale) + 1.0f) * 0.5f;	
-			vTexture[0][1] = ((vVertex[0][1] * fRadialScale) + 1.0f) * 0.5f;
-			
-			// Outer First
-			vVertex[1][0] = cos(theyta) * outer;	// X	
-			vVertex[1][1] = sin(theyta) * outer;	// Y
-			vVertex[1][2] = 0.0f;					// Z
-			
-			vNormal[1][0] = 0.0f;					// Surface Normal, same for everybody
-			vNormal[1][1] = 0.0f;
-			vNormal[1][2] = 1.0f;
-			
-			vTexture[1][0] = ((vVertex[1][0] * fRadialScale) + 1.0f) * 0.5f;
-			vTexture[1][1] = ((vVertex[1][1] * fRadialScale) + 1.0f) * 0.5f;
-			
-			// Inner Second
-			vVertex[2][0] = cos(theytaNext) * inner;	// X	
-			vVertex[2][1] = sin(theytaNext) * inner;	// Y
-			vVertex[2][2] = 0.0f;					// Z
-			
-			vNormal[2][0] = 0.0f;					// Surface Normal, same for everybody
-			vNormal[2][1] = 0.0f;
-			vNormal[2][2] = 1.0f;
-			
-			vTexture[2][0] = ((vVertex[2][0] * fRadialScale) + 1.0f) * 0.5f;
-			vTexture[2][1] = ((vVertex[2][1] * fRadialScale) + 1.0f) * 0.5f;
-			
-			
-			// Outer Second
-			vVertex[3][0] = cos(theytaNext) * outer;	// X	
-			vVertex[3][1] = sin(theytaNext) * outer;	// Y
-			vVertex[3][2] = 0.0f;					// Z
-			
-			vNormal[3][0] = 0.0f;					// Surface Normal, same for everybody
-			vNormal[3][1] = 0.0f;
-			vNormal[3][2] = 1.0f;
-			
-			vTexture[3][0] = ((vVertex[3][0] * fRadialScale) + 1.0f) * 0.5f;
-			vTexture[3][1] = ((vVertex[3][1] * fRadialScale) + 1.0f) * 0.5f;
-			
-			diskBatch.AddTriangle(vVertex, vNormal, vTexture);			
-			
-			// Rearrange for next triangle
-			memcpy(vVertex[0], vVertex[1], sizeof(M3DVector3f));
-			memcpy(vNormal[0], vNormal[1], sizeof(M3DVector3f));
-			memcpy(vTexture[0], vTexture[1], sizeof(M3DVector2f));
-			
-			memcpy(vVertex[1], vVertex[3], sizeof(M3DVector3f));
-			memcpy(vNormal[1], vNormal[3], sizeof(M3DVector3f));
-			memcpy(vTexture[1], vTexture[3], sizeof(M3DVector2f));
-					
-			diskBatch.AddTriangle(vVertex, vNormal, vTexture);			
+			float theyta = fStepSizeSlice * float(j);
+			vVertex[0] = cos(theyta) * radius;	// X	
+			vVertex[1] = sin(theyta) * radius;	// Y
+			vVertex[2] = 0.0f;					// Z
+
+			vTexture[0] = ((vVertex[0] * fRadialScale) + 1.0f) * 0.5f;	
+			vTexture[1] = ((vVertex[1] * fRadialScale) + 1.0f) * 0.5f;
+
+			diskBatch.SetVertex(iVertex++, vVertex, vNormal, vTexture);
 			}
 		}
+
+	// First vertex of stack i. The collapsed center shifts everything after it.
+	GLint iRingStart = bCenter ? 1 - nSpokes : 0;
+
+	GLuint iTriangle = 0;
+	for(GLint i = 0; i < nStacks; i++)
+		for(GLint j = 0; j < nSlices; j++)
+			{
+			GLint jNext = (j + 1) % nSpokes;
+			GLuint outer = iRingStart + (i + 1) * nSpokes + j;
+			GLuint outerNext = iRingStart + (i + 1) * nSpokes + jNext;
+
+			if(i == 0 && bCenter) {
+				diskBatch.SetTriangle(iTriangle++, outer, outerNext, 0);
+				continue;
+				}
+
+			GLuint inner = iRingStart + i * nSpokes + j;
+			GLuint innerNext = iRingStart + i * nSpokes + jNext;
+			diskBatch.SetTriangle(iTriangle++, inner, outer, innerNext);
+			diskBatch.SetTriangle(iTriangle++, outer, outerNext, innerNext);
+			}
 	
 	diskBatch.End();
 	}
 
+////////////////////////////////////////////////////////////////////////////////////////
+// A flat grid in the xz plane, centered at the origin and facing +Y. Rows run
+// from +z to -z, so t increases going away from a viewer looking down -z.
+// For heightfields, see GLTerrainBatch.
+void gltMakeGrid(GLTriangleBatch& gridBatch, GLfloat fWidth, GLfloat fDepth, GLint nColumns, GLint nRows)
+	{
+	GLint nRowVerts = nColumns + 1;
+	gridBatch.BeginIndexedMesh((nRows + 1) * nRowVerts, nColumns * nRows * 6);
+
+	M3DVector3f vNormal = { 0.0f, 1.0f, 0.0f };
+	M3DVector3f vVertex;
+	M3DVector2f vTexture;
+	for(GLint j = 0; j <= nRows; j++) {
+		vTexture[1] = GLfloat(j) / GLfloat(nRows);
+		vVertex[1] = 0.0f;
+		vVertex[2] = fDepth * (0.5f - vTexture[1]);
+		for(GLint i = 0; i <= nColumns; i++) {
+			vTexture[0] = GLfloat(i) / GLfloat(nColumns);
+			vVertex[0] = fWidth * (vTexture[0] - 0.5f);
+			gridBatch.SetVertex(j * nRowVerts + i, vVertex, vNormal, vTexture);
+			}
+		}
+
+	GLuint iTriangle = 0;
+	for(GLint j = 0; j < nRows; j++)
+		for(GLint i = 0; i < nColumns; i++) {
+			GLuint v0 = j * nRowVerts + i;
+			GLuint v1 = v0 + nRowVerts;
+			gridBatch.SetTriangle(iTriangle++, v0, v0 + 1, v1);
+			gridBatch.SetTriangle(iTriangle++, v0 + 1, v1 + 1, v1);
+			}
+
+	gridBatch.End();
+	}
+
 // Draw a cylinder. Much like gluCylinder
+// The vertices are a (numStacks+1) x (numSlices+1) grid, bottom to top. The seam is
+// repeated so s can reach 1.0, even when the cylinder goes all the way around.
 void gltMakeCylinder(GLTriangleBatch& cylinderBatch, GLfloat baseRadius, GLfloat topRadius, 
 			GLfloat fLength, GLint numSlices, GLint numStacks, GLfloat fDegrees)
 	{	
@@ -409,140 +451,84 @@ void gltMakeCylinder(GLTriangleBatch& cylinderBatch, GLfloat baseRadius, GLfloat
 
 	GLfloat fStepSizeSlice = m3dDegToRad(fDegrees) / float(numSlices);
 
-	M3DVector3f vVertex[4];
-	M3DVector3f vNormal[4];
-	M3DVector2f vTexture[4];
-
-    cylinderBatch.BeginMesh(numSlices * numStacks * 6);
+    GLint nRowVerts = numSlices + 1;
+    cylinderBatch.BeginIndexedMesh((numStacks + 1) * nRowVerts, numSlices * numStacks * 6);
 
     GLfloat ds = 1.0f / float(numSlices);
 	GLfloat dt = 1.0f / float(numStacks);
-	GLfloat s;
-	GLfloat t;
 
-	for (int i = 0; i < numStacks; i++) 
+	float zNormal = 0.0f;
+	if(!m3dCloseEnough(baseRadius - topRadius, 0.0f, 0.00001f))
 		{
-		if(i == 0)			
-			t = 0.0f;
-		else
-			t = float(i) * dt;
+		// Rise over run...
+		zNormal = (baseRadius - topRadius);
+		}
 
-		float tNext;
-		if(i == (numStacks - 1))
-			tNext = 1.0f;
-		else
-			tNext = float(i+1) * dt;
-	
-		float fCurrentRadius = baseRadius + (fRadiusStep * float(i));
-		float fNextRadius = baseRadius + (fRadiusStep * float(i+1));
+	// Around the cylinder, shared by every stack
+	GLfloat *pCosTheta = new GLfloat[nRowVerts];
+	GLfloat *pSinTheta = new GLfloat[nRowVerts];
+	for (int j = 0; j <= numSlices; j++)
+		{
 		float theyta;
-		float theytaNext;
+		if(j == numSlices && fDegrees == 360.0f)
+			theyta = 0.0f;
+		else
+			theyta = fStepSizeSlice * float(j);
 
-		float fCurrentZ = float(i) * (fLength / float(numStacks)); 
-		float fNextZ = float(i+1) * (fLength / float(numStacks));
-		
-		float zNormal = 0.0f;
-		if(!m3dCloseEnough(baseRadius - topRadius, 0.0f, 0.00001f))
-			{
-			// Rise over run...
-			zNormal = (baseRadius - topRadius);
-			}
-		
-		for (int j = 0; j < numSlices; j++) 
-			{		
-			if(j == 0)
-				s = 0.0f;
-			else
-				s = float(j) * ds;
-
-			float sNext;
-			if(j == (numSlices -1))
-				sNext = 1.0f;
-			else
-				sNext = float(j+1) * ds;
+		pCosTheta[j] = cos(theyta);
+		pSinTheta[j] = sin(theyta);
+		}
 
-			theyta = fStepSizeSlice * float(j);
-			if(j == (numSlices - 1) && fDegrees == 360.0f)
-				theytaNext = 0.0f;
-			else
-				theytaNext = fStepSizeSlice * (float(j+1));
-				
-			// Inner First
-			vVertex[1][0] = cos(theyta) * fCurrentRadius;	// X	
-			vVertex[1][1] = sin(theyta) * fCurrentRadius;	// Y
-			vVertex[1][2] = fCurrentZ;						// Z
-			
-			vNormal[1][0] = vVertex[1][0];					// Surface Normal, same for everybody
-			vNormal[1][1] = vVertex[1][1];
-			vNormal[1][2] = zNormal;
-			m3dNormalizeVector3(vNormal[1]);
-			
-			vTexture[1][0] = s;					// Texture Coordinates, I have no idea...
-			vTexture[1][1] = t;
-	
-			// Outer First
-			vVertex[0][0] = cos(theyta) * fNextRadius;	// X	
-			vVertex[0][1] = sin(theyta) * fNextRadius;	// Y
-			vVertex[0][2] = fNextZ;						// Z
-			
-			if(!m3dCloseEnough(fNextRadius, 0.0f, 0.00001f)) {
-				vNormal[0][0] = vVertex[0][0];					// Surface Normal, same for everybody
-				vNormal[0][1] = vVertex[0][1];					// For cones, tip is tricky
-				vNormal[0][2] = zNormal;
-				m3dNormalizeVector3(vNormal[0]);
-				}
-			else
-				memcpy(vNormal[0], vNormal[1], sizeof(M3DVector3f));
+	gltForEachRowBand(numStacks + 1, nRowVerts, [&](GLint iFirst, GLint iLast)
+		{
+		M3DVector3f vVertex;
+		M3DVector3f vNormal;
+		M3DVector2f vTexture;
+
+		for (int i = iFirst; i < iLast; i++) 
+			{
+			float fRadius = baseRadius + (fRadiusStep * float(i));
+			float fZ = float(i) * (fLength / float(numStacks)); 
+			vTexture[1] = (i == numStacks) ? 1.0f : float(i) * dt;
+
+			// For cones, tip is tricky. It gets the normals of the stack below it.
+			float fNormalRadius = fRadius;
+			if(i > 0 && m3dCloseEnough(fRadius, 0.0f, 0.00001f))
+				fNormalRadius = baseRadius + (fRadiusStep * float(i - 1));
 		
+			for (int j = 0; j <= numSlices; j++) 
+				{		
+				vVertex[0] = pCosTheta[j] * fRadius;	// X	
+				vVertex[1] = pSinTheta[j] * fRadius;	// Y
+				vVertex[2] = fZ;						// Z
 			
-			vTexture[0][0] = s;					// Texture Coordinates, I have no idea...
-			vTexture[0][1] = tNext;
+				vNormal[0] = pCosTheta[j] * fNormalRadius;	// Surface Normal, same for everybody
+				vNormal[1] = pSinTheta[j] * fNormalRadius;
+				vNormal[2] = zNormal;
+				m3dNormalizeVector3(vNormal);
 			
-			// Inner second
-			vVertex[3][0] = cos(theytaNext) * fCurrentRadius;	// X	
-			vVertex[3][1] = sin(theytaNext) * fCurrentRadius;	// Y
-			vVertex[3][2] = fCurrentZ;						// Z
-			
-			vNormal[3][0] = vVertex[3][0];					// Surface Normal, same for everybody
-			vNormal[3][1] = vVertex[3][1];
-			vNormal[3][2] = zNormal;
-			m3dNormalizeVector3(vNormal[3]);
-
-			vTexture[3][0] = sNext;					// Texture Coordinates, I have no idea...
-			vTexture[3][1] = t;
-
-			// Outer second
-			vVertex[2][0] = cos(theytaNext) * fNextRadius;	// X	
-			vVertex[2][1] = sin(theytaNext) * fNextRadius;	// Y
-			vVertex[2][2] = fNextZ;						// Z
-			
-			if(!m3dCloseEnough(fNextRadius, 0.0f, 0.00001f)) {
-				vNormal[2][0] = vVertex[2][0];					// Surface Normal, same for everybody
-				vNormal[2][1] = vVertex[2][1];
-				vNormal[2][2] = zNormal;
-				m3dNormalizeVector3(vNormal[2]);
+				vTexture[0] = (j == numSlices) ? 1.0f : float(j) * ds;	// Texture Coordinates, I have no idea...
+
+				cylinderBatch.SetVertex(i * nRowVerts + j, vVertex, vNormal, vTexture);
 				}
-			else
-				memcpy(vNormal[2], vNormal[3], sizeof(M3DVector3f));
-				
 
-			vTexture[2][0] = sNext;					// Texture Coordinates, I have no idea...
-			vTexture[2][1] = tNext;
-		
-			cylinderBatch.AddTriangle(vVertex, vNormal, vTexture);			
-			
-			// Rearrange for next triangle
-			memcpy(vVertex[0], vVertex[1], sizeof(M3DVector3f));
-			memcpy(vNormal[0], vNormal[1], sizeof(M3DVector3f));
-			memcpy(vTexture[0], vTexture[1], sizeof(M3DVector2f));
-			
-			memcpy(vVertex[1], vVertex[3], sizeof(M3DVector3f));
-			memcpy(vNormal[1], vNormal[3], sizeof(M3DVector3f));
-			memcpy(vTexture[1], vTexture[3], sizeof(M3DVector2f));
-					
-			cylinderBatch.AddTriangle(vVertex, vNormal, vTexture);			
+			if(i == numStacks)
+				continue;
+
+			GLuint iTriangle = i * numSlices * 2;
+			for (int j = 0; j < numSlices; j++)
+				{
+				GLuint v0 = i * nRowVerts + j;		// This stack
+				GLuint v1 = v0 + nRowVerts;			// The one above it
+				cylinderBatch.SetTriangle(iTriangle++, v1, v0, v1 + 1);
+				cylinderBatch.SetTriangle(iTriangle++, v0, v0 + 1, v1 + 1);
+				}
 			}
-        }
+		});
+
+	delete [] pCosTheta;
+	delete [] pSinTheta;
+
 	cylinderBatch.End();
 	}
 	
@@ -555,162 +541,264 @@ void gltMakeCube(GLBatch& cubeBatch, GLfloat fRadius )
             
     /////////////////////////////////////////////
     // Top of cube
-    cubeBatch.Normal3f(0.0f, fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, 1.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, 1.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, 1.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, 1.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, 1.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, 1.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, fRadius);
     
     
     ////////////////////////////////////////////
     // Bottom of cube
-    cubeBatch.Normal3f(0.0f, -fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, -1.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, -fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, -1.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, -fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, -1.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, -fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, -fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, -1.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, -fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, -fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, -1.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, -fRadius, 0.0f);
+    cubeBatch.Normal3f(0.0f, -1.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, -fRadius, fRadius);
     
     ///////////////////////////////////////////
     // Left side of cube
-    cubeBatch.Normal3f(-fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(-1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(-fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(-1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(-fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(-fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(-1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(-fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(-1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(-fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(-1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(-fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(-1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, -fRadius, fRadius);
     
     // Right side of cube
-    cubeBatch.Normal3f(fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(fRadius, -fRadius, fRadius);
     
-    cubeBatch.Normal3f(fRadius, 0.0f, 0.0f);
+    cubeBatch.Normal3f(1.0f, 0.0f, 0.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(fRadius, -fRadius, -fRadius);
     
     // Front and Back
     // Front
-    cubeBatch.Normal3f(0.0f, 0.0f, fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, 1.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(fRadius, -fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, 1.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, 1.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, 1.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, 1.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, -fRadius, fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, 1.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(fRadius, -fRadius, fRadius);
     
     // Back
-    cubeBatch.Normal3f(0.0f, 0.0f, -fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, -1.0f);
     cubeBatch.TexCoord2f(fRadius, 0.0f);
     cubeBatch.Vertex3f(fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, -fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, -1.0f);
     cubeBatch.TexCoord2f(0.0f, 0.0f);
     cubeBatch.Vertex3f(-fRadius, -fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, -fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, -1.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, -fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, -1.0f);
     cubeBatch.TexCoord2f(0.0f, fRadius);
     cubeBatch.Vertex3f(-fRadius, fRadius, -fRadius);
     
-    cubeBatch.Normal3f(0.0f, 0.0f, -fRadius);
+    cubeBatch.Normal3f(0.0f, 0.0f, -1.0f);
     cubeBatch.TexCoord2f(fRadius, fRadius);
     cubeBatch.Vertex3f(fRadius, fRadius, -fRadius);
 
-	cubeBatch.Normal3f(0.0f, 0.0f, -fRadius);
+	cubeBatch.Normal3f(0.0f, 0.0f, -1.0f);
 	cubeBatch.TexCoord2f(fRadius, 0.0f);
 	cubeBatch.Vertex3f(fRadius, -fRadius, -fRadius);   
     cubeBatch.End();
 	}	
 
 
+//////////////////////////////////////////////////////////////////////////////////////
+// Each face of the cube is described by its normal, and two edge directions
+// whose cross product is that normal, so corners walked in texture coordinate
+// order wind counter-clockwise when seen from outside.
+static const GLfloat cubeFaces[6][3][3] = {
+    { {  1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f,  0.0f } },     // +X
+    { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f,  1.0f }, { 0.0f, 1.0f,  0.0f } },     // -X
+    { { 0.0f,  1.0f, 0.0f }, { 1.0f, 0.0f,  0.0f }, { 0.0f, 0.0f, -1.0f } },     // +Y
+    { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f,  0.0f }, { 0.0f, 0.0f,  1.0f } },     // -Y
+    { { 0.0f, 0.0f,  1.0f }, { 1.0f, 0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f } },     // +Z
+    { { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f,  0.0f } } };   // -Z
+
+static const GLfloat cubeCornerST[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+// Corner c of face f, on a cube with the given "radius"
+static inline void gltCubeCorner(M3DVector3f vCorner, int f, int c, GLfloat fRadius)
+    {
+    GLfloat s = cubeCornerST[c][0] * 2.0f - 1.0f;
+    GLfloat t = cubeCornerST[c][1] * 2.0f - 1.0f;
+    for(int i = 0; i < 3; i++)
+        vCorner[i] = (cubeFaces[f][0][i] + s * cubeFaces[f][1][i] + t * cubeFaces[f][2][i]) * fRadius;
+    }
+
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Make an indexed cube, centered at the origin, and with a specified "radius".
+// Faces don't share vertices (the normals differ), so that's 24 vertices and
+// 36 indexes. Texture coordinates run 0 to 1 across each face.
+void gltMakeCube(GLTriangleBatch& cubeBatch, GLfloat fRadius)
+    {
+    cubeBatch.BeginIndexedMesh(24, 36);
+
+    M3DVector3f vVertex;
+    for(int f = 0; f < 6; f++) {
+        for(int c = 0; c < 4; c++) {
+            gltCubeCorner(vVertex, f, c, fRadius);
+            cubeBatch.SetVertex(f * 4 + c, vVertex, cubeFaces[f][0], cubeCornerST[c]);
+            }
+
+        cubeBatch.SetTriangle(f * 2, f * 4, f * 4 + 1, f * 4 + 2);
+        cubeBatch.SetTriangle(f * 2 + 1, f * 4, f * 4 + 2, f * 4 + 3);
+        }
+
+    cubeBatch.End();
+    }
+
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Positions only, for depth and shadow passes where normals and texture
+// coordinates are never read. The eight corners are shared by every face.
+// Corner i is at +fRadius on x, y and z for bits 0, 1 and 2 of i.
+void gltMakeCubePositions(GLTriangleBatch& cubeBatch, GLfloat fRadius)
+    {
+    cubeBatch.BeginIndexedMesh(8, 36, false, false);
+
+    for(GLuint i = 0; i < 8; i++) {
+        M3DVector3f vVertex = { (i & 1) ? fRadius : -fRadius,
+                                (i & 2) ? fRadius : -fRadius,
+                                (i & 4) ? fRadius : -fRadius };
+        cubeBatch.SetVertex(i, vVertex);
+        }
+
+    // Same faces and winding as the full cube
+    GLuint iCorner[4];
+    M3DVector3f vCorner;
+    for(int f = 0; f < 6; f++) {
+        for(int c = 0; c < 4; c++) {
+            gltCubeCorner(vCorner, f, c, 1.0f);
+            iCorner[c] = (vCorner[0] > 0.0f ? 1 : 0) | (vCorner[1] > 0.0f ? 2 : 0) | (vCorner[2] > 0.0f ? 4 : 0);
+            }
+
+        cubeBatch.SetTriangle(f * 2, iCorner[0], iCorner[1], iCorner[2]);
+        cubeBatch.SetTriangle(f * 2 + 1, iCorner[0], iCorner[2], iCorner[3]);
+        }
+
+    cubeBatch.End();
+    }
+
+
+//////////////////////////////////////////////////////////////////////////////////////
+// A unit cube (-1 to 1) set up to draw many boxes with one call, using the
+// GLT_SHADER_INSTANCED_BOX stock shader. Fill in the boxes with
+// gltSetBoxInstances() whenever they change, then call DrawInstanced().
+void gltMakeInstancedCube(GLTriangleBatch& cubeBatch)
+    {
+    gltMakeCube(cubeBatch, 1.0f);
+
+    GLsizei nStride = sizeof(GLTBoxInstance);
+    cubeBatch.SetInstanceAttribute(GLT_ATTRIBUTE_INSTANCE_CENTER, 3, nStride, offsetof(GLTBoxInstance, vCenter));
+    cubeBatch.SetInstanceAttribute(GLT_ATTRIBUTE_INSTANCE_EXTENT, 3, nStride, offsetof(GLTBoxInstance, vHalfExtent));
+    cubeBatch.SetInstanceAttribute(GLT_ATTRIBUTE_INSTANCE_COLOR, 4, nStride, offsetof(GLTBoxInstance, vColor));
+    }
+
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Replace the boxes drawn by an instanced cube
+void gltSetBoxInstances(GLTriangleBatch& cubeBatch, const GLTBoxInstance *pBoxes, GLsizei nBoxes)
+    {
+    cubeBatch.CopyInstanceData(pBoxes, sizeof(GLTBoxInstance) * nBoxes);
+    }
+
+
 
 // Define targa header. This is only used locally.
 #pragma pack(1)
@@ -899,7 +987,7 @@ GLbyte *gltReadTGABits(const char *szFileName, GLint *iWidth, GLint *iHeight, GL
 			*eFormat = GL_RGB;
             *iComponents = GL_RGB;
 			// Swap R and B
-			for (unsigned int i = 0; i < lImageSize * 3; i++) {
+			for (unsigned int i = 0; i < lImageSize; i += 3) {
 				GLbyte r = pBits[i];
 				pBits[i] = pBits[i + 2];
 				pBits[i + 2] = r;
@@ -1024,14 +1112,6 @@ GLbyte* gltReadBMPBits(const char *szFileName, int *nWidth, int *nHeight)
 #include <TargetConditionals.h>
 #if !(TARGET_OS_IPHONE | TARGET_IPHONE_SIMULATOR)
 */
-// Rather than malloc/free a block everytime a shader must be loaded,
-// I will dedicate a single 4k page for reading in shaders. Thanks to
-// modern OS design, this page will be swapped out to disk later if never
-// used again after program initialization. Where-as mallocing different size
-// shader blocks could lead to heap fragmentation, which would actually be worse.
-//#define MAX_SHADER_LENGTH   8192  -> This is defined in gltools.h
-static GLubyte shaderText[MAX_SHADER_LENGTH];
-
 //////////////////////////////////////////////////////////////////////////
 // Load the shader from the source text
 void GLTools::gltLoadShaderSrc(const char *szShaderSrc, GLuint shader)
@@ -1042,391 +1122,443 @@ void GLTools::gltLoadShaderSrc(const char *szShaderSrc, GLuint shader)
     glShaderSource(shader, 1, (const GLchar **)fsStringPtr, NULL);
 	}
 
+// Same, but the length is already known, and the text needn't be terminated
+void GLTools::gltLoadShaderSrc(const char *szShaderSrc, GLint nLength, GLuint shader)
+	{
+    const GLchar *fsStringPtr[1] = { szShaderSrc };
+    glShaderSource(shader, 1, fsStringPtr, &nLength);
+	}
+
 
 ////////////////////////////////////////////////////////////////
-// Load the shader from the specified file. Returns false if the
-// shader could not be loaded
-bool GLTools::gltLoadShaderFile(const char *szFile, GLuint shader)
+// Read the shader text from the specified file, in one go. There's no
+// size limit, and nothing shared, so loader threads can all use it at
+// once. Returns false if the shader could not be loaded
+bool GLTools::gltReadShaderFile(const char *szFile, std::string& strSource)
 	{
-    char szShaderLine[128];
-    
-    size_t shaderLength = 0;
 	uint fileLength = 0;
 	uint offset = 0;
-    FILE *fp;
-	
-    // Open the shader file
 
-    fp = fileopen(szFile, "r", &offset, &fileLength );
-    shaderText[0] = 0x0;
-    if(fp != NULL)
-		{
-        // Get a line at a time
-        while (fgets(szShaderLine, 128, fp) != nullptr  && ( ftell ( fp ) - offset ) <= fileLength) {
-            shaderLength+= strlen(szShaderLine);
-
-            if(shaderLength < MAX_SHADER_LENGTH)
-                strncat((char *)shaderText, szShaderLine, MAX_SHADER_LENGTH - shaderLength);
-            else {
-                fclose(fp);
-                return false;
-                }
-			}
-		
-        // Make sure it is null terminated and close the file
-        shaderText[shaderLength] = '\0';
+    FILE *fp = fileopen(szFile, "rb", &offset, &fileLength);
+    if(fp == NULL)
+        return false;
+
+    // A plain file doesn't say how long it is. One packed in with others does,
+    // and is already positioned at its start.
+    if(fileLength == 0) {
+        long start = ftell(fp);
+        if(start < 0 || fseek(fp, 0, SEEK_END) != 0) {
+            fclose(fp);
+            return false;
+            }
+        long end = ftell(fp);
+        fseek(fp, start, SEEK_SET);
+        fileLength = (end > start) ? (uint)(end - start) : 0;
+        }
 
+    strSource.resize(fileLength);
+    size_t nRead = (fileLength > 0) ? fread(&strSource[0], 1, fileLength, fp) : 0;
+    strSource.resize(nRead);
+    bool bError = ferror(fp) != 0;
 
+    fclose(fp);
+    return !bError;
+	}
 
-		}
-    else
-        return false;    
 
-    fclose(fp);
+////////////////////////////////////////////////////////////////
+// Load the shader from the specified file. Returns false if the
+// shader could not be loaded
+bool GLTools::gltLoadShaderFile(const char *szFile, GLuint shader)
+	{
+    std::string strSource;
+    if(!gltReadShaderFile(szFile, strSource))
+        return false;
 
     // Load the string
-    gltLoadShaderSrc((const char *)shaderText, shader);
-    
+    gltLoadShaderSrc(strSource.data(), (GLint)strSource.size(), shader);
     return true;
 	}   
 
 
 /////////////////////////////////////////////////////////////////
 // Load a pair of shaders, compile, and link together. Specify the complete
-// source text for each shader. After the shader names, specify the number
+// file path for each shader. After the shader names, specify the number
 // of attributes, followed by the index and attribute name of each attribute
 GLuint GLTools::gltLoadShaderPairWithAttributes(const char *szVertexProg, const char *szFragmentProg, ...)
-	{
-    // Temporary Shader objects
-    GLuint hVertexShader;
-    GLuint hFragmentShader; 
-    GLuint hReturn = 0;   
-    GLint testVal;
-	
-    // Create shader objects
-    hVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	
-    // Load them. If fail clean up and return null
-    // Vertex Program
-    if(gltLoadShaderFile(szVertexProg, hVertexShader) == false)
-		{
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-		LOG_ERROR("gltLoadShaderPairWithAttributes: The shader at %s could ot be found.\n", szVertexProg);
-        return (GLuint)NULL;
-		}
-	
-    // Fragment Program
-    if(gltLoadShaderFile(szFragmentProg, hFragmentShader) == false)
-		{
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-		LOG_ERROR("gltLoadShaderPairWithAttributes: The shader at %s  could not be found.\n", szFragmentProg);
-        return (GLuint)NULL;
-		}
-    
-    // Compile them both
-    glCompileShader(hVertexShader);
-    glCompileShader(hFragmentShader);
-    
-    // Check for errors in vertex shader
-    glGetShaderiv(hVertexShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetShaderInfoLog(hVertexShader, 1024, NULL, infoLog);
-		LOG_ERROR("gltLoadShaderPairWithAttributes: The shader at %s failed to compile with the following error:\n%s\n", szVertexProg, infoLog);
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Check for errors in fragment shader
-    glGetShaderiv(hFragmentShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetShaderInfoLog(hFragmentShader, 1024, NULL, infoLog);
-		LOG_ERROR("gltLoadShaderPairWithAttributes: The shader at %s failed to compile with the following error:\n%s\n", szFragmentProg, infoLog);
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Create the final program object, and attach the shaders
-    hReturn = glCreateProgram();
-    glAttachShader(hReturn, hVertexShader);
-    glAttachShader(hReturn, hFragmentShader);
-
+    {
+    GLint iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+    const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
 
-    // Now, we need to bind the attribute names to their specific locations
-	// List of attributes
-	va_list attributeList;
-	va_start(attributeList, szFragmentProg);
-
-    // Iterate over this argument list
-	char *szNextArg;
-	int iArgCount = va_arg(attributeList, int);	// Number of attributes
-	for(int i = 0; i < iArgCount; i++)
-		{
-		int index = va_arg(attributeList, int);
-		szNextArg = va_arg(attributeList, char*);
-		glBindAttribLocation(hReturn, index, szNextArg);
-		}
-	va_end(attributeList);
+    va_list attributeList;
+    va_start(attributeList, szFragmentProg);
+    GLint nAttributes = gltGetShaderAttributes(attributeList, iIndexes, szNames);
+    va_end(attributeList);
 
-    // Attempt to link    
-    glLinkProgram(hReturn);
-	
-    // These are no longer needed
-    glDeleteShader(hVertexShader);
-    glDeleteShader(hFragmentShader);  
-    
-    // Make sure link worked too
-    glGetProgramiv(hReturn, GL_LINK_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetProgramInfoLog(hReturn, 1024, NULL, infoLog);
-		LOG_ERROR("gltLoadShaderPairWithAttributes: The programs %s and %s failed to link with the following errors:\n%s\n",
-				  szVertexProg, szFragmentProg, infoLog);
-		glDeleteProgram(hReturn);
-		return (GLuint)NULL;
-		}
-    
-    // All done, return our ready to use shader program
-    return hReturn;  
-	}   
+    return gltLoadShaderPairFiles(szVertexProg, szFragmentProg, nAttributes, iIndexes, szNames);
+    }
 
 /////////////////////////////////////////////////////////////////
 // Load a pair of shaders, compile, and link together. Specify the complete
 // file path for each shader. Note, there is no support for
 // just loading say a vertex program... you have to do both.
 GLuint GLTools::gltLoadShaderPair(const char *szVertexProg, const char *szFragmentProg)
-	{
-    // Temporary Shader objects
-    GLuint hVertexShader;
-    GLuint hFragmentShader; 
-    GLuint hReturn = 0;   
-    GLint testVal;
-	
-    // Create shader objects
-    hVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	
-    // Load them. If fail clean up and return null
-    if(gltLoadShaderFile(szVertexProg, hVertexShader) == false)
-		{
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-	
-    if(gltLoadShaderFile(szFragmentProg, hFragmentShader) == false)
-		{
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Compile them
-    glCompileShader(hVertexShader);
-    glCompileShader(hFragmentShader);
-    
-    // Check for errors in vertex shader
-    glGetShaderiv(hVertexShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetShaderInfoLog(hVertexShader, 1024, NULL, infoLog);
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Check for errors in fragment shader
-    glGetShaderiv(hFragmentShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetShaderInfoLog(hFragmentShader, 1024, NULL, infoLog);
-		fprintf(stderr, "The shader at %s failed to compile with the following error:\n%s\n", szFragmentProg, infoLog);
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Link them - assuming it works...
-    hReturn = glCreateProgram();
-    glAttachShader(hReturn, hVertexShader);
-    glAttachShader(hReturn, hFragmentShader);
-
-    glLinkProgram(hReturn);
-	
-    // These are no longer needed
-    glDeleteShader(hVertexShader);
-    glDeleteShader(hFragmentShader);  
-    
-    // Make sure link worked too
-    glGetProgramiv(hReturn, GL_LINK_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		glDeleteProgram(hReturn);
-		return (GLuint)NULL;
-		}
-    
-    return hReturn;  
-	}   
+    {
+    return gltLoadShaderPairFiles(szVertexProg, szFragmentProg, 0, NULL, NULL);
+    }
 
 /////////////////////////////////////////////////////////////////
 // Load a pair of shaders, compile, and link together. Specify the complete
-// file path for each shader. Note, there is no support for
+// source text for each shader. Note, there is no support for
 // just loading say a vertex program... you have to do both.
 GLuint GLTools::gltLoadShaderPairSrc(const char *szVertexSrc, const char *szFragmentSrc)
-	{
-    // Temporary Shader objects
+    {
+    return gltBuildProgram(szVertexSrc, szFragmentSrc, 0, NULL, NULL);
+    }
+
+/////////////////////////////////////////////////////////////////
+// Load a pair of shaders, compile, and link together. Specify the complete
+// source code text for each shader. Note, there is no support for
+// just loading say a vertex program... you have to do both.
+GLuint GLTools::gltLoadShaderPairSrcWithAttributes(const char *szVertexSrc, const char *szFragmentSrc, ...)
+    {
+    GLint iIndexes[GLT_MAX_SHADER_ATTRIBUTES];
+    const char *szNames[GLT_MAX_SHADER_ATTRIBUTES];
+
+    va_list attributeList;
+    va_start(attributeList, szFragmentSrc);
+    GLint nAttributes = gltGetShaderAttributes(attributeList, iIndexes, szNames);
+    va_end(attributeList);
+
+    return gltBuildProgram(szVertexSrc, szFragmentSrc, nAttributes, iIndexes, szNames);
+    }
+
+
+/////////////////////////////////////////////////////////////////
+GLint gltGetShaderAttributes(va_list attributeList, GLint *pIndexes, const char **pNames)
+    {
+    GLint nKept = 0;
+    int iArgCount = va_arg(attributeList, int);	// Number of attributes
+    for(int i = 0; i < iArgCount; i++) {
+        int index = va_arg(attributeList, int);
+        const char *szName = va_arg(attributeList, char*);
+        if(nKept < GLT_MAX_SHADER_ATTRIBUTES) {
+            pIndexes[nKept] = index;
+            pNames[nKept] = szName;
+            nKept++;
+            }
+        }
+
+    return nKept;
+    }
+
+
+/////////////////////////////////////////////////////////////////
+// Read both files, then build them the same as source text
+GLuint GLTools::gltLoadShaderPairFiles(const char *szVertexProg, const char *szFragmentProg, GLint nAttributes,
+                                       const GLint *pIndexes, const char * const *pNames)
+    {
+    std::string strVertexSrc, strFragmentSrc;
+
+    if(!gltReadShaderFile(szVertexProg, strVertexSrc)) {
+        LOG_ERROR("gltLoadShaderPairFiles: The shader at %s could not be found.\n", szVertexProg);
+        return 0;
+        }
+
+    if(!gltReadShaderFile(szFragmentProg, strFragmentSrc)) {
+        LOG_ERROR("gltLoadShaderPairFiles: The shader at %s could not be found.\n", szFragmentProg);
+        return 0;
+        }
+
+    return gltBuildProgram(strVertexSrc.c_str(), strFragmentSrc.c_str(), nAttributes, pIndexes, pNames,
+                           szVertexProg, szFragmentProg);
+    }
+
+
+/////////////////////////////////////////////////////////////////
+// Compile both shaders, bind the attributes, and link. If there's a program
+// cache, look there first, and put the result there afterwards. Nothing is
+// checked until after the link, so the driver isn't made to stop and wait
+// in between. If the link failed, the compile logs say why.
+GLuint GLTools::gltBuildProgram(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+                                const GLint *pIndexes, const char * const *pNames,
+                                const char *szVertexName, const char *szFragmentName)
+    {
     GLuint hVertexShader;
-    GLuint hFragmentShader; 
-    GLuint hReturn = 0;   
+    GLuint hFragmentShader;
+    GLuint hReturn = 0;
     GLint testVal;
-	
-    // Create shader objects
+
+    // A binary the driver still accepts saves the whole compile
+    uint64_t key = 0;
+    bool bCache = gltGetProgramCacheKey(szVertexSrc, szFragmentSrc, nAttributes, pIndexes, pNames, key);
+    if(bCache) {
+        hReturn = gltLoadProgramBinary(key);
+        if(hReturn != 0)
+            return hReturn;
+        }
+
+    // Create shader objects, load them, and compile them
     hVertexShader = glCreateShader(GL_VERTEX_SHADER);
     hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	
-    // Load them. 
+
     gltLoadShaderSrc(szVertexSrc, hVertexShader);
     gltLoadShaderSrc(szFragmentSrc, hFragmentShader);
-   
-    // Compile them
+
     glCompileShader(hVertexShader);
     glCompileShader(hFragmentShader);
-    
-    // Check for errors
-    glGetShaderiv(hVertexShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    glGetShaderiv(hFragmentShader, GL_COMPILE_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Link them - assuming it works...
+
+    // Create the final program object, and attach the shaders
     hReturn = glCreateProgram();
     glAttachShader(hReturn, hVertexShader);
     glAttachShader(hReturn, hFragmentShader);
+
+    // Now, we need to bind the attribute names to their specific locations
+    for(GLint i = 0; i < nAttributes; i++)
+        glBindAttribLocation(hReturn, pIndexes[i], pNames[i]);
+
+#ifndef __EMSCRIPTEN__
+    if(bCache)
+        glProgramParameteri(hReturn, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+
     glLinkProgram(hReturn);
-	
-    // These are no longer needed
-    glDeleteShader(hVertexShader);
-    glDeleteShader(hFragmentShader);  
-    
-    // Make sure link worked too
+
+    // Make sure link worked
     glGetProgramiv(hReturn, GL_LINK_STATUS, &testVal);
     if(testVal == GL_FALSE)
-		{
-		glDeleteProgram(hReturn);
-		return (GLuint)NULL;
-		}
-    
-    return hReturn;  
-	}   
+        {
+        gltLogProgramErrors(hReturn, hVertexShader, hFragmentShader, szVertexName, szFragmentName);
+        glDeleteProgram(hReturn);
+        hReturn = 0;
+        }
+    else if(bCache)
+        gltSaveProgramBinary(hReturn, key);
+
+    // These are no longer needed
+    glDeleteShader(hVertexShader);
+    glDeleteShader(hFragmentShader);
+
+    // All done, return our ready to use shader program
+    return hReturn;
+    }
+
 
 /////////////////////////////////////////////////////////////////
-// Load a pair of shaders, compile, and link together. Specify the complete
-// source code text for each shader. Note, there is no support for
-// just loading say a vertex program... you have to do both.
-GLuint GLTools::gltLoadShaderPairSrcWithAttributes(const char *szVertexSrc, const char *szFragmentSrc, ...)
-	{
-    // Temporary Shader objects
-    GLuint hVertexShader;
-    GLuint hFragmentShader; 
-    GLuint hReturn = 0;   
+void GLTools::gltLogProgramErrors(GLuint hProgram, GLuint hVertexShader, GLuint hFragmentShader,
+                                  const char *szVertexName, const char *szFragmentName)
+    {
+    char infoLog[1024];
     GLint testVal;
-	
-    // Create shader objects
-    hVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	
-    // Load them. 
-    gltLoadShaderSrc(szVertexSrc, hVertexShader);
-    gltLoadShaderSrc(szFragmentSrc, hFragmentShader);
-   
-    // Compile them
-    glCompileShader(hVertexShader);
-    glCompileShader(hFragmentShader);
-    
-    // Check for errors in vertex shader
+
+    if(szVertexName == NULL)
+        szVertexName = "(vertex source)";
+    if(szFragmentName == NULL)
+        szFragmentName = "(fragment source)";
+
     glGetShaderiv(hVertexShader, GL_COMPILE_STATUS, &testVal);
     if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetShaderInfoLog(hVertexShader, 1024, NULL, infoLog);
-		fprintf(stderr, "The shader %s failed to compile with the following error:\n%s\n", szVertexSrc, infoLog);
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Check for errors in fragment shader
+        {
+        glGetShaderInfoLog(hVertexShader, 1024, NULL, infoLog);
+        LOG_ERROR("The shader %s failed to compile with the following error:\n%s\n", szVertexName, infoLog);
+        return;
+        }
+
     glGetShaderiv(hFragmentShader, GL_COMPILE_STATUS, &testVal);
     if(testVal == GL_FALSE)
-		{
-		char infoLog[1024];
-		glGetShaderInfoLog(hFragmentShader, 1024, NULL, infoLog);
-		printf("The shader %s failed to compile with the following error:\n%s\n", szFragmentSrc, infoLog);
-        glDeleteShader(hVertexShader);
-        glDeleteShader(hFragmentShader);
-        return (GLuint)NULL;
-		}
-    
-    // Link them - assuming it works...
-    hReturn = glCreateProgram();
-    glAttachShader(hReturn, hVertexShader);
-    glAttachShader(hReturn, hFragmentShader);
+        {
+        glGetShaderInfoLog(hFragmentShader, 1024, NULL, infoLog);
+        LOG_ERROR("The shader %s failed to compile with the following error:\n%s\n", szFragmentName, infoLog);
+        return;
+        }
 
-	// List of attributes
-	va_list attributeList;
-	va_start(attributeList, szFragmentSrc);
+    glGetProgramInfoLog(hProgram, 1024, NULL, infoLog);
+    LOG_ERROR("The programs %s and %s failed to link with the following errors:\n%s\n",
+              szVertexName, szFragmentName, infoLog);
+    }
 
-	char *szNextArg;
-	int iArgCount = va_arg(attributeList, int);	// Number of attributes
-	for(int i = 0; i < iArgCount; i++)
-		{
-		int index = va_arg(attributeList, int);
-		szNextArg = va_arg(attributeList, char*);
-		glBindAttribLocation(hReturn, index, szNextArg);
-		}
-	va_end(attributeList);
 
+/////////////////////////////////////////////////////////////////
+bool GLTools::gltIsExtensionSupported(const char *szExtension)
+    {
+    GLint nExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+    for(GLint i = 0; i < nExtensions; i++) {
+        const char *szName = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if(szName != NULL && strcmp(szName, szExtension) == 0)
+            return true;
+        }
 
-    glLinkProgram(hReturn);
-	
-    // These are no longer needed
-    glDeleteShader(hVertexShader);
-    glDeleteShader(hFragmentShader);  
-    
-    // Make sure link worked too
-    glGetProgramiv(hReturn, GL_LINK_STATUS, &testVal);
-    if(testVal == GL_FALSE)
-		{
-		glDeleteProgram(hReturn);
-		return (GLuint)NULL;
-		}
-    
-    return hReturn;  
-	}   
+    return false;
+    }
+
+
+/////////////////////////////////////////////////////////////////
+// Program cache. Each file is a header, then the driver's binary.
+#define GLT_PROGRAM_MAGIC       0x50544c47      // "GLTP"
+#define GLT_PROGRAM_VERSION     1
+
+struct GLTPROGRAMHEADER {
+    uint32_t    uiMagic;
+    uint32_t    uiVersion;
+    uint64_t    key;
+    uint64_t    checksum;           // Of the binary
+    uint32_t    eFormat;
+    uint32_t    nLength;
+    };
+
+void GLTools::gltSetProgramCacheDirectory(const char *szDirectory)
+    {
+    if(szDirectory == NULL) {
+        szProgramCacheDirectory[0] = '\0';
+        return;
+        }
+
+    strncpy(szProgramCacheDirectory, szDirectory, MAX_CACHE_PATH_LENGTH);
+    szProgramCacheDirectory[MAX_CACHE_PATH_LENGTH-1] = '\0';
+    }
 
+// Everything that changes what the driver would build. The terminators
+// go in too, so moving text from one string to the next changes the key.
+bool GLTools::gltGetProgramCacheKey(const char *szVertexSrc, const char *szFragmentSrc, GLint nAttributes,
+                                    const GLint *pIndexes, const char * const *pNames, uint64_t& key)
+    {
+    if(szProgramCacheDirectory[0] == '\0')
+        return false;
+
+    if(driverHash == 0) {
+        const GLenum eStrings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        uint64_t hash = GLT_HASH_SEED;
+        for(int i = 0; i < 3; i++) {
+            const char *szString = (const char *)glGetString(eStrings[i]);
+            if(szString != NULL)
+                hash = gltHashBytes(szString, strlen(szString) + 1, hash);
+            }
+        driverHash = hash;
+
+        // WebGL doesn't do program binaries at all
+        nBinaryFormats = 0;
+#ifndef __EMSCRIPTEN__
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nBinaryFormats);
+#endif
+        }
+
+    if(nBinaryFormats <= 0)
+        return false;
+
+    key = gltHashBytes(&driverHash, sizeof(driverHash));
+    key = gltHashBytes(szVertexSrc, strlen(szVertexSrc) + 1, key);
+    key = gltHashBytes(szFragmentSrc, strlen(szFragmentSrc) + 1, key);
+    for(GLint i = 0; i < nAttributes; i++) {
+        key = gltHashBytes(&pIndexes[i], sizeof(GLint), key);
+        key = gltHashBytes(pNames[i], strlen(pNames[i]) + 1, key);
+        }
 
+    return true;
+    }
+
+bool GLTools::gltGetProgramCacheFileName(uint64_t key, char *szFileName, size_t nLength)
+    {
+    if(szProgramCacheDirectory[0] == '\0')
+        return false;
+
+    snprintf(szFileName, nLength, "%s/program_%016llx.bin", szProgramCacheDirectory, (unsigned long long)key);
+    return true;
+    }
+
+// Returns 0 if it isn't there, or the driver won't take it. A bad file
+// is removed so it gets replaced.
+GLuint GLTools::gltLoadProgramBinary(uint64_t key)
+    {
+#ifdef __EMSCRIPTEN__
+    (void)key;
+    return 0;
+#else
+    char szFileName[MAX_CACHE_PATH_LENGTH + 64];
+    if(!gltGetProgramCacheFileName(key, szFileName, sizeof(szFileName)))
+        return 0;
+
+    FILE *pFile = fopen(szFileName, "rb");
+    if(pFile == NULL)
+        return 0;
+
+    GLTPROGRAMHEADER header;
+    std::vector<unsigned char> binary;
+    bool bValid = fread(&header, sizeof(GLTPROGRAMHEADER), 1, pFile) == 1 &&
+                  header.uiMagic == GLT_PROGRAM_MAGIC && header.uiVersion == GLT_PROGRAM_VERSION &&
+                  header.key == key && header.nLength > 0;
+    if(bValid) {
+        binary.resize(header.nLength);
+        bValid = fread(binary.data(), 1, header.nLength, pFile) == header.nLength &&
+                 gltHashBytes(binary.data(), header.nLength) == header.checksum;
+        }
+    fclose(pFile);
+
+    GLuint hProgram = 0;
+    if(bValid) {
+        GLint testVal;
+        hProgram = glCreateProgram();
+        glProgramBinary(hProgram, header.eFormat, binary.data(), header.nLength);
+        glGetProgramiv(hProgram, GL_LINK_STATUS, &testVal);
+        if(testVal == GL_FALSE) {
+            glDeleteProgram(hProgram);
+            hProgram = 0;
+            }
+        }
+
+    if(hProgram == 0)
+        remove(szFileName);
+    return hProgram;
+#endif
+    }
+
+// Written to the side and renamed, so nobody ever reads half a file
+void GLTools::gltSaveProgramBinary(GLuint program, uint64_t key)
+    {
+#ifdef __EMSCRIPTEN__
+    (void)program;
+    (void)key;
+#else
+    char szFileName[MAX_CACHE_PATH_LENGTH + 64];
+    char szTempName[MAX_CACHE_PATH_LENGTH + 72];
+    if(!gltGetProgramCacheFileName(key, szFileName, sizeof(szFileName)))
+        return;
+
+    GLint nLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &nLength);
+    if(nLength <= 0)
+        return;
+
+    std::vector<unsigned char> binary(nLength);
+    GLsizei nWritten = 0;
+    GLenum eFormat = 0;
+    glGetProgramBinary(program, nLength, &nWritten, &eFormat, binary.data());
+    if(nWritten <= 0)
+        return;
+
+    GLTPROGRAMHEADER header;
+    header.uiMagic = GLT_PROGRAM_MAGIC;
+    header.uiVersion = GLT_PROGRAM_VERSION;
+    header.key = key;
+    header.checksum = gltHashBytes(binary.data(), nWritten);
+    header.eFormat = eFormat;
+    header.nLength = (uint32_t)nWritten;
+
+    snprintf(szTempName, sizeof(szTempName), "%s.tmp", szFileName);
+    FILE *pFile = fopen(szTempName, "wb");
+    if(pFile == NULL)
+        return;
+
+    bool bWritten = fwrite(&header, sizeof(GLTPROGRAMHEADER), 1, pFile) == 1 &&
+                    fwrite(binary.data(), 1, nWritten, pFile) == (size_t)nWritten;
+    if(fclose(pFile) != 0)
+        bWritten = false;
+
+    remove(szFileName);
+    if(!bWritten || rename(szTempName, szFileName) != 0)
+        remove(szTempName);
+#endif
+    }
 
 
 /////////////////////////////////////////////////////////////////
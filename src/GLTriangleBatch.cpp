@@ -56,7 +56,12 @@ GLTriangleBatch::GLTriangleBatch(void)
     nNumIndexes = 0;
     nNumVerts = 0;
     
+    indexType = GL_UNSIGNED_SHORT;
     bMadeStuff = false;
+    vertexArrayBufferObject = 0;
+    instanceBufferObject = 0;
+    nInstanceBytes = 0;
+    memset(bufferRanges, 0, sizeof(bufferRanges));
 	boundingSphereRadius = 0.0f;
     }
     
@@ -68,28 +73,20 @@ GLTriangleBatch::~GLTriangleBatch(void)
     // Just in case these still are allocated when the object is destroyed
     // End does this and leaves the pointers not NULL as a flag as to which
     // ones were used. Don't uncoment this....
-    if(pIndexes != (GLushort*)NOT_VALID_BUT_USED)
-        delete [] pIndexes;
-
-    if(pVerts != (M3DVector3f*)NOT_VALID_BUT_USED)
-        delete [] pVerts;
-
-    if(pNorms != (M3DVector3f*)NOT_VALID_BUT_USED)
-        delete [] pNorms;
-
-    if(pTexCoords != (M3DVector2f*)NOT_VALID_BUT_USED)
-       delete [] pTexCoords;
+    FreeWorkspace();
     
-    // Delete buffer objects
+    // Queue the buffer objects for deleting, once the GPU is done with them
     if(bMadeStuff) {
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-		glDeleteVertexArraysOES(1, &vertexArrayBufferObject);
-#else
-		glDeleteVertexArrays(1, &vertexArrayBufferObject);
-#endif
+		GLDeleteQueue::GetDeleteQueue()->DeleteVertexArrays(1, &vertexArrayBufferObject);
 
-        glDeleteBuffers(4, bufferObjects);
+        for(int i = 0; i < 4; i++)
+            GLDeleteQueue::GetDeleteQueue()->FreeBufferRange(bufferRanges[i]);
         }
+
+    if(instanceBufferObject != 0)
+        GLDeleteQueue::GetDeleteQueue()->DeleteBuffers(1, &instanceBufferObject);
+
+    GLMemoryTracker::GetMemoryTracker()->Forget(this);
     }
     
 ////////////////////////////////////////////////////////////
@@ -104,17 +101,7 @@ void GLTriangleBatch::BeginMesh(GLuint nMaxVerts)
 #endif
 
     // Just in case this gets called more than once...
-    if(pIndexes != (GLushort*)NOT_VALID_BUT_USED)
-        delete [] pIndexes;
-
-    if(pVerts != (M3DVector3f*)NOT_VALID_BUT_USED)
-        delete [] pVerts;
-
-    if(pNorms != (M3DVector3f*)NOT_VALID_BUT_USED)
-        delete [] pNorms;
-
-    if(pTexCoords != (M3DVector2f*)NOT_VALID_BUT_USED)
-       delete [] pTexCoords;
+    FreeWorkspace();
     
     nMaxIndexes = nMaxVerts;
     nNumIndexes = 0;
@@ -122,11 +109,58 @@ void GLTriangleBatch::BeginMesh(GLuint nMaxVerts)
     
     // Pre-allocate new blocks. In reality, the other arrays will be
     // much shorter than the index array
-    pIndexes = new GLushort[nMaxIndexes];
+    pIndexes = new GLuint[nMaxIndexes];
     pVerts = new M3DVector3f[nMaxIndexes];
     pNorms = new M3DVector3f[nMaxIndexes];
     pTexCoords = new M3DVector2f[nMaxIndexes];
     }
+
+////////////////////////////////////////////////////////////
+// Start a mesh whose vertices and triangles are already known. The
+// workspace is sized exactly, and the counts are set up front, so
+// SetVertex() and SetTriangle() can fill it in any order.
+void GLTriangleBatch::BeginIndexedMesh(GLuint nVerts, GLuint nIndexes, bool bNormals, bool bTexCoords)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+
+    FreeWorkspace();
+
+    nMaxIndexes = nIndexes;
+    nNumIndexes = nIndexes;
+    nNumVerts = nVerts;
+
+    pIndexes = new GLuint[nIndexes];
+    pVerts = new M3DVector3f[nVerts];
+    if(bNormals)
+        pNorms = new M3DVector3f[nVerts];
+    if(bTexCoords)
+        pTexCoords = new M3DVector2f[nVerts];
+    }
+
+////////////////////////////////////////////////////////////
+// Release the client side workspace, if there is any. Pointers
+// flagged as NOT_VALID_BUT_USED were already handed to the GPU.
+void GLTriangleBatch::FreeWorkspace(void)
+    {
+    if(pIndexes != (GLuint*)NOT_VALID_BUT_USED)
+        delete [] pIndexes;
+
+    if(pVerts != (M3DVector3f*)NOT_VALID_BUT_USED)
+        delete [] pVerts;
+
+    if(pNorms != (M3DVector3f*)NOT_VALID_BUT_USED)
+        delete [] pNorms;
+
+    if(pTexCoords != (M3DVector2f*)NOT_VALID_BUT_USED)
+       delete [] pTexCoords;
+
+    pIndexes = nullptr;
+    pVerts = nullptr;
+    pNorms = nullptr;
+    pTexCoords = nullptr;
+    }
   
 /////////////////////////////////////////////////////////////////
 // Add a triangle to the mesh. This searches the current list for identical
@@ -272,6 +306,19 @@ void GLTriangleBatch::AddTriangle(M3DVector3f verts[3], M3DVector3f vNorms[3], M
 // is static (doesn't change).
 void GLTriangleBatch::End(void)
     {
+    UploadBuffers();
+    MakeVertexArray();
+    }
+
+//////////////////////////////////////////////////////////////////
+// Copy the workspace to buffer objects, and free it. Nothing here is
+// vertex array state, so it can be done in any context that shares with
+// the one that will draw.
+void GLTriangleBatch::UploadBuffers(GLBufferPool *pPool)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
     bMadeStuff = true;
 
     // Find the radius of the smallest sphere that would enclose the model
@@ -284,65 +331,111 @@ void GLTriangleBatch::End(void)
         }
     boundingSphereRadius = sqrt(boundingSphereRadius);
     
-    // Create the buffer objects - might need as many as four
-    glGenBuffers(4, bufferObjects);
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-	glGenVertexArraysOES(1, &vertexArrayBufferObject);
-	glBindVertexArrayOES(vertexArrayBufferObject);
-#else
-    glGenVertexArrays(1, &vertexArrayBufferObject);
-    glBindVertexArray(vertexArrayBufferObject);
-#endif
+    // Space for as many as four arrays comes from the shared buffer pool,
+    // which also knows how each kind of buffer has to be filled. It belongs
+    // to the context that draws, which outlives any other that uploads.
+    if(pPool == NULL)
+        pPool = GLBufferPool::GetBufferPool();
 
     // Copy data to GPU memory
     // Vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[VERTEX_DATA]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*nNumVerts*3, pVerts, GL_STATIC_DRAW);
-    glVertexAttribPointer(GLT_ATTRIBUTE_VERTEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(GLT_ATTRIBUTE_VERTEX);
+    pPool->Allocate(GLT_BUFFER_VERTEX, sizeof(GLfloat)*nNumVerts*3, bufferRanges[VERTEX_DATA]);
+    pPool->Write(bufferRanges[VERTEX_DATA], pVerts, sizeof(GLfloat)*nNumVerts*3);
     delete [] pVerts;
     pVerts = (M3DVector3f*)NOT_VALID_BUT_USED;
 
 
     // Normal data
     if(pNorms) {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[NORMAL_DATA]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*nNumVerts*3, pNorms, GL_STATIC_DRAW);
-        glVertexAttribPointer(GLT_ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(GLT_ATTRIBUTE_NORMAL);
+        pPool->Allocate(GLT_BUFFER_VERTEX, sizeof(GLfloat)*nNumVerts*3, bufferRanges[NORMAL_DATA]);
+        pPool->Write(bufferRanges[NORMAL_DATA], pNorms, sizeof(GLfloat)*nNumVerts*3);
         delete [] pNorms;
         pNorms = (M3DVector3f*)NOT_VALID_BUT_USED;
         }
-    else {
-        delete [] pNorms;
-        pNorms = nullptr;
-        }
 
 
     // Texture coordinates
     if(pTexCoords) {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[TEXTURE_DATA]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*nNumVerts*2, pTexCoords, GL_STATIC_DRAW);
-        glVertexAttribPointer(GLT_ATTRIBUTE_TEXTURE0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(GLT_ATTRIBUTE_TEXTURE0);
+        pPool->Allocate(GLT_BUFFER_VERTEX, sizeof(GLfloat)*nNumVerts*2, bufferRanges[TEXTURE_DATA]);
+        pPool->Write(bufferRanges[TEXTURE_DATA], pTexCoords, sizeof(GLfloat)*nNumVerts*2);
         delete [] pTexCoords;
         pTexCoords = (M3DVector2f *)NOT_VALID_BUT_USED;
         }
         
-    // Indexes
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObjects[INDEX_DATA]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*nNumIndexes, pIndexes, GL_STATIC_DRAW);
+    // Indexes. Shorts take half the memory, so use them whenever every
+    // vertex can be reached with one. Big meshes need the full 32 bits.
+    if(nNumVerts <= 65536) {
+        GLushort *pShortIndexes = new GLushort[nNumIndexes];
+        for(GLuint i = 0; i < nNumIndexes; i++)
+            pShortIndexes[i] = (GLushort)pIndexes[i];
+
+        indexType = GL_UNSIGNED_SHORT;
+        pPool->Allocate(GLT_BUFFER_INDEX, sizeof(GLushort)*nNumIndexes, bufferRanges[INDEX_DATA]);
+        pPool->Write(bufferRanges[INDEX_DATA], pShortIndexes, sizeof(GLushort)*nNumIndexes);
+        delete [] pShortIndexes;
+        }
+    else {
+        indexType = GL_UNSIGNED_INT;
+        pPool->Allocate(GLT_BUFFER_INDEX, sizeof(GLuint)*nNumIndexes, bufferRanges[INDEX_DATA]);
+        pPool->Write(bufferRanges[INDEX_DATA], pIndexes, sizeof(GLuint)*nNumIndexes);
+        }
     delete [] pIndexes;
-    pIndexes = (GLushort*)NOT_VALID_BUT_USED;
+    pIndexes = (GLuint*)NOT_VALID_BUT_USED;
 
+    ReportUsage();
+    }
+
+//////////////////////////////////////////////////////////////////
+// Tell the memory tracker what we're holding on the GPU
+void GLTriangleBatch::ReportUsage(void)
+    {
+    GLMemoryTracker *pTracker = GLMemoryTracker::GetMemoryTracker();
+    pTracker->SetUsage(GLT_MEMORY_VERTEX, this, bufferRanges[VERTEX_DATA].nSize + bufferRanges[NORMAL_DATA].nSize +
+                       bufferRanges[TEXTURE_DATA].nSize + nInstanceBytes, "GLTriangleBatch");
+    pTracker->SetUsage(GLT_MEMORY_INDEX, this, bufferRanges[INDEX_DATA].nSize, "GLTriangleBatch");
+    }
+
+//////////////////////////////////////////////////////////////////
+// Point a vertex array at the buffers. Vertex arrays aren't shared
+// between contexts, so this has to happen in the one that draws.
+void GLTriangleBatch::MakeVertexArray(void)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
 #if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-	glBindVertexArrayOES(0);
+	glGenVertexArraysOES(1, &vertexArrayBufferObject);
 #else
-	glBindVertexArray(0);
+    glGenVertexArrays(1, &vertexArrayBufferObject);
 #endif
+    GLStateCache::GetStateCache()->BindVertexArray(vertexArrayBufferObject);
+
+    // Vertex data
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, bufferRanges[VERTEX_DATA].uiBuffer);
+    glVertexAttribPointer(GLT_ATTRIBUTE_VERTEX, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)bufferRanges[VERTEX_DATA].nOffset);
+    glEnableVertexAttribArray(GLT_ATTRIBUTE_VERTEX);
+
+    // Normal data
+    if(pNorms == (M3DVector3f*)NOT_VALID_BUT_USED) {
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, bufferRanges[NORMAL_DATA].uiBuffer);
+        glVertexAttribPointer(GLT_ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)bufferRanges[NORMAL_DATA].nOffset);
+        glEnableVertexAttribArray(GLT_ATTRIBUTE_NORMAL);
+        }
+
+    // Texture coordinates
+    if(pTexCoords == (M3DVector2f*)NOT_VALID_BUT_USED) {
+        GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, bufferRanges[TEXTURE_DATA].uiBuffer);
+        glVertexAttribPointer(GLT_ATTRIBUTE_TEXTURE0, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)bufferRanges[TEXTURE_DATA].nOffset);
+        glEnableVertexAttribArray(GLT_ATTRIBUTE_TEXTURE0);
+        }
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);	// Note: This should NOT be necessary, it should be captured
+    // Indexes. Draws start at the range's offset.
+    GLStateCache::GetStateCache()->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferRanges[INDEX_DATA].uiBuffer);
+
+    GLStateCache::GetStateCache()->BindVertexArray(0);
+
+    GLStateCache::GetStateCache()->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, 0);	// Note: This should NOT be necessary, it should be captured
 										// in the vertex array object binding state. I believe this is a
 										// bug in iOS's OpenGL implementation, and at it is simply redudant
 										// in other implementations/platforms
@@ -354,99 +447,202 @@ void GLTriangleBatch::Draw(void)
     {
     if(nNumIndexes <= 0)
         return;
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-	glBindVertexArrayOES(vertexArrayBufferObject);
+    GLStateCache::GetStateCache()->BindVertexArray(vertexArrayBufferObject);
+    glDrawElements(GL_TRIANGLES, nNumIndexes, indexType, (const GLvoid *)bufferRanges[INDEX_DATA].nOffset);
+    }
+
+bool GLTriangleBatch::GetDrawItem(GLTDrawItem& item)
+    {
+    if(nNumIndexes <= 0)
+        return false;
+
+    item.uiVertexArray = vertexArrayBufferObject;
+    item.ePrimitive = GL_TRIANGLES;
+    item.nCount = nNumIndexes;
+    item.eIndexType = indexType;
+    item.nFirst = bufferRanges[INDEX_DATA].nOffset;
+    return true;
+    }
+
+//////////////////////////////////////////////////////////////////////////
+// Draw many copies with one call. Per-instance data comes from the shader
+// (gl_InstanceID) or from attributes with a divisor.
+void GLTriangleBatch::DrawInstanced(GLsizei nInstances)
+    {
+    if(nNumIndexes <= 0 || nInstances <= 0)
+        return;
+    GLStateCache::GetStateCache()->BindVertexArray(vertexArrayBufferObject);
+#if defined ( ANDROID_NDK )
+    glDrawElementsInstancedEXT(GL_TRIANGLES, nNumIndexes, indexType, (const GLvoid *)bufferRanges[INDEX_DATA].nOffset, nInstances);
+#else
+    glDrawElementsInstanced(GL_TRIANGLES, nNumIndexes, indexType, (const GLvoid *)bufferRanges[INDEX_DATA].nOffset, nInstances);
+#endif
+    }
+
+//////////////////////////////////////////////////////////////////////////
+// Source an attribute from the instance buffer, advancing once per instance
+// instead of once per vertex. The vertex array remembers this, so it only
+// needs doing once.
+void GLTriangleBatch::SetInstanceAttribute(GLuint iAttribute, GLint nComponents, GLsizei nStride, GLsizeiptr nOffset)
+    {
+    if(!bMadeStuff)
+        return;
+
+    if(instanceBufferObject == 0)
+        glGenBuffers(1, &instanceBufferObject);
+
+    GLStateCache::GetStateCache()->BindVertexArray(vertexArrayBufferObject);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, instanceBufferObject);
+    glVertexAttribPointer(iAttribute, nComponents, GL_FLOAT, GL_FALSE, nStride, (const GLvoid *)nOffset);
+    glEnableVertexAttribArray(iAttribute);
+#if defined ( ANDROID_NDK )
+    glVertexAttribDivisorEXT(iAttribute, 1);
+#else
+    glVertexAttribDivisor(iAttribute, 1);
+#endif
+
+    GLStateCache::GetStateCache()->BindVertexArray(0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+//////////////////////////////////////////////////////////////////////////
+// Replace the per-instance data. The old contents are orphaned rather than
+// overwritten, so we don't wait on draws that are still using them.
+void GLTriangleBatch::CopyInstanceData(const void *pData, GLsizeiptr nBytes)
+    {
+    if(instanceBufferObject == 0)
+        glGenBuffers(1, &instanceBufferObject);
+
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, instanceBufferObject);
+    glBufferData(GL_ARRAY_BUFFER, nBytes, pData, GL_DYNAMIC_DRAW);
+
+    nInstanceBytes = nBytes;
+    ReportUsage();
+    }
+
+////////////////////////////////////////////////////////////////////////
+// Copy the contents of one of our buffer objects out to a file. Our
+// vertex array is bound so the element array binding is the right one.
+bool GLTriangleBatch::WriteBufferObject(FILE *pFile, GLenum target, const GLTBUFFERRANGE& range, GLsizeiptr nBytes)
+    {
+#if defined ( ANDROID_NDK )
+    // OpenGL ES 2 can only map buffers for writing
+    (void)pFile; (void)target; (void)range; (void)nBytes;
+    return false;
 #else
-	glBindVertexArray(vertexArrayBufferObject);
+    GLStateCache::GetStateCache()->BindBuffer(target, range.uiBuffer);
+    void *pData = glMapBufferRange(target, range.nOffset, nBytes, GL_MAP_READ_BIT);
+    if(pData == nullptr)
+        return false;
+
+    bool bWritten = (fwrite(pData, nBytes, 1, pFile) == 1);
+    glUnmapBuffer(target);
+    return bWritten;
 #endif
-    glDrawElements(GL_TRIANGLES, nNumIndexes, GL_UNSIGNED_SHORT, 0);
     }
 
 ////////////////////////////////////////////////////////////////////////
-// Save the mesh into the already open file stream
+// Save the mesh into the already open file stream. The indexes are stored
+// the same way they are on the GPU, shorts unless there are more than 64k
+// vertices, which is how LoadMesh knows how to read them back.
 bool GLTriangleBatch::SaveMesh(FILE *pFile)
     {
-	(void)pFile;
-/*    // Header contains...
+    // Nothing on the GPU yet
+    if(!bMadeStuff)
+        return false;
+
+    // Header contains...
     fwrite(&nNumIndexes, sizeof(GLuint), 1, pFile);
     fwrite(&nNumVerts, sizeof(GLuint), 1, pFile);
-    fwrite(&boundingSphereRadius, sizeof(GLuint), 1, pFile);
-    
-    
-//    printf("Unique Verts: %d\r\nTriangles: %d\r\n\r\n", nNumVerts, nNumIndexes);
+    fwrite(&boundingSphereRadius, sizeof(GLfloat), 1, pFile);
+
+    GLStateCache::GetStateCache()->BindVertexArray(vertexArrayBufferObject);
+
+    GLsizeiptr nIndexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+    bool bSaved = WriteBufferObject(pFile, GL_ELEMENT_ARRAY_BUFFER, bufferRanges[INDEX_DATA], nIndexSize * nNumIndexes);
 
-    // Indexes
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObjects[INDEX_DATA]);
-    pIndexes = (GLushort *)glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_READ_ONLY);
-    fwrite(pIndexes, sizeof(GLushort) * nNumIndexes, 1, pFile);
-    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-    pIndexes = NULL;
-    
     // Vertex positions
-    glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[VERTEX_DATA]);
-    pVerts = (M3DVector3f *)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY);
-    fwrite(pVerts, sizeof(M3DVector3f) * nNumVerts, 1, pFile);
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    
+    if(bSaved)
+        bSaved = WriteBufferObject(pFile, GL_ARRAY_BUFFER, bufferRanges[VERTEX_DATA], sizeof(M3DVector3f) * nNumVerts);
+
     // Normals, if we have them
-    if(pNorms) { // Look for original flag
-        glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[NORMAL_DATA]);
-        pNorms = (M3DVector3f *)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY);
-        fwrite(pNorms, sizeof(M3DVector3f) * nNumVerts, 1, pFile);
-        glUnmapBuffer(GL_ARRAY_BUFFER);
-        }
-        
+    if(bSaved && pNorms == (M3DVector3f*)NOT_VALID_BUT_USED)
+        bSaved = WriteBufferObject(pFile, GL_ARRAY_BUFFER, bufferRanges[NORMAL_DATA], sizeof(M3DVector3f) * nNumVerts);
+
     // Texture Coordinates, if we have them
-    if(pTexCoords) { // Look for original flag
-        glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[TEXTURE_DATA]);
-        pTexCoords = (M3DVector2f *)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY);
-        fwrite(pTexCoords, sizeof(M3DVector2f) * nNumVerts, 1, pFile);
-        glUnmapBuffer(GL_ARRAY_BUFFER);
-        }
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        
-  */
-    return true;
+    if(bSaved && pTexCoords == (M3DVector2f*)NOT_VALID_BUT_USED)
+        bSaved = WriteBufferObject(pFile, GL_ARRAY_BUFFER, bufferRanges[TEXTURE_DATA], sizeof(M3DVector2f) * nNumVerts);
+
+    GLStateCache::GetStateCache()->BindVertexArray(0);
+    GLStateCache::GetStateCache()->BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return bSaved;
     }
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Load a mesh into this batch, given the existing and already opened file stream.
 // So, You must have verts, but normals and vetexes are optional. You need to know
-// ahead of time which are in the file.
+// ahead of time which are in the file. The data is read into the workspace, and
+// End() does the rest, just as if the mesh had been built by hand.
 bool GLTriangleBatch::LoadMesh(FILE *pFile, bool bNormals, bool bTexCoords)
     {
 // In case this is called first (does no harm to call multiple times)
 #ifdef QT_IS_AVAILABLE
     initializeOpenGLFunctions();
 #endif
-    // Create the buffer objects
-    glGenBuffers(4, bufferObjects);
-    
-    // Create the master vertex array object
-#if defined ( ANDROID_NDK ) || defined ( __EMSCRIPTEN__ )
-	glGenVertexArraysOES(1, &vertexArrayBufferObject);
-	glBindVertexArrayOES(vertexArrayBufferObject);
-#else
-	glGenVertexArrays(1, &vertexArrayBufferObject);
-	glBindVertexArray(vertexArrayBufferObject);
-#endif
+    if(!ReadMesh(pFile, bNormals, bTexCoords))
+        return false;
+
+    // Off to the GPU
+    End();
+    return true;
+    }
+
+// Just the reading, with no GL calls, so it can be done on any thread
+bool GLTriangleBatch::ReadMesh(FILE *pFile, bool bNormals, bool bTexCoords)
+    {
+    // Just in case this gets called more than once...
+    FreeWorkspace();
 
-    
     // Read it all in
-    fread(&nNumIndexes, sizeof(GLuint), 1, pFile);
-    fread(&nNumVerts, sizeof(GLuint), 1, pFile);
-    fread(&boundingSphereRadius, sizeof(GLuint), 1, pFile);
+    if(fread(&nNumIndexes, sizeof(GLuint), 1, pFile) != 1 ||
+       fread(&nNumVerts, sizeof(GLuint), 1, pFile) != 1 ||
+       fread(&boundingSphereRadius, sizeof(GLfloat), 1, pFile) != 1)
+        return false;
     
 //    printf("Unique Verts: %d\r\nTriangles: %d\r\n\r\n", nNumVerts, nNumIndexes);
     
-    pIndexes = new GLushort[nNumIndexes];
-    fread(pIndexes, sizeof(GLushort) * nNumIndexes, 1, pFile);
+    nMaxIndexes = nNumIndexes;
+    pIndexes = new GLuint[nNumIndexes];
+    if(nNumVerts <= 65536) {
+        GLushort *pShortIndexes = new GLushort[nNumIndexes];
+        bool bRead = (fread(pShortIndexes, sizeof(GLushort) * nNumIndexes, 1, pFile) == 1);
+        for(GLuint i = 0; i < nNumIndexes; i++)
+            pIndexes[i] = pShortIndexes[i];
+        delete [] pShortIndexes;
+        if(!bRead) {
+            FreeWorkspace();
+            return false;
+            }
+        }
+    else if(fread(pIndexes, sizeof(GLuint) * nNumIndexes, 1, pFile) != 1) {
+        FreeWorkspace();
+        return false;
+        }
+
+    // A damaged file can't be allowed to index past the vertices
+    for(GLuint i = 0; i < nNumIndexes; i++)
+        if(pIndexes[i] >= nNumVerts) {
+            FreeWorkspace();
+            return false;
+            }
     
     pVerts = new M3DVector3f[nNumVerts];
-    fread(pVerts, sizeof(M3DVector3f) * nNumVerts, 1, pFile);
+    if(fread(pVerts, sizeof(M3DVector3f) * nNumVerts, 1, pFile) != 1) {
+        FreeWorkspace();
+        return false;
+        }
     
     // Read Normals? If we have them, they occur before the texture coordinates
     if(bNormals) {
@@ -470,31 +666,7 @@ bool GLTriangleBatch::LoadMesh(FILE *pFile, bool bNormals, bool bTexCoords)
             pTexCoords = NULL;
             }   
         }
-        
-    // Vertices
-    glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[VERTEX_DATA]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector3f) * nNumVerts, pVerts, GL_STATIC_DRAW);
-    delete [] pVerts;
-    
-    // Normals
-    if(pNorms) {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[NORMAL_DATA]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector3f) * nNumVerts, pNorms, GL_STATIC_DRAW);
-        delete [] pNorms;
-        }
-        
-    // Texture Coordinates
-    if(pTexCoords) {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[TEXTURE_DATA]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(M3DVector2f) * nNumVerts, pTexCoords, GL_STATIC_DRAW);
-        delete [] pTexCoords;
-        }
-    
-    // Indexes
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObjects[INDEX_DATA]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * nNumIndexes, pIndexes, GL_STATIC_DRAW);
-    delete [] pIndexes;
-    
+
     return true;
     }
 
@@ -506,11 +678,11 @@ bool GLTriangleBatch::SaveMesh(const char *szFileName)
 	if(pFile == NULL)
 		return false;
         
-    SaveMesh(pFile);
+    bool bSaved = SaveMesh(pFile);
 
 		
 	fclose(pFile);
-	return true;
+	return bSaved;
 	}
 
 
@@ -520,11 +692,28 @@ bool GLTriangleBatch::LoadMesh(const char *szFileName, bool bNormals, bool bTexC
 	if(pFile == NULL)
 		return false;
 
-    LoadMesh(pFile, bNormals, bTexCoords);
+    bool bLoaded = LoadMesh(pFile, bNormals, bTexCoords);
+    if(bLoaded)
+        GLMemoryTracker::GetMemoryTracker()->SetTag(this, szFileName);
+
 
+    fclose(pFile);
+
+	return bLoaded;
+	}
+
+bool GLTriangleBatch::ReadMesh(const char *szFileName, bool bNormals, bool bTexCoords)
+	{
+	FILE *pFile = fopen(szFileName, "rb");
+	if(pFile == NULL)
+		return false;
 
+    bool bRead = ReadMesh(pFile, bNormals, bTexCoords);
     fclose(pFile);
 
-	return true;
+    // Memory reports show where the mesh came from
+    if(bRead)
+        GLMemoryTracker::GetMemoryTracker()->SetTag(this, szFileName);
+    return bRead;
 	}
   
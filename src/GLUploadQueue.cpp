@@ -0,0 +1,372 @@
+/*
+GLUploadQueue.cpp
+
+Copyright (c) 2009-2023, Richard S. Wright Jr.
+GLTools Open Source Library
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list
+of conditions and the following disclaimer.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used
+to endorse or promote products derived from this software without specific prior
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GLUploadQueue.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLUploadQueue::GLUploadQueue(void)
+    {
+    nPending = 0;
+    bStopping = false;
+    pUploadContext = NULL;
+    pMakeCurrent = NULL;
+    pBufferPool = NULL;
+    }
+
+GLUploadQueue::~GLUploadQueue(void)
+    {
+    Stop();
+    for(size_t i = 0; i < jobs.size(); i++) {
+        free(jobs[i]->pBits);
+        delete jobs[i];
+        }
+    }
+
+void GLUploadQueue::SetUploadContext(void *pContext, void (*pMakeCurrentFunc)(void *pContext))
+    {
+    pUploadContext = pContext;
+    pMakeCurrent = pMakeCurrentFunc;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// With the render context current. Functions looked up here are used in the
+// upload context too, which shares with it.
+bool GLUploadQueue::Start(GLint nThreads)
+    {
+#ifdef QT_IS_AVAILABLE
+    initializeOpenGLFunctions();
+#endif
+    if(!threads.empty())
+        return false;
+
+    pBufferPool = GLBufferPool::GetBufferPool();
+    bStopping = false;
+    for(GLint i = 0; i < nThreads; i++)
+        threads.emplace_back(&GLUploadQueue::DecodeThread, this);
+
+    if(pMakeCurrent != NULL)
+        threads.emplace_back(&GLUploadQueue::UploadThread, this);
+
+    return true;
+    }
+
+void GLUploadQueue::Stop(void)
+    {
+        {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        bStopping = true;
+        }
+    queueReady.notify_all();
+
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    threads.clear();
+
+    // Whatever was still in flight, and anything made for it
+    for(size_t i = 0; i < jobs.size(); i++) {
+        UPLOADJOB *pJob = jobs[i];
+        if(pJob->status >= GLT_UPLOAD_READY)
+            continue;
+
+        if(pJob->fence != 0)
+            glDeleteSync(pJob->fence);
+        if(pJob->uiTexture != 0)
+            GLStateCache::GetStateCache()->DeleteTextures(1, &pJob->uiTexture);
+        free(pJob->pBits);
+        pJob->pBits = NULL;
+        pJob->fence = 0;
+        pJob->uiTexture = 0;
+        pJob->status = GLT_UPLOAD_FAILED;
+        }
+
+    decodeQueue.clear();
+    uploadQueue.clear();
+    fenceQueue.clear();
+    nPending = 0;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLint GLUploadQueue::LoadMesh(GLTriangleBatch *pBatch, const char *szFileName, bool bNormals, bool bTexCoords)
+    {
+    UPLOADJOB *pJob = new UPLOADJOB;
+    pJob->eType = UPLOAD_MESH;
+    pJob->strFileName = szFileName;
+    pJob->pBatch = pBatch;
+    pJob->bNormals = bNormals;
+    pJob->bTexCoords = bTexCoords;
+    return Queue(pJob);
+    }
+
+GLint GLUploadQueue::LoadTextureTGA(const char *szFileName, GLenum eMinFilter, GLenum eMagFilter, GLenum eWrapMode)
+    {
+    UPLOADJOB *pJob = new UPLOADJOB;
+    pJob->eType = UPLOAD_TEXTURE;
+    pJob->strFileName = szFileName;
+    pJob->pBatch = NULL;
+    pJob->eMinFilter = eMinFilter;
+    pJob->eMagFilter = eMagFilter;
+    pJob->eWrapMode = eWrapMode;
+    return Queue(pJob);
+    }
+
+GLint GLUploadQueue::Queue(UPLOADJOB *pJob)
+    {
+    pJob->status = GLT_UPLOAD_QUEUED;
+    pJob->pBits = NULL;
+    pJob->uiTexture = 0;
+    pJob->nBytes = 0;
+    pJob->fence = 0;
+
+    GLint iTicket = (GLint)jobs.size();
+    jobs.push_back(pJob);
+    nPending++;
+
+        {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        decodeQueue.push_back(pJob);
+        }
+    queueReady.notify_all();
+    return iTicket;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker threads. Loads that fail here still go down the line, so the render
+// thread is the one that hears about them.
+void GLUploadQueue::DecodeThread(void)
+    {
+    for(;;) {
+        UPLOADJOB *pJob;
+            {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return bStopping || !decodeQueue.empty(); });
+            if(bStopping)
+                return;
+            pJob = decodeQueue.front();
+            decodeQueue.pop_front();
+            }
+
+        Decode(pJob);
+
+            {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            uploadQueue.push_back(pJob);
+            }
+        queueReady.notify_all();
+        }
+    }
+
+void GLUploadQueue::Decode(UPLOADJOB *pJob)
+    {
+    bool bDecoded;
+    if(pJob->eType == UPLOAD_MESH) {
+        bDecoded = pJob->pBatch->ReadMesh(pJob->strFileName.c_str(), pJob->bNormals, pJob->bTexCoords);
+        pJob->nBytes = pJob->pBatch->GetIndexCount() * sizeof(GLuint) +
+                       pJob->pBatch->GetVertexCount() * sizeof(M3DVector3f) * 3;
+        }
+    else {
+        pJob->pBits = gltReadTGABits(pJob->strFileName.c_str(), &pJob->nWidth, &pJob->nHeight,
+                                     &pJob->nComponents, &pJob->eFormat);
+        bDecoded = (pJob->pBits != NULL);
+        pJob->nBytes = (GLsizeiptr)pJob->nWidth * pJob->nHeight * 4;
+        }
+
+    pJob->status = bDecoded ? GLT_UPLOAD_DECODED : GLT_UPLOAD_FAILED;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Only with an upload context. Each upload is fenced and flushed, so the
+// render thread can tell when the GPU has it.
+void GLUploadQueue::UploadThread(void)
+    {
+    pMakeCurrent(pUploadContext);
+    gltMakeContextCurrent(pUploadContext);
+
+    for(;;) {
+        UPLOADJOB *pJob;
+            {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return bStopping || !uploadQueue.empty(); });
+            if(bStopping)
+                return;
+            pJob = uploadQueue.front();
+            uploadQueue.pop_front();
+            }
+
+        if(pJob->status != GLT_UPLOAD_FAILED) {
+            Upload(pJob);
+            pJob->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            }
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        fenceQueue.push_back(pJob);
+        }
+    }
+
+void GLUploadQueue::Upload(UPLOADJOB *pJob)
+    {
+    if(pJob->eType == UPLOAD_MESH)
+        pJob->pBatch->UploadBuffers(pBufferPool);
+    else {
+        GLStateCache *pStateCache = GLStateCache::GetStateCache();
+        glGenTextures(1, &pJob->uiTexture);
+        pStateCache->BindTexture(GL_TEXTURE_2D, pJob->uiTexture);
+
+        // .TGA rows aren't padded
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, pJob->nComponents, pJob->nWidth, pJob->nHeight, 0,
+                     pJob->eFormat, GL_UNSIGNED_BYTE, pJob->pBits);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pJob->eMinFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pJob->eMagFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pJob->eWrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pJob->eWrapMode);
+        // Drivers store RGB as four bytes a pixel. Mipmaps add a third.
+        if(pJob->eMinFilter != GL_LINEAR && pJob->eMinFilter != GL_NEAREST) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            pJob->nBytes += pJob->nBytes / 3;
+            }
+
+        pStateCache->BindTexture(GL_TEXTURE_2D, 0);
+        free(pJob->pBits);
+        pJob->pBits = NULL;
+        }
+
+    pJob->status = GLT_UPLOAD_UPLOADED;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The render thread's part. Uploads itself, up to nMaxBytes, or hands over
+// what the upload thread has finished. The fences pass in order, so the
+// first one that hasn't stops the rest.
+GLint GLUploadQueue::Update(GLsizeiptr nMaxBytes)
+    {
+    GLint nFinished = 0;
+
+    if(pMakeCurrent == NULL) {
+        GLsizeiptr nBytes = 0;
+        while(nBytes < nMaxBytes) {
+            UPLOADJOB *pJob;
+                {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if(uploadQueue.empty())
+                    break;
+                pJob = uploadQueue.front();
+                uploadQueue.pop_front();
+                }
+
+            if(pJob->status != GLT_UPLOAD_FAILED) {
+                Upload(pJob);
+                nBytes += pJob->nBytes;
+                }
+            Finish(pJob);
+            nFinished++;
+            }
+
+        return nFinished;
+        }
+
+    for(;;) {
+        UPLOADJOB *pJob;
+            {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if(fenceQueue.empty())
+                break;
+            pJob = fenceQueue.front();
+            }
+
+        if(pJob->fence != 0) {
+            GLenum eResult = glClientWaitSync(pJob->fence, 0, 0);
+            if(eResult != GL_ALREADY_SIGNALED && eResult != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(pJob->fence);
+            pJob->fence = 0;
+            }
+
+            {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            fenceQueue.pop_front();
+            }
+
+        Finish(pJob);
+        nFinished++;
+        }
+
+    return nFinished;
+    }
+
+// Vertex arrays belong to the render context, so meshes get theirs here
+void GLUploadQueue::Finish(UPLOADJOB *pJob)
+    {
+    nPending--;
+    if(pJob->status == GLT_UPLOAD_FAILED)
+        return;
+
+    // Textures are tracked by context, and this is the one that will delete it
+    if(pJob->eType == UPLOAD_MESH)
+        pJob->pBatch->MakeVertexArray();
+    else
+        GLMemoryTracker::GetMemoryTracker()->SetTextureUsage(pJob->uiTexture, pJob->nBytes, pJob->strFileName.c_str());
+
+    pJob->status = GLT_UPLOAD_READY;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLT_UPLOAD_STATUS GLUploadQueue::GetStatus(GLint iTicket)
+    {
+    if(iTicket < 0 || iTicket >= (GLint)jobs.size())
+        return GLT_UPLOAD_FAILED;
+    return (GLT_UPLOAD_STATUS)jobs[iTicket]->status.load();
+    }
+
+GLuint GLUploadQueue::GetTexture(GLint iTicket)
+    {
+    if(GetStatus(iTicket) != GLT_UPLOAD_READY)
+        return 0;
+    return jobs[iTicket]->uiTexture;
+    }
+
+void GLUploadQueue::Clear(void)
+    {
+    if(nPending > 0)
+        return;
+
+    for(size_t i = 0; i < jobs.size(); i++) {
+        free(jobs[i]->pBits);
+        delete jobs[i];
+        }
+    jobs.clear();
+    }